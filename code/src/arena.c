@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "arena.h"
+
+struct arenaOverflow {
+    struct arenaOverflow *next;
+    size_t size;
+};
+
+// Overflow header padded so the block after it stays aligned
+#define OVERFLOW_HEADER (((sizeof(struct arenaOverflow) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT) * ARENA_ALIGNMENT)
+
+static size_t alignSize(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+static void *blockAlloc(size_t size) {
+  void *ptr = aligned_alloc(ARENA_ALIGNMENT, size);
+
+  if (ptr == NULL) {
+    fprintf(stderr, "Could not allocate %zu bytes of scratch\n", size);
+    exit(1);
+  }
+
+  return ptr;
+}
+
+void arenaInit(patternArena *arena, size_t capacity) {
+  assert(arena != NULL);
+
+  memset(arena, 0, sizeof(patternArena));
+
+  if (capacity == 0)
+    return;
+
+  arena->capacity = alignSize(capacity);
+  arena->base = blockAlloc(arena->capacity);
+}
+
+void arenaDestroy(patternArena *arena) {
+  assert(arena != NULL);
+
+  arenaRelease(arena, (arenaMark) {0, 0, NULL});
+  free(arena->base);
+
+  memset(arena, 0, sizeof(patternArena));
+}
+
+void *arenaAlloc(patternArena *arena, size_t size) {
+  assert(arena != NULL);
+
+  size = alignSize(size == 0 ? 1 : size);
+
+  arena->footprint += size;
+
+  if (arena->footprint > arena->highWater)
+    arena->highWater = arena->footprint;
+
+  // Bump the main block if it still fits
+  if (arena->offset + size <= arena->capacity) {
+    void *ptr = &arena->base[arena->offset];
+    arena->offset += size;
+    return ptr;
+  }
+
+  // Otherwise give the allocation its own block until the arena is released
+  struct arenaOverflow *block = blockAlloc(OVERFLOW_HEADER + size);
+
+  block->next = arena->overflow;
+  block->size = size;
+  arena->overflow = block;
+
+  return (char *) block + OVERFLOW_HEADER;
+}
+
+void *arenaCalloc(patternArena *arena, size_t n, size_t size) {
+  void *ptr = arenaAlloc(arena, n * size);
+  memset(ptr, 0, n * size);
+
+  return ptr;
+}
+
+arenaMark arenaGetMark(const patternArena *arena) {
+  return (arenaMark) {arena->offset, arena->footprint, arena->overflow};
+}
+
+void arenaRelease(patternArena *arena, arenaMark mark) {
+  assert(arena != NULL);
+
+  while (arena->overflow != mark.overflow) {
+    struct arenaOverflow *next = arena->overflow->next;
+    free(arena->overflow);
+    arena->overflow = next;
+  }
+
+  arena->offset = mark.offset;
+  arena->footprint = mark.footprint;
+
+  // Once the arena is empty grow the main block to the largest footprint seen, up to the cap
+  size_t capacity = arena->highWater < ARENA_MAX_CAPACITY ? arena->highWater : ARENA_MAX_CAPACITY;
+
+  if (arena->footprint == 0 && capacity > arena->capacity) {
+    free(arena->base);
+
+    arena->capacity = capacity;
+    arena->base = blockAlloc(arena->capacity);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stddef.h>
+
+// Alignment of every arena allocation, one cache line
+#define ARENA_ALIGNMENT 64
+
+// Largest main block, the arenas of the default contexts live as long as their threads
+#define ARENA_MAX_CAPACITY (1 << 20)
+
+struct arenaOverflow;
+
+/*
+ * Scratch arena - bump allocator released in stack order with marks.
+ * Allocations that do not fit in the main block get their own block until the
+ * arena is fully released, at which point the main block grows to the largest
+ * footprint seen, so steady state calls never touch the system allocator.
+ * It never grows past ARENA_MAX_CAPACITY, larger scratch keeps coming from the
+ * system allocator and goes back to it as soon as it is released.
+ */
+typedef struct patternArena {
+    char *base;                     // Main block
+    size_t capacity;                // Size of the main block
+    size_t offset;                  // Bytes in use in the main block
+    size_t footprint;               // Bytes in use including the overflow blocks
+    size_t highWater;               // Largest footprint seen since the last growth
+    struct arenaOverflow *overflow; // Blocks allocated while the main block was full
+} patternArena;
+
+// Position of an arena, allocations made after it are released together
+typedef struct arenaMark {
+    size_t offset;
+    size_t footprint;
+    struct arenaOverflow *overflow;
+} arenaMark;
+
+void arenaInit(patternArena *arena, size_t capacity);
+
+void arenaDestroy(patternArena *arena);
+
+void *arenaAlloc(patternArena *arena, size_t size);
+
+void *arenaCalloc(patternArena *arena, size_t n, size_t size);
+
+arenaMark arenaGetMark(const patternArena *arena);
+
+void arenaRelease(patternArena *arena, arenaMark mark);
+
+#endif
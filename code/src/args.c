@@ -1,10 +1,13 @@
 #include <stdlib.h>
+#include <string.h>
 #include "args.h"
 #include "unit.h"
 
 // Util
 int getInt(struct argp_state *state, char *arg, char *arg_name);
 
+int getList(struct argp_state *state, char *arg, char *arg_name, size_t **values);
+
 // Parser
 int argp_option_parser(int key, char *arg, struct argp_state *state) {
   argp_args *args = state->input;
@@ -25,28 +28,175 @@ int argp_option_parser(int key, char *arg, struct argp_state *state) {
     case 'w':
       args->weighted = 1;
       break;
+    case 'B':
+      args->bench = 1;
+      break;
+    case 'r':
+      args->repetitions = getInt(state, arg, "number of repetitions");
+
+      if (args->repetitions < 1)
+        argp_failure(state, 1, 0, "invalid number of repetitions.");
+      break;
+    case 'u':
+      args->warmup = getInt(state, arg, "number of warm-up runs");
+
+      if (args->warmup < 0)
+        argp_failure(state, 1, 0, "invalid number of warm-up runs.");
+      break;
+    case 's':
+      free(args->sizes);
+      args->n_sizes = getList(state, arg, "sizes", &args->sizes);
+      break;
+    case 'T': {
+      size_t *values;
+
+      free(args->thread_list);
+      args->n_thread_list = getList(state, arg, "thread list", &values);
+      args->thread_list = malloc(args->n_thread_list * sizeof(int));
+
+      for (int i = 0; i < args->n_thread_list; i++) {
+        if (values[i] > 4096)
+          argp_failure(state, 1, 0, "invalid number of threads in thread list.");
+
+        args->thread_list[i] = (int) values[i];
+      }
+
+      free(values);
+      break;
+    }
+    case 'F':
+      if (strcmp(arg, "csv") == 0)
+        args->format = BENCH_CSV;
+      else if (strcmp(arg, "json") == 0)
+        args->format = BENCH_JSON;
+      else
+        argp_failure(state, 1, 0, "invalid format. pick from csv or json.");
+      break;
+    case 'e':
+      if (unitElementSize(arg) == 0)
+        argp_failure(state, 1, 0, "invalid element type. pick from char, int, int64, float or double.");
+
+      args->element = arg;
+      break;
+    case 'z': {
+      int width = getInt(state, arg, "element width");
+
+      if (width < 1)
+        argp_failure(state, 1, 0, "invalid element width.");
+
+      args->width = width;
+      break;
+    }
+    case 'a':
+      args->tuning = arg;
+      break;
+    case 'c':
+      args->calibrate = 1;
+      break;
+    case 'R':
+      args->regress = 1;
+      break;
+    case 'L':
+      args->baseline = arg;
+      break;
+    case 'W':
+      args->record = 1;
+      break;
+    case 'P':
+      args->tolerance = getInt(state, arg, "tolerance");
+
+      if (args->tolerance < 0 || args->tolerance >= 100)
+        argp_failure(state, 1, 0, "invalid tolerance. pick from 0 to 99.");
+      break;
+    case 'f':
+      args->input = arg;
+      break;
+    case 'o':
+      args->output = arg;
+      break;
     case 't':
       args->num_threads = getInt(state, arg, "number of threads");
       break;
+    case 'p':
+      args->places = arg;
+      break;
+    case 'b':
+      if (strcmp(arg, "false") != 0 && strcmp(arg, "true") != 0 && strcmp(arg, "master") != 0
+          && strcmp(arg, "close") != 0 && strcmp(arg, "spread") != 0)
+        argp_failure(state, 1, 0, "invalid bind policy. pick from false, true, master, close or spread.");
+
+      args->bind = arg;
+      break;
+    case 'n':
+      if (strcmp(arg, "first-touch") == 0)
+        args->placement = PLACEMENT_FIRST_TOUCH;
+      else if (strcmp(arg, "interleave") == 0)
+        args->placement = PLACEMENT_INTERLEAVE;
+      else {
+        args->placement = PLACEMENT_BIND;
+        args->placement_node = getInt(state, arg, "numa policy");
+
+        if (args->placement_node < 0 || args->placement_node >= 64)
+          argp_failure(state, 1, 0, "invalid numa node. pick from 0 to 63.");
+      }
+      break;
     case ARGP_KEY_INIT:
       args->debug_mode = 0;
       args->test_id = 0;
       args->iterations = 0;
       args->weighted = 0;
       args->num_threads = 1;
+      args->places = NULL;
+      args->bind = NULL;
+      args->placement = PLACEMENT_FIRST_TOUCH;
+      args->placement_node = 0;
+      args->element = "double";
+      args->width = 0;
+      args->input = NULL;
+      args->output = NULL;
+      args->bench = 0;
+      args->repetitions = 5;
+      args->warmup = 1;
+      args->sizes = NULL;
+      args->n_sizes = 0;
+      args->thread_list = NULL;
+      args->n_thread_list = 0;
+      args->format = BENCH_CSV;
+      args->tuning = NULL;
+      args->calibrate = 0;
+      args->regress = 0;
+      args->baseline = NULL;
+      args->record = 0;
+      args->tolerance = 20;
 
       if (state->argc == 1)
         argp_failure(state, 1, 0, "no arguments received.");
       break;
     case ARGP_KEY_END:
-      if (args->iterations <= 0)
-        argp_failure(state, 1, 0, "invalid number of iterations.");
+      // The regression suite picks its own tests and sizes
+      if (args->regress) {
+        if (args->iterations < 0)
+          argp_failure(state, 1, 0, "invalid number of iterations.");
+      } else {
+        if (args->iterations <= 0 && (args->input == NULL || args->iterations < 0) && args->sizes == NULL)
+          argp_failure(state, 1, 0, "invalid number of iterations.");
+
+        if (args->test_id <= 0)
+          argp_failure(state, 1, 0, "invalid test id..");
+      }
 
-      if (args->test_id <= 0)
-        argp_failure(state, 1, 0, "invalid test id..");
+      if (args->record && args->baseline == NULL)
+        argp_failure(state, 1, 0, "recording needs a baseline file to write.");
 
       if (args->num_threads < 1)
         argp_failure(state, 1, 0, "invalid number of threads.");
+
+      if (args->calibrate && args->tuning == NULL)
+        argp_failure(state, 1, 0, "calibration needs a tuning file to write.");
+
+      // Records keep every value aligned
+      if (args->width % unitElementSize(args->element) != 0)
+        argp_failure(state, 1, 0, "invalid element width. must be a multiple of %zu.", unitElementSize(args->element));
       break;
     default:
       return ARGP_ERR_UNKNOWN;
@@ -68,7 +218,7 @@ struct argp_option argp_options[] = {
         'i',
         "NUM_ITERATIONS",
         0,
-        "Number of iterations to run. Must be a positive integer",
+        "Number of iterations to run. Must be a positive integer. With an input file, optional limit of the elements read",
         0
     },
     {
@@ -87,6 +237,158 @@ struct argp_option argp_options[] = {
         "ID of test to run.",
         0
     },
+    {
+        "places",
+        'p',
+        "PLACES",
+        0,
+        "Places threads are bound to, as OMP_PLACES. Ex: threads, cores, sockets",
+        0
+    },
+    {
+        "bind",
+        'b',
+        "POLICY",
+        0,
+        "Thread binding, as OMP_PROC_BIND. Pick from false, true, master, close or spread",
+        0
+    },
+    {
+        "numa",
+        'n',
+        "POLICY",
+        0,
+        "Page placement of the buffers. Pick from first-touch, interleave or a node to bind to",
+        0
+    },
+    {
+        "element",
+        'e',
+        "TYPE",
+        0,
+        "Type of the values the patterns run on. Pick from char, int, int64, float or double. Default double",
+        0
+    },
+    {
+        "width",
+        'z',
+        "BYTES",
+        0,
+        "Bytes of every element, the value followed by an opaque payload. Default the size of the value",
+        0
+    },
+    {
+        "input",
+        'f',
+        "FILE",
+        0,
+        "Binary file of elements used as the source array instead of random numbers. Mapped, not read",
+        0
+    },
+    {
+        "output",
+        'o',
+        "FILE",
+        0,
+        "File the out-of-core tests write their result to",
+        0
+    },
+    {
+        "bench",
+        'B',
+        0,
+        0,
+        "Benchmark the test in process over every size and thread count, results go to stdout",
+        0
+    },
+    {
+        "repetitions",
+        'r',
+        "NUM_REPETITIONS",
+        0,
+        "Timed runs of the benchmark for every size and thread count. Default 5",
+        0
+    },
+    {
+        "warmup",
+        'u',
+        "NUM_RUNS",
+        0,
+        "Untimed runs of the benchmark before the repetitions. Default 1",
+        0
+    },
+    {
+        "sizes",
+        's',
+        "LIST",
+        0,
+        "Comma separated sizes swept by the benchmark. Ex: 1000,10000. Default the iterations",
+        0
+    },
+    {
+        "thread_list",
+        'T',
+        "LIST",
+        0,
+        "Comma separated thread counts swept by the benchmark. Ex: 1,2,4. Default the threads",
+        0
+    },
+    {
+        "format",
+        'F',
+        "FORMAT",
+        0,
+        "Format of the benchmark results. Pick from csv or json. Default csv",
+        0
+    },
+    {
+        "tuning",
+        'a',
+        "FILE",
+        0,
+        "Tuning file of the patterns, loaded before the test runs",
+        0
+    },
+    {
+        "calibrate",
+        'c',
+        0,
+        0,
+        "Tune the patterns for the element type up to the iterations and write the tuning file first",
+        0
+    },
+    {
+        "regress",
+        'R',
+        0,
+        0,
+        "Check every pattern against its serial reference and time it instead of running a test, results go to stdout",
+        0
+    },
+    {
+        "baseline",
+        'L',
+        "FILE",
+        0,
+        "Throughput baseline the regression suite compares with, recorded when it does not exist yet",
+        0
+    },
+    {
+        "record",
+        'W',
+        0,
+        0,
+        "Write the throughput of the regression suite to the baseline instead of comparing with it",
+        0
+    },
+    {
+        "tolerance",
+        'P',
+        "PERCENT",
+        0,
+        "Throughput a pattern may lose against the baseline before the regression suite fails. Default 20",
+        0
+    },
     {
         "weighted",
         'w',
@@ -108,3 +410,26 @@ int getInt(struct argp_state *state, char *arg, char *arg_name) {
 
   return val;
 }
+
+// Comma separated positive integers, returns the # values
+int getList(struct argp_state *state, char *arg, char *arg_name, size_t **values) {
+  int count = 1;
+
+  for (char *c = arg; *c != 0; c++)
+    count += *c == ',';
+
+  *values = malloc(count * sizeof(size_t));
+
+  for (int i = 0; i < count; i++) {
+    char *end;
+    long val = strtol(arg, &end, 10);
+
+    if (end == arg || val <= 0 || (*end != ',' && *end != 0))
+      argp_failure(state, 1, 0, "invalid format for %s", arg_name);
+
+    (*values)[i] = val;
+    arg = end + 1;
+  }
+
+  return count;
+}
@@ -1,10 +1,6 @@
 #include "argp.h"
-
-// Change this variable to change the datatype being used for operations
-#define TYPE double
-#define TYPE_SIZE sizeof(TYPE) * 1
-#define TYPE_FORMAT "%.1lf"
-#define TYPE_NAME "double"
+#include "context.h"
+#include "bench.h"
 
 // Argument structure
 typedef struct argp_args {
@@ -13,9 +9,31 @@ typedef struct argp_args {
     int weighted;
     int iterations;
     int num_threads;
+    char *places;               // OMP_PLACES, NULL keeps the environment
+    char *bind;                 // OMP_PROC_BIND, NULL keeps the environment
+    patternPlacement placement; // Page policy of the pattern buffers
+    int placement_node;         // Node of PLACEMENT_BIND
+    char *element;              // Type of the values the tests run on
+    size_t width;               // Bytes of every element, 0 for the size of the value
+    char *input;                // Binary file of elements used as src, NULL for random numbers
+    char *output;               // File the out-of-core tests write dest to, NULL keeps it in memory
+    int bench;                  // Run the in-process benchmark instead of a single run
+    int repetitions;            // Timed runs of the benchmark
+    int warmup;                 // Untimed runs of the benchmark
+    size_t *sizes;              // Sizes swept by the benchmark, NULL for the iterations
+    int n_sizes;
+    int *thread_list;           // Thread counts swept by the benchmark, NULL for the threads
+    int n_thread_list;
+    benchFormat format;         // Format of the benchmark results
+    char *tuning;               // Tuning file loaded at startup, NULL keeps the default settings
+    int calibrate;              // Tune the patterns and write the tuning file before the test
+    int regress;                // Run the regression suite instead of a test
+    char *baseline;             // Throughput baseline of the regression suite, NULL only checks the results
+    int record;                 // Write the baseline instead of comparing with it
+    int tolerance;              // Throughput in percent a pattern may lose against the baseline
     size_t count;
 } argp_args;
 
-struct argp_option argp_options[6];
+extern struct argp_option argp_options[];
 
 int argp_option_parser(int key, char *arg, struct argp_state *state);
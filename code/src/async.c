@@ -0,0 +1,341 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <omp.h>
+#include "async.h"
+#include "patterns.h"
+
+/*
+ *  HANDLES
+*/
+struct asyncHandle {
+    void (*run)(asyncHandle *handle, patternCtx *pctx);
+
+    // Arguments of the call
+    void *dest;
+    void *src;
+    size_t nJob;
+    size_t sizeJob;
+    void (*mapWorker)(void *v1, const void *v2);
+    void (*reduceWorker)(void *v1, const void *v2, const void *v3);
+    const int *filter;
+    int nFilter;
+    asyncTask task;
+    void *arg;
+
+    // First bytes of the buffers the call depends on
+    const char *reads[2];
+    char *writes;
+
+    asyncQueue *q;              // Queue the call runs on
+    int done;                   // Guarded by the lock of the queue
+    asyncHandle *nextPending;   // Next call to be handed to the team
+    asyncHandle *prev;          // Handles of the queue not waited for yet
+    asyncHandle *next;
+};
+
+struct asyncQueue {
+    pthread_t dispatcher;
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;   // A call was submitted or the queue is stopping
+    pthread_cond_t finished;    // A call finished
+
+    asyncHandle *firstPending;  // Calls not handed to the team yet, in submission order
+    asyncHandle *lastPending;
+    asyncHandle *live;          // Every handle not waited for yet
+    size_t nUnfinished;         // Calls submitted and not finished
+    int stopping;
+
+    int nWorkers;
+    int nCallThreads;
+    patternCtx **ctx;           // Context of each thread of the team, tasks are tied so they never share one
+};
+
+static void runMap(asyncHandle *h, patternCtx *pctx) {
+  mapCtx(h->dest, h->src, h->nJob, h->sizeJob, h->mapWorker, pctx);
+}
+
+static void runReduce(asyncHandle *h, patternCtx *pctx) {
+  reduceCtx(h->dest, h->src, h->nJob, h->sizeJob, h->reduceWorker, pctx);
+}
+
+static void runScan(asyncHandle *h, patternCtx *pctx) {
+  scanCtx(h->dest, h->src, h->nJob, h->sizeJob, h->reduceWorker, pctx);
+}
+
+static void runGather(asyncHandle *h, patternCtx *pctx) {
+  gatherCtx(h->dest, h->src, h->nJob, h->sizeJob, h->filter, h->nFilter, pctx);
+}
+
+static void runTask(asyncHandle *h, patternCtx *pctx) {
+  h->task(h->arg, pctx);
+}
+
+/*
+ *  QUEUE
+*/
+
+// Next call for the team, NULL once the queue is stopping and every call was handed out
+static asyncHandle *nextPending(asyncQueue *q) {
+  pthread_mutex_lock(&q->lock);
+
+  while (q->firstPending == NULL && !q->stopping)
+    pthread_cond_wait(&q->submitted, &q->lock);
+
+  asyncHandle *h = q->firstPending;
+
+  if (h != NULL) {
+    q->firstPending = h->nextPending;
+
+    if (q->firstPending == NULL)
+      q->lastPending = NULL;
+  }
+
+  pthread_mutex_unlock(&q->lock);
+
+  return h;
+}
+
+static void execute(asyncQueue *q, asyncHandle *h) {
+  h->run(h, q->ctx[omp_get_thread_num()]);
+
+  pthread_mutex_lock(&q->lock);
+
+  h->done = 1;
+  q->nUnfinished--;
+
+  pthread_cond_broadcast(&q->finished);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static void *dispatch(void *arg) {
+  asyncQueue *q = arg;
+
+  // The team is the first level, calls with a team of their own need the next one
+  if (q->nCallThreads > 1 && omp_get_max_active_levels() < 2)
+    omp_set_max_active_levels(2);
+
+  /*
+   * The single thread hands the calls out as sibling tasks, so the runtime tracks the
+   * dependences between them. The rest of the team waits at the end of the single
+   * construct, which is where it picks up the tasks
+  */
+
+  #pragma omp parallel default(none) shared(q) num_threads(q->nWorkers + 1)
+  #pragma omp single
+  {
+    asyncHandle *h;
+
+    while ((h = nextPending(q)) != NULL) {
+      #pragma omp task default(none) firstprivate(q, h) depend(in: *h->reads[0], *h->reads[1]) depend(out: *h->writes)
+      execute(q, h);
+    }
+  }
+
+  return NULL;
+}
+
+// Missing buffers point at the handle itself, which nothing else depends on
+static asyncHandle *submit(asyncQueue *q, asyncHandle *h, const void *read0, const void *read1, void *writes) {
+  assert (q != NULL);
+
+  h->reads[0] = read0 != NULL ? read0 : (const char *) h;
+  h->reads[1] = read1 != NULL ? read1 : h->reads[0];
+  h->writes = writes != NULL ? writes : (char *) h;
+  h->q = q;
+
+  pthread_mutex_lock(&q->lock);
+
+  h->next = q->live;
+  if (q->live != NULL)
+    q->live->prev = h;
+  q->live = h;
+
+  if (q->lastPending != NULL)
+    q->lastPending->nextPending = h;
+  else
+    q->firstPending = h;
+  q->lastPending = h;
+
+  q->nUnfinished++;
+
+  pthread_cond_signal(&q->submitted);
+  pthread_mutex_unlock(&q->lock);
+
+  return h;
+}
+
+asyncQueue *asyncCreate(int nWorkers, int nCallThreads) {
+  assert (nWorkers >= 0);
+  assert (nCallThreads >= 0);
+
+  asyncQueue *q = calloc(1, sizeof(asyncQueue));
+
+  q->nWorkers = nWorkers > 0 ? nWorkers : omp_get_max_threads();
+  q->nCallThreads = nCallThreads > 0 ? nCallThreads : 1;
+  q->ctx = malloc((q->nWorkers + 1) * sizeof(patternCtx *));
+
+  for (int t = 0; t <= q->nWorkers; t++)
+    q->ctx[t] = patternCtxCreate(q->nCallThreads, SCHEDULE_STATIC, 0);
+
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->submitted, NULL);
+  pthread_cond_init(&q->finished, NULL);
+
+  pthread_create(&q->dispatcher, NULL, dispatch, q);
+
+  return q;
+}
+
+void asyncDestroy(asyncQueue *q) {
+  pthread_mutex_lock(&q->lock);
+  q->stopping = 1;
+  pthread_cond_signal(&q->submitted);
+  pthread_mutex_unlock(&q->lock);
+
+  // The team finishes every task before its region ends
+  pthread_join(q->dispatcher, NULL);
+
+  while (q->live != NULL) {
+    asyncHandle *next = q->live->next;
+
+    free(q->live);
+    q->live = next;
+  }
+
+  for (int t = 0; t <= q->nWorkers; t++)
+    patternCtxDestroy(q->ctx[t]);
+
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->submitted);
+  pthread_cond_destroy(&q->finished);
+
+  free(q->ctx);
+  free(q);
+}
+
+/*
+ *  FUTURES
+*/
+
+int asyncTest(asyncHandle *handle) {
+  assert (handle != NULL);
+
+  asyncQueue *q = handle->q;
+
+  pthread_mutex_lock(&q->lock);
+  int done = handle->done;
+  pthread_mutex_unlock(&q->lock);
+
+  return done;
+}
+
+void asyncWait(asyncHandle *handle) {
+  assert (handle != NULL);
+
+  asyncQueue *q = handle->q;
+
+  pthread_mutex_lock(&q->lock);
+
+  while (!handle->done)
+    pthread_cond_wait(&q->finished, &q->lock);
+
+  if (handle->prev != NULL)
+    handle->prev->next = handle->next;
+  else
+    q->live = handle->next;
+
+  if (handle->next != NULL)
+    handle->next->prev = handle->prev;
+
+  pthread_mutex_unlock(&q->lock);
+
+  free(handle);
+}
+
+void asyncDrain(asyncQueue *q) {
+  assert (q != NULL);
+
+  pthread_mutex_lock(&q->lock);
+
+  while (q->nUnfinished > 0)
+    pthread_cond_wait(&q->finished, &q->lock);
+
+  pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ *  PATTERNS
+*/
+
+static asyncHandle *newHandle(void (*run)(asyncHandle *handle, patternCtx *pctx), void *dest, void *src, size_t nJob, size_t sizeJob) {
+  asyncHandle *h = calloc(1, sizeof(asyncHandle));
+
+  h->run = run;
+  h->dest = dest;
+  h->src = src;
+  h->nJob = nJob;
+  h->sizeJob = sizeJob;
+
+  return h;
+}
+
+asyncHandle *mapAsync(asyncQueue *q, void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2)) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  asyncHandle *h = newHandle(runMap, dest, src, nJob, sizeJob);
+
+  h->mapWorker = worker;
+
+  return submit(q, h, src, NULL, dest);
+}
+
+asyncHandle *reduceAsync(asyncQueue *q, void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  asyncHandle *h = newHandle(runReduce, dest, src, nJob, sizeJob);
+
+  h->reduceWorker = worker;
+
+  return submit(q, h, src, NULL, dest);
+}
+
+asyncHandle *scanAsync(asyncQueue *q, void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  asyncHandle *h = newHandle(runScan, dest, src, nJob, sizeJob);
+
+  h->reduceWorker = worker;
+
+  return submit(q, h, src, NULL, dest);
+}
+
+asyncHandle *gatherAsync(asyncQueue *q, void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (filter != NULL);
+
+  asyncHandle *h = newHandle(runGather, dest, src, nJob, sizeJob);
+
+  h->filter = filter;
+  h->nFilter = nFilter;
+
+  return submit(q, h, src, filter, dest);
+}
+
+asyncHandle *asyncRun(asyncQueue *q, asyncTask task, void *arg, const void *reads, void *writes) {
+  assert (task != NULL);
+
+  asyncHandle *h = newHandle(runTask, NULL, NULL, 0, 0);
+
+  h->task = task;
+  h->arg = arg;
+
+  return submit(q, h, reads, NULL, writes);
+}
@@ -0,0 +1,86 @@
+#ifndef __ASYNC_H
+#define __ASYNC_H
+
+#include <stddef.h>
+#include "context.h"
+
+/*
+ * Asynchronous patterns - calls return a handle right away and run as OpenMP tasks
+ * on the team of their queue. Every call depends on the buffers it reads and writes,
+ * so calls on the same buffers run in submission order with no join on the caller
+ * side and the others run concurrently. Buffers are told apart by their first byte,
+ * calls on overlapping buffers that start at different addresses are not ordered.
+ */
+
+typedef struct asyncQueue asyncQueue;
+
+typedef struct asyncHandle asyncHandle;
+
+// [ runs on a worker of the queue, patterns called from it should use pctx ]
+typedef void (*asyncTask)(void *arg, patternCtx *pctx);
+
+// Starts the team of a queue, the queue takes one more thread to hand out the calls
+asyncQueue *asyncCreate(
+    int nWorkers,         // # calls running at the same time, 0 for omp_get_max_threads
+    int nCallThreads      // # threads of each call, 0 for one
+);
+
+// Waits for every call of the queue and stops its team, handles not waited for are freed
+void asyncDestroy(asyncQueue *q);
+
+// 1 once the call has finished, the handle stays valid until it is waited for
+int asyncTest(asyncHandle *handle);
+
+// Blocks until the call has finished and frees the handle
+void asyncWait(asyncHandle *handle);
+
+// Blocks until every call submitted so far has finished
+void asyncDrain(asyncQueue *q);
+
+asyncHandle *mapAsync(
+    asyncQueue *q,        // Queue to run on
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2) // [ v1 = op (v2) ]
+);
+
+asyncHandle *reduceAsync(
+    asyncQueue *q,        // Queue to run on
+    void *dest,           // Target value
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+asyncHandle *scanAsync(
+    asyncQueue *q,        // Queue to run on
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+asyncHandle *gatherAsync(
+    asyncQueue *q,        // Queue to run on
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    const int *filter,    // Filter for gather, left untouched until the call finishes
+    int nFilter           // # elements in the filter
+);
+
+// Any other work, e.g. a batch of a pipeline, ordered on one buffer it reads and one it writes
+asyncHandle *asyncRun(
+    asyncQueue *q,        // Queue to run on
+    asyncTask task,       // Work of the call
+    void *arg,            // User data for the task
+    const void *reads,    // Buffer the task reads, may be NULL
+    void *writes          // Buffer the task writes, may be NULL
+);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <assert.h>
+#include <omp.h>
+#include "bench.h"
+
+static int compareDouble(const void *a, const void *b) {
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+benchStats benchSummarize(double *samples, int nSamples) {
+  assert (samples != NULL);
+  assert (nSamples > 0);
+
+  benchStats stats;
+  double sum = 0;
+  double squares = 0;
+
+  qsort(samples, nSamples, sizeof(double), compareDouble);
+
+  for (int i = 0; i < nSamples; i++)
+    sum += samples[i];
+
+  stats.mean = sum / nSamples;
+
+  for (int i = 0; i < nSamples; i++)
+    squares += (samples[i] - stats.mean) * (samples[i] - stats.mean);
+
+  stats.min = samples[0];
+  stats.median = nSamples % 2 ? samples[nSamples / 2] : (samples[nSamples / 2 - 1] + samples[nSamples / 2]) / 2;
+  stats.p95 = samples[(int) ceil(0.95 * nSamples) - 1];
+  stats.stddev = nSamples > 1 ? sqrt(squares / (nSamples - 1)) : 0;
+
+  return stats;
+}
+
+// Time of one run, from the start the test reports until it returns
+static double benchTime(TESTFUNCTION test, void *src, size_t nJob, size_t sizeJob) {
+  double start = test(src, nJob, sizeJob);
+
+  return (omp_get_wtime() - start) * 1e6;
+}
+
+static void benchRecord(const benchConfig *config, const char *name, size_t nJob, int nThreads, const benchStats *stats, int first) {
+  if (config->format == BENCH_CSV) {
+    if (first)
+      fprintf(config->out, "test,size,threads,repetitions,min,median,p95,mean,stddev\n");
+
+    fprintf(config->out, "\"%s\",%zu,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", name, nJob, nThreads,
+            config->repetitions, stats->min, stats->median, stats->p95, stats->mean, stats->stddev);
+  } else {
+    fprintf(config->out, "%s\n  {\"test\": \"%s\", \"size\": %zu, \"threads\": %d, \"repetitions\": %d, "
+                         "\"min\": %.3f, \"median\": %.3f, \"p95\": %.3f, \"mean\": %.3f, \"stddev\": %.3f}",
+            first ? "[" : ",", name, nJob, nThreads, config->repetitions,
+            stats->min, stats->median, stats->p95, stats->mean, stats->stddev);
+  }
+}
+
+void benchRun(const benchConfig *config, TESTFUNCTION test, const char *name, void *src, size_t sizeJob) {
+  assert (config != NULL);
+  assert (test != NULL);
+  assert (config->repetitions > 0);
+  assert (config->warmup >= 0);
+
+  double *samples = malloc(config->repetitions * sizeof(double));
+  int first = 1;
+
+  for (int s = 0; s < config->nSizes; s++) {
+    for (int t = 0; t < config->nThreads; t++) {
+      // Every pattern sizes its team from the default context, which follows this
+      omp_set_num_threads(config->threads[t]);
+
+      // Some tests size their own arrays from the iterations
+      ITERATIONS = config->sizes[s] < INT_MAX ? (int) config->sizes[s] : INT_MAX;
+
+      for (int r = 0; r < config->warmup; r++)
+        benchTime(test, src, config->sizes[s], sizeJob);
+
+      for (int r = 0; r < config->repetitions; r++)
+        samples[r] = benchTime(test, src, config->sizes[s], sizeJob);
+
+      benchStats stats = benchSummarize(samples, config->repetitions);
+
+      benchRecord(config, name, config->sizes[s], config->threads[t], &stats, first);
+      first = 0;
+
+      fflush(config->out);
+    }
+  }
+
+  if (config->format == BENCH_JSON)
+    fprintf(config->out, first ? "[]\n" : "\n]\n");
+
+  free(samples);
+}
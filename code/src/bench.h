@@ -0,0 +1,53 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "unit.h"
+
+/*
+ * In-process benchmark - runs a test function over every size and thread count
+ * in one process, so caches and the OpenMP team are warm before the timed runs.
+ * Times are in microseconds, taken the same way as a single run of main.
+ */
+
+typedef enum benchFormat {
+    BENCH_CSV,
+    BENCH_JSON
+} benchFormat;
+
+typedef struct benchConfig {
+    int warmup;                 // Untimed runs before the repetitions
+    int repetitions;            // Timed runs of every size and thread count
+    const size_t *sizes;        // # elements of every size
+    int nSizes;                 // # sizes
+    const int *threads;         // # threads of every thread count
+    int nThreads;               // # thread counts
+    benchFormat format;         // Format of the results
+    FILE *out;                  // Target stream of the results
+} benchConfig;
+
+typedef struct benchStats {
+    double min;
+    double median;
+    double p95;                 // Nearest rank 95th percentile
+    double mean;
+    double stddev;              // Sample standard deviation, 0 for a single repetition
+} benchStats;
+
+// Statistics of the samples, which are sorted in place
+benchStats benchSummarize(
+    double *samples,            // Timed runs
+    int nSamples                // # timed runs, at least one
+);
+
+// Runs one test over the whole sweep and writes one record per size and thread count
+void benchRun(
+    const benchConfig *config,  // Sweep and output
+    TESTFUNCTION test,          // Test to be timed
+    const char *name,           // Name of the test in the records
+    void *src,                  // Source array, holds at least the largest size
+    size_t sizeJob              // Size of each element in the source array
+);
+
+#endif
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include <omp.h>
+#include "context.h"
+
+// Used when the cache size cannot be queried
+#define DEFAULT_L2_BYTES (256 * 1024)
+
+// Work below which a call costs less than waking the team, when the context does not set it
+#define DISPATCH_SERIAL_BYTES (16 * 1024)
+
+// Cost hint from which static tiles are as slow as their slowest elements
+#define DISPATCH_TASK_COST 4096
+
+// Each OS thread gets its own default context, so patterns called from inside
+// another pattern never share one
+static _Thread_local patternCtx defaultCtx;
+
+// Process wide, set once from the command line
+static patternPlacement defaultPlacement = PLACEMENT_FIRST_TOUCH;
+static int defaultPlacementNode = 0;
+
+patternCtx *patternCtxCreate(int nThreads, patternSchedule schedule, int chunkSize) {
+  assert (nThreads >= 0);
+  assert (chunkSize >= 0);
+
+  patternCtx *ctx = calloc(1, sizeof(patternCtx));
+
+  ctx->nThreads = nThreads == 0 ? omp_get_max_threads() : nThreads;
+  ctx->schedule = schedule;
+  ctx->chunkSize = chunkSize;
+  ctx->placement = defaultPlacement;
+  ctx->placementNode = defaultPlacementNode;
+  ctx->offloadDevice = -1;
+
+  return ctx;
+}
+
+void patternCtxDestroy(patternCtx *ctx) {
+  arenaDestroy(&ctx->arena);
+
+  for (int i = 0; i < ctx->nThreadArenas; i++)
+    arenaDestroy(&ctx->threadArenas[i]);
+
+  free(ctx->threadArenas);
+  free(ctx);
+}
+
+patternCtx *patternCtxDefault(void) {
+  defaultCtx.nThreads = omp_get_max_threads();
+  defaultCtx.schedule = SCHEDULE_STATIC;
+  defaultCtx.chunkSize = 0;
+  defaultCtx.blockBytes = 0;
+  defaultCtx.scatter = SCATTER_CLAIM;
+  defaultCtx.reduce = REDUCE_TILED;
+  defaultCtx.reduceBlock = 0;
+  defaultCtx.placement = defaultPlacement;
+  defaultCtx.placementNode = defaultPlacementNode;
+  defaultCtx.windowBytes = 0;
+  defaultCtx.gather = GATHER_DIRECT;
+  defaultCtx.gatherPrefetch = 0;
+  defaultCtx.gatherBucketBytes = 0;
+  defaultCtx.offloadDevice = -1;
+  defaultCtx.offloadMinJobs = 0;
+  defaultCtx.sortCutoff = 0;
+  defaultCtx.workerCost = 0;
+  defaultCtx.serialBytes = 0;
+
+  return &defaultCtx;
+}
+
+void patternCtxSetDefaultPlacement(patternPlacement placement, int node) {
+  assert (node >= 0);
+
+  defaultPlacement = placement;
+  defaultPlacementNode = node;
+}
+
+size_t patternCtxBlockSize(const patternCtx *ctx, size_t sizeJob) {
+  size_t blockBytes = ctx->blockBytes;
+
+  // Half of L2 leaves room for the rest of the working set of the stages
+  if (blockBytes == 0) {
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    blockBytes = (l2 > 0 ? (size_t) l2 : DEFAULT_L2_BYTES) / 2;
+  }
+
+  return blockBytes < sizeJob ? 1 : blockBytes / sizeJob;
+}
+
+patternArena *patternCtxArena(patternCtx *ctx) {
+  // Make sure every thread of the upcoming team has an arena
+  if (ctx->nThreadArenas < ctx->nThreads) {
+    ctx->threadArenas = realloc(ctx->threadArenas, ctx->nThreads * sizeof(patternArena));
+
+    for (int i = ctx->nThreadArenas; i < ctx->nThreads; i++)
+      arenaInit(&ctx->threadArenas[i], 0);
+
+    ctx->nThreadArenas = ctx->nThreads;
+  }
+
+  return &ctx->arena;
+}
+
+patternArena *patternCtxThreadArena(patternCtx *ctx, int thread) {
+  assert (thread >= 0 && thread < ctx->nThreadArenas);
+
+  return &ctx->threadArenas[thread];
+}
+
+patternExec patternCtxDispatch(const patternCtx *ctx, int nThreads, size_t nJob, size_t sizeJob) {
+  size_t serialBytes = ctx->serialBytes > 0 ? ctx->serialBytes : DISPATCH_SERIAL_BYTES;
+  size_t weight = sizeJob + ctx->workerCost;
+
+  // Saturates instead of wrapping around on huge calls
+  size_t work = weight > 0 && nJob > SIZE_MAX / weight ? SIZE_MAX : nJob * weight;
+
+  if (nThreads <= 1 || nJob <= 1 || work < serialBytes)
+    return EXEC_SERIAL;
+
+  if (ctx->workerCost >= DISPATCH_TASK_COST && nJob >= 2 * (size_t) nThreads)
+    return EXEC_TASKS;
+
+  return EXEC_REGION;
+}
+
+const char *patternExecName(patternExec exec) {
+  switch (exec) {
+    case EXEC_SERIAL:
+      return "serial";
+    case EXEC_TASKS:
+      return "tasks";
+    default:
+      return "region";
+  }
+}
+
+void patternCtxApplySchedule(const patternCtx *ctx) {
+  switch (ctx->schedule) {
+    case SCHEDULE_DYNAMIC:
+      omp_set_schedule(omp_sched_dynamic, ctx->chunkSize);
+      break;
+    case SCHEDULE_GUIDED:
+      omp_set_schedule(omp_sched_guided, ctx->chunkSize);
+      break;
+    default:
+      omp_set_schedule(omp_sched_static, ctx->chunkSize);
+  }
+}
@@ -0,0 +1,119 @@
+#ifndef __CONTEXT_H
+#define __CONTEXT_H
+
+#include <stddef.h>
+#include "arena.h"
+
+// Schedule used by the element wise loops of the patterns
+typedef enum patternSchedule {
+    SCHEDULE_STATIC,
+    SCHEDULE_DYNAMIC,
+    SCHEDULE_GUIDED
+} patternSchedule;
+
+// How scatter resolves several elements landing on the same slot
+typedef enum patternScatter {
+    SCATTER_CLAIM,              // Per slot atomic claims, the highest source index wins
+    SCATTER_SORTED              // Sorts a permutation of the filter, the highest source index wins
+} patternScatter;
+
+// How reduce splits the work and combines the partials, both start from a zeroed value
+typedef enum patternReduce {
+    REDUCE_TILED,               // One tile per thread, partials combined in tile order
+    REDUCE_DETERMINISTIC        // Fixed blocks and a pairwise tree, same result for any # threads
+} patternReduce;
+
+// How gather walks the source
+typedef enum patternGather {
+    GATHER_DIRECT,              // Filter order, loads prefetched ahead
+    GATHER_BUCKETED             // Filter positions sorted by source region first, reads stay local
+} patternGather;
+
+// How a pattern call runs, picked by patternCtxDispatch from the work of the call
+typedef enum patternExec {
+    EXEC_SERIAL,                // Plain loop on the calling thread, no team and as little scratch as the pattern allows
+    EXEC_REGION,                // One parallel region over tiles or a scheduled loop
+    EXEC_TASKS                  // Tasks over split ranges, for costly or uneven workers
+} patternExec;
+
+// Where the pages of the buffers allocated through placementAlloc live
+typedef enum patternPlacement {
+    PLACEMENT_FIRST_TOUCH,      // Node of the thread that first writes each page
+    PLACEMENT_INTERLEAVE,       // Round robin over every node with memory
+    PLACEMENT_BIND              // Only placementNode
+} patternPlacement;
+
+/*
+ * Pattern context - created once and handed to the *Ctx variants of the patterns,
+ * so repeated calls share their configuration instead of rediscovering it every time.
+ * A context must only be used by one caller thread at a time.
+ */
+typedef struct patternCtx {
+    int nThreads;               // # threads in the team of every pattern
+    patternSchedule schedule;   // Schedule of the element wise loops
+    int chunkSize;              // Chunk size of the schedule, 0 for the OpenMP default
+    size_t blockBytes;          // Block of the fused pipeline, 0 derives it from the L2 cache
+    patternScatter scatter;     // Collision handling of scatter
+    patternReduce reduce;       // Blocking and combine order of reduce
+    size_t reduceBlock;         // Leaf block of the deterministic reduce, 0 for the default
+    patternPlacement placement; // Page policy of placementAlloc
+    int placementNode;          // Node of PLACEMENT_BIND
+    size_t windowBytes;         // Window of the out-of-core patterns, 0 for the default
+    patternGather gather;       // Access order of gather
+    int gatherPrefetch;         // Elements gather prefetches ahead, 0 for the default, -1 for none
+    size_t gatherBucketBytes;   // Source region of each gather bucket, 0 for the default
+    int offloadDevice;          // Device of the offload patterns, -1 for the OpenMP default device
+    size_t offloadMinJobs;      // # elements below which offload runs on the CPU, 0 for the default
+    size_t sortCutoff;          // # elements below which quickSort stops making tasks, 0 for the default
+    size_t workerCost;          // Cost hint of one worker call, in bytes of memory traffic it weighs as, 0 for none
+    size_t serialBytes;         // Work below which patterns run serially, 0 for the default
+    patternArena arena;         // Scratch of the calling thread
+    patternArena *threadArenas; // Scratch of each thread of the team
+    int nThreadArenas;          // # thread arenas allocated
+} patternCtx;
+
+patternCtx *patternCtxCreate(
+    int nThreads,               // # threads, 0 for omp_get_max_threads()
+    patternSchedule schedule,   // Schedule of the element wise loops
+    int chunkSize               // Chunk size of the schedule, 0 for the OpenMP default
+);
+
+void patternCtxDestroy(patternCtx *ctx);
+
+// Context used by the plain patterns, follows omp_get_max_threads() of the calling thread
+patternCtx *patternCtxDefault(void);
+
+// Placement every context starts with, the default context included
+void patternCtxSetDefaultPlacement(
+    patternPlacement placement, // Page policy of placementAlloc
+    int node                    // Node of PLACEMENT_BIND, ignored by the other policies
+);
+
+// # elements of sizeJob bytes in a fused pipeline block
+size_t patternCtxBlockSize(const patternCtx *ctx, size_t sizeJob);
+
+// Scratch arena of the calling thread, use it outside of parallel regions
+patternArena *patternCtxArena(patternCtx *ctx);
+
+// Scratch arena of a thread of the team, patternCtxArena has to be called before the region
+patternArena *patternCtxThreadArena(patternCtx *ctx, int thread);
+
+/*
+ * Execution mode of a call of nJob elements on a team of nThreads. The work is nJob times
+ * sizeJob plus the cost hint, calls below serialBytes of work or without a team to share it
+ * run serially and workers at least DISPATCH_TASK_COST heavy are split into tasks
+ */
+patternExec patternCtxDispatch(
+    const patternCtx *ctx,      // Context of the call
+    int nThreads,               // # threads the call would start
+    size_t nJob,                // # elements of the call
+    size_t sizeJob              // Bytes each element weighs, the size of the elements for most patterns
+);
+
+// Name of an execution mode, for reports
+const char *patternExecName(patternExec exec);
+
+// Installs the context schedule for schedule(runtime) loops, call it inside the parallel region
+void patternCtxApplySchedule(const patternCtx *ctx);
+
+#endif
@@ -1,6 +1,6 @@
 #include <stdio.h>
 #include <unistd.h>
-#include "args.h"
+#include "unit.h"
 
 int DEBUG_MODE = 0;
 
@@ -26,13 +26,15 @@ void printInt(const int *src, size_t n, const char *msg) {
   }
 }
 
-void printTYPE(const TYPE *src, size_t n, const char *msg) {
+void printTYPE(const void *src, size_t n, const char *msg) {
   if (DEBUG_MODE) {
-    printf("%s %s: ", msg, TYPE_NAME);
+    const char *s = src;
+
+    printf("%s %s: ", msg, ELEMENT_NAME);
 
     for (int i = 0; i < (int) n; i++) {
       printf("[%d] = ", i);
-      printf(TYPE_FORMAT, src[i]);
+      unitPrintElement(&s[i * ELEMENT_WIDTH]);
       printf("\t");
     }
 
@@ -7,6 +7,7 @@ void printDouble(const double *src, size_t n, const char *msg);
 
 void printInt(const int *src, size_t n, const char *msg);
 
-void printTYPE(void *src, size_t n, const char *msg);
+// Elements of the type picked on the command line
+void printTYPE(const void *src, size_t n, const char *msg);
 
 #endif
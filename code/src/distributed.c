@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include "distributed.h"
+#include "patterns.h"
+
+/*
+ *  UTILS
+*/
+
+static size_t min(size_t a, size_t b) {
+  return a < b ? a : b;
+}
+
+static size_t max(size_t a, size_t b) {
+  return a > b ? a : b;
+}
+
+// MPI counts are ints, so counts and displacements are taken in elements of this type
+static MPI_Datatype elementType(size_t sizeJob) {
+  assert (sizeJob > 0 && sizeJob <= INT_MAX);
+
+  MPI_Datatype type;
+
+  MPI_Type_contiguous((int) sizeJob, MPI_BYTE, &type);
+  MPI_Type_commit(&type);
+
+  return type;
+}
+
+static int mpiCount(size_t count) {
+  if (count > INT_MAX) {
+    fprintf(stderr, "Block of %zu elements too large for MPI\n", count);
+    exit(1);
+  }
+
+  return (int) count;
+}
+
+static size_t blockStart(size_t nJob, int nRanks, int rank) {
+  size_t blockSize = nJob / nRanks;
+  size_t leftOver = nJob % nRanks;
+
+  return rank * blockSize + ((size_t) rank < leftOver ? (size_t) rank : leftOver);
+}
+
+// Counts and displacements of the even blocks of every rank
+static void blockCounts(int *counts, int *displs, size_t nJob, int nRanks) {
+  for (int rank = 0; rank < nRanks; rank++) {
+    counts[rank] = mpiCount(blockStart(nJob, nRanks, rank + 1) - blockStart(nJob, nRanks, rank));
+    displs[rank] = mpiCount(blockStart(nJob, nRanks, rank));
+  }
+}
+
+/*
+ *  PARTIALS
+*/
+
+/*
+ * A partial is its value followed by one byte that is 1 when the value exists. Empty
+ * blocks have no value and the operators have no identity to stand in for one, so
+ * the combine skips them instead of feeding the worker a zero.
+*/
+
+// User operators get no context, the worker of the running collective is kept here
+static void (*partialWorker)(void *v1, const void *v2, const void *v3);
+static size_t partialSize;
+static char *partialScratch;  // Three aligned values, the flag makes the partials themselves unaligned
+
+// MPI hands the partials of the lower ranks in in, inout becomes [ in op inout ]
+static void combinePartials(void *in, void *inout, int *len, MPI_Datatype *type) {
+  (void) type;
+
+  size_t stride = partialSize + 1;
+  char *a = in;
+  char *b = inout;
+
+  for (int i = 0; i < *len; i++) {
+    char *lower = &a[i * stride];
+    char *upper = &b[i * stride];
+
+    if (!lower[partialSize])
+      continue;
+
+    if (!upper[partialSize]) {
+      memcpy(upper, lower, stride);
+      continue;
+    }
+
+    memcpy(&partialScratch[partialSize], lower, partialSize);
+    memcpy(&partialScratch[2 * partialSize], upper, partialSize);
+
+    partialWorker(partialScratch, &partialScratch[partialSize], &partialScratch[2 * partialSize]);
+    memcpy(upper, partialScratch, partialSize);
+  }
+}
+
+// Reduces a block with at least one element, every tile folds from its own first element so no identity is needed
+static void blockPartial(char *partial, const char *s, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3),
+                         patternCtx *pctx, patternArena *arena) {
+  int serial = patternCtxDispatch(pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL;
+  int nTiles = serial ? 1 : (int) min(nJob, pctx->nThreads);
+  char *tiles = arenaAlloc(arena, nTiles * sizeJob);
+
+  #pragma omp parallel for default(none) shared(tiles, s, nJob, sizeJob, worker, nTiles) \
+  schedule(static) num_threads(nTiles) if (!serial)
+  for (int tile = 0; tile < nTiles; tile++) {
+    size_t first = blockStart(nJob, nTiles, tile);
+    size_t last = blockStart(nJob, nTiles, tile + 1);
+
+    memcpy(&tiles[tile * sizeJob], &s[first * sizeJob], sizeJob);
+
+    for (size_t i = first + 1; i < last; i++)
+      worker(&tiles[tile * sizeJob], &tiles[tile * sizeJob], &s[i * sizeJob]);
+  }
+
+  // Tiles in order, the worker does not have to be commutative
+  memcpy(partial, tiles, sizeJob);
+
+  for (int tile = 1; tile < nTiles; tile++)
+    worker(partial, partial, &tiles[tile * sizeJob]);
+}
+
+// Reduces the block of every rank and combines the partials of the ranks before it, or of all of them
+// Returns 0 when none of those ranks had an element, dest is then left untouched
+static int rankPartials(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3),
+                        int exclusive, MPI_Comm comm, patternCtx *pctx) {
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *partial = arenaAlloc(arena, sizeJob + 1);
+  char *combined = arenaAlloc(arena, sizeJob + 1);
+
+  if (nJob > 0)
+    blockPartial(partial, src, nJob, sizeJob, worker, pctx, arena);
+
+  partial[sizeJob] = nJob > 0;
+
+  // Not commutative, MPI then keeps the partials in rank order
+  MPI_Datatype type = elementType(sizeJob + 1);
+  MPI_Op op;
+  int rank;
+
+  MPI_Comm_rank(comm, &rank);
+
+  partialWorker = worker;
+  partialSize = sizeJob;
+  partialScratch = arenaAlloc(arena, 3 * sizeJob);
+
+  MPI_Op_create(combinePartials, 0, &op);
+
+  if (exclusive)
+    MPI_Exscan(partial, combined, 1, type, op, comm);
+  else
+    MPI_Allreduce(partial, combined, 1, type, op, comm);
+
+  // MPI_Exscan leaves the first rank undefined
+  int hasValue = (!exclusive || rank > 0) && combined[sizeJob];
+
+  if (hasValue)
+    memcpy(dest, combined, sizeJob);
+
+  MPI_Op_free(&op);
+  MPI_Type_free(&type);
+
+  arenaRelease(arena, mark);
+
+  return hasValue;
+}
+
+/*
+ *  BLOCKS
+*/
+
+size_t distributedBlock(size_t nJob, MPI_Comm comm, size_t *first) {
+  int rank;
+  int nRanks;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  if (first != NULL)
+    *first = blockStart(nJob, nRanks, rank);
+
+  return blockStart(nJob, nRanks, rank + 1) - blockStart(nJob, nRanks, rank);
+}
+
+void distributedScatter(void *dest, void *src, size_t nJob, size_t sizeJob, int root, MPI_Comm comm) {
+  assert (dest != NULL || distributedBlock(nJob, comm, NULL) == 0);
+
+  int rank;
+  int nRanks;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  int *counts = malloc(nRanks * sizeof(int));
+  int *displs = malloc(nRanks * sizeof(int));
+  MPI_Datatype type = elementType(sizeJob);
+
+  blockCounts(counts, displs, nJob, nRanks);
+
+  MPI_Scatterv(src, counts, displs, type, dest, counts[rank], type, root, comm);
+
+  MPI_Type_free(&type);
+  free(counts);
+  free(displs);
+}
+
+void distributedGather(void *dest, void *src, size_t nJob, size_t sizeJob, int root, MPI_Comm comm) {
+  assert (src != NULL || distributedBlock(nJob, comm, NULL) == 0);
+
+  int rank;
+  int nRanks;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  int *counts = malloc(nRanks * sizeof(int));
+  int *displs = malloc(nRanks * sizeof(int));
+  MPI_Datatype type = elementType(sizeJob);
+
+  blockCounts(counts, displs, nJob, nRanks);
+
+  MPI_Gatherv(src, counts[rank], type, dest, counts, displs, type, root, comm);
+
+  MPI_Type_free(&type);
+  free(counts);
+  free(displs);
+}
+
+/*
+ *  PATTERNS
+*/
+
+void distributedMapCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), MPI_Comm comm, patternCtx *pctx) {
+  (void) comm;
+
+  mapCtx(dest, src, nJob, sizeJob, worker, pctx);
+}
+
+void distributedMap(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2)) {
+  distributedMapCtx(dest, src, nJob, sizeJob, worker, MPI_COMM_WORLD, patternCtxDefault());
+}
+
+void distributedReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), MPI_Comm comm, patternCtx *pctx) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  /*
+   * Each rank reduces its block on its team, one partial per rank then crosses
+   * the network and is combined in rank order, skipping the ranks with no elements
+  */
+
+  // An array with no elements at all reduces to zero, as reduce does
+  if (!rankPartials(dest, src, nJob, sizeJob, worker, 0, comm, pctx))
+    memset(dest, 0, sizeJob);
+}
+
+void distributedReduce(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  distributedReduceCtx(dest, src, nJob, sizeJob, worker, MPI_COMM_WORLD, patternCtxDefault());
+}
+
+void distributedScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), MPI_Comm comm, patternCtx *pctx) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  /*
+   * Reduce then scan across ranks - the partials of the blocks are combined with an
+   * exclusive scan and every rank scans its block seeded with what comes before it.
+   * The block is read twice but dest is only written once, scanning first would
+   * need a second pass over dest to apply the carry
+  */
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *carry = arenaAlloc(arena, sizeJob);
+
+  // Ranks with only empty blocks before them scan unseeded, like the first one
+  int seeded = rankPartials(carry, src, nJob, sizeJob, worker, 1, comm, pctx);
+
+  scanSeededCtx(dest, src, nJob, sizeJob, worker, seeded ? carry : NULL, pctx);
+
+  arenaRelease(arena, mark);
+}
+
+void distributedScan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  distributedScanCtx(dest, src, nJob, sizeJob, worker, MPI_COMM_WORLD, patternCtxDefault());
+}
+
+/*
+ *  SORT
+*/
+
+// First element of a sorted run that goes after the key
+static size_t upperBound(const char *a, size_t n, size_t sizeJob, const void *key, sortCompare compare) {
+  size_t lo = 0;
+  size_t hi = n;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (compare(key, &a[mid * sizeJob]) < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return lo;
+}
+
+// Merges the sorted runs [bounds[r], bounds[r + 1]) pairwise, returns whichever of the two buffers ends up with the result
+static char *mergeRuns(char *runs, char *buffer, size_t *bounds, int nRuns, size_t sizeJob, sortCompare compare, patternCtx *pctx) {
+  char *from = runs;
+  char *to = buffer;
+
+  for (; nRuns > 1; nRuns = (nRuns + 1) / 2) {
+    int nPairs = (nRuns + 1) / 2;
+
+    #pragma omp parallel for default(none) shared(from, to, bounds, nRuns, nPairs, sizeJob, compare) \
+    schedule(dynamic, 1) num_threads(pctx->nThreads)
+    for (int pair = 0; pair < nPairs; pair++) {
+      size_t middle = bounds[min(2 * pair + 1, nRuns)];
+      size_t right = bounds[min(2 * pair + 2, nRuns)];
+      size_t i = bounds[2 * pair];
+      size_t j = middle;
+      size_t out = i;
+
+      // Ties are taken from the left run, which comes from the lower rank
+      while (i < middle && j < right) {
+        if (compare(&from[j * sizeJob], &from[i * sizeJob]) < 0)
+          memcpy(&to[out++ * sizeJob], &from[j++ * sizeJob], sizeJob);
+        else
+          memcpy(&to[out++ * sizeJob], &from[i++ * sizeJob], sizeJob);
+      }
+
+      memcpy(&to[out * sizeJob], &from[i * sizeJob], (middle - i) * sizeJob);
+      out += middle - i;
+      memcpy(&to[out * sizeJob], &from[j * sizeJob], (right - j) * sizeJob);
+    }
+
+    for (int pair = 0; pair <= nPairs; pair++)
+      bounds[pair] = bounds[min(2 * pair, nRuns)];
+
+    char *swap = from;
+    from = to;
+    to = swap;
+  }
+
+  return from;
+}
+
+void distributedSortCtx(void *arr, size_t nJob, size_t sizeJob, sortCompare compare, MPI_Comm comm, patternCtx *pctx) {
+  assert (arr != NULL);
+  assert (sizeJob > 0);
+  assert (compare != NULL);
+
+  /*
+   * Sample sort across ranks - every rank sorts its block and draws regular samples,
+   * the gathered samples give one splitter per rank boundary. Each sorted block is
+   * cut at the splitters and the pieces exchanged, every rank merges the runs it got.
+   * A last exchange moves the elements so the ranks keep the size of their block
+  */
+
+  int rank;
+  int nRanks;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  sampleSortCtx(arr, nJob, sizeJob, compare, pctx);
+
+  if (nRanks == 1)
+    return;
+
+  char *a = arr;
+  MPI_Datatype type = elementType(sizeJob);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  int *sendCounts = arenaAlloc(arena, nRanks * sizeof(int));
+  int *sendDispls = arenaAlloc(arena, nRanks * sizeof(int));
+  int *recvCounts = arenaAlloc(arena, nRanks * sizeof(int));
+  int *recvDispls = arenaAlloc(arena, nRanks * sizeof(int));
+
+  // Regular samples, nRanks per rank or the whole block when it is smaller
+  int nSamples = nJob < (size_t) nRanks ? (int) nJob : nRanks;
+  char *samples = arenaAlloc(arena, nSamples * sizeJob);
+
+  for (int i = 0; i < nSamples; i++)
+    memcpy(&samples[i * sizeJob], &a[(i * nJob / nSamples) * sizeJob], sizeJob);
+
+  MPI_Allgather(&nSamples, 1, MPI_INT, recvCounts, 1, MPI_INT, comm);
+
+  int nAllSamples = 0;
+
+  for (int r = 0; r < nRanks; r++) {
+    recvDispls[r] = nAllSamples;
+    nAllSamples += recvCounts[r];
+  }
+
+  char *allSamples = arenaAlloc(arena, max(nAllSamples, 1) * sizeJob);
+
+  MPI_Allgatherv(samples, nSamples, type, allSamples, recvCounts, recvDispls, type, comm);
+
+  // Same samples everywhere, so every rank picks the same splitters
+  qsort(allSamples, nAllSamples, sizeJob, compare);
+
+  // Rank r gets the elements after splitter r - 1 up to splitter r
+  size_t cut = 0;
+
+  for (int r = 0; r < nRanks; r++) {
+    size_t next = nJob;
+
+    if (r < nRanks - 1 && nAllSamples > 0)
+      next = upperBound(a, nJob, sizeJob, &allSamples[((size_t) (r + 1) * nAllSamples / nRanks) * sizeJob], compare);
+
+    next = max(next, cut);
+
+    sendCounts[r] = mpiCount(next - cut);
+    sendDispls[r] = mpiCount(cut);
+    cut = next;
+  }
+
+  MPI_Alltoall(sendCounts, 1, MPI_INT, recvCounts, 1, MPI_INT, comm);
+
+  size_t *bounds = arenaAlloc(arena, (nRanks + 1) * sizeof(size_t));
+  size_t nReceived = 0;
+
+  for (int r = 0; r < nRanks; r++) {
+    bounds[r] = nReceived;
+    recvDispls[r] = mpiCount(nReceived);
+    nReceived += recvCounts[r];
+  }
+
+  bounds[nRanks] = nReceived;
+
+  char *runs = arenaAlloc(arena, max(nReceived, 1) * sizeJob);
+  char *buffer = arenaAlloc(arena, max(nReceived, 1) * sizeJob);
+
+  MPI_Alltoallv(a, sendCounts, sendDispls, type, runs, recvCounts, recvDispls, type, comm);
+
+  char *sorted = mergeRuns(runs, buffer, bounds, nRanks, sizeJob, compare, pctx);
+
+  // Global position of the merged elements and of the block of every rank
+  unsigned long long local[2] = {nReceived, nJob};
+  unsigned long long *sizes = arenaAlloc(arena, 2 * nRanks * sizeof(unsigned long long));
+
+  MPI_Allgather(local, 2, MPI_UNSIGNED_LONG_LONG, sizes, 2, MPI_UNSIGNED_LONG_LONG, comm);
+
+  size_t myHeld = 0;
+  size_t myBlock = 0;
+
+  for (int r = 0; r < rank; r++) {
+    myHeld += sizes[2 * r];
+    myBlock += sizes[2 * r + 1];
+  }
+
+  // Overlap of what every rank holds with what every rank keeps
+  size_t held = 0;
+  size_t block = 0;
+
+  for (int r = 0; r < nRanks; r++) {
+    size_t sendFirst = max(myHeld, block);
+    size_t sendLast = min(myHeld + nReceived, block + sizes[2 * r + 1]);
+    size_t recvFirst = max(held, myBlock);
+    size_t recvLast = min(held + sizes[2 * r], myBlock + nJob);
+
+    sendCounts[r] = sendFirst < sendLast ? mpiCount(sendLast - sendFirst) : 0;
+    sendDispls[r] = sendFirst < sendLast ? mpiCount(sendFirst - myHeld) : 0;
+    recvCounts[r] = recvFirst < recvLast ? mpiCount(recvLast - recvFirst) : 0;
+    recvDispls[r] = recvFirst < recvLast ? mpiCount(recvFirst - myBlock) : 0;
+
+    held += sizes[2 * r];
+    block += sizes[2 * r + 1];
+  }
+
+  MPI_Alltoallv(sorted, sendCounts, sendDispls, type, a, recvCounts, recvDispls, type, comm);
+
+  MPI_Type_free(&type);
+
+  arenaRelease(arena, mark);
+}
+
+void distributedSort(void *arr, size_t nJob, size_t sizeJob, sortCompare compare) {
+  distributedSortCtx(arr, nJob, sizeJob, compare, MPI_COMM_WORLD, patternCtxDefault());
+}
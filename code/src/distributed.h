@@ -0,0 +1,94 @@
+#ifndef __DISTRIBUTED_H
+#define __DISTRIBUTED_H
+
+#include <stddef.h>
+#include <mpi.h>
+#include "context.h"
+#include "sort.h"
+
+/*
+ * Distributed patterns - arrays are split in contiguous blocks, one per rank, in
+ * rank order. Every rank runs the OpenMP pattern on its own block and the ranks
+ * only exchange tile partials, except for the sort which moves the elements.
+ * nJob is always the # elements of the calling rank, blocks may differ in size.
+ * Reduce and scan only need an associative worker, blocks are folded from their first
+ * element and empty blocks are left out of the combine, even with more ranks than elements.
+ * Only built with PATTERNS_MPI, MPI must be initialized before any call.
+ */
+
+// # elements of the block of the calling rank when nJob elements are split evenly, first gets its global position
+size_t distributedBlock(
+    size_t nJob,          // # elements of the whole array
+    MPI_Comm comm,        // Ranks sharing the array
+    size_t *first         // Target position of the first element of the block, may be NULL
+);
+
+// Splits an array held by the root in even blocks, see distributedBlock
+void distributedScatter(
+    void *dest,           // Target block of the calling rank
+    void *src,            // Source array, only read on the root
+    size_t nJob,          // # elements of the whole array
+    size_t sizeJob,       // Size of each element in the array
+    int root,             // Rank holding the array
+    MPI_Comm comm         // Ranks sharing the array
+);
+
+// Joins even blocks into an array held by the root, see distributedBlock
+void distributedGather(
+    void *dest,           // Target array, only written on the root
+    void *src,            // Source block of the calling rank
+    size_t nJob,          // # elements of the whole array
+    size_t sizeJob,       // Size of each element in the array
+    int root,             // Rank getting the array
+    MPI_Comm comm         // Ranks sharing the array
+);
+
+// Every element stays on its rank, nothing is exchanged
+void distributedMap(
+    void *dest,           // Target block
+    void *src,            // Source block
+    size_t nJob,          // # elements in the source block
+    size_t sizeJob,       // Size of each element in the source block
+    void (*worker)(void *v1, const void *v2) // [ v1 = op (v2) ]
+);
+
+// The result is left on every rank
+void distributedReduce(
+    void *dest,           // Target value
+    void *src,            // Source block
+    size_t nJob,          // # elements in the source block
+    size_t sizeJob,       // Size of each element in the source block
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+// Inclusive scan of the whole array, each rank gets its block of the result
+void distributedScan(
+    void *dest,           // Target block
+    void *src,            // Source block
+    size_t nJob,          // # elements in the source block
+    size_t sizeJob,       // Size of each element in the source block
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+// Sorts the whole array, every rank keeps as many elements as it had
+void distributedSort(
+    void *arr,            // Block to be sorted in place
+    size_t nJob,          // # elements in the block
+    size_t sizeJob,       // Size of each element in the block
+    sortCompare compare   // < 0, 0, > 0 if the first element goes before, with or after the second
+);
+
+/*
+ * Communicator and context aware variants - same arguments as above, plus the
+ * ranks sharing the array and the context the local patterns run with
+ */
+
+void distributedMapCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), MPI_Comm comm, patternCtx *pctx);
+
+void distributedReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), MPI_Comm comm, patternCtx *pctx);
+
+void distributedScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), MPI_Comm comm, patternCtx *pctx);
+
+void distributedSortCtx(void *arr, size_t nJob, size_t sizeJob, sortCompare compare, MPI_Comm comm, patternCtx *pctx);
+
+#endif
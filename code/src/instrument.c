@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+#include "instrument.h"
+
+// Threads and phases one report can tell apart, later threads share the last slot
+#define INSTRUMENT_MAX_THREADS 256
+#define INSTRUMENT_MAX_PHASES 32
+#define INSTRUMENT_MAX_DISPATCHES 32
+
+typedef struct instrumentPhase {
+    const char *name;
+    int level;
+    long calls[INSTRUMENT_MAX_THREADS];
+    double seconds[INSTRUMENT_MAX_THREADS];
+    long long cycles[INSTRUMENT_MAX_THREADS];
+    long long misses[INSTRUMENT_MAX_THREADS];
+} instrumentPhase;
+
+typedef struct instrumentDecision {
+    const char *pattern;
+    const char *mode;
+    atomic_long calls;
+} instrumentDecision;
+
+static atomic_int active;
+static const char *callName;
+static double callStart;
+static atomic_int nPhases;
+static instrumentPhase phases[INSTRUMENT_MAX_PHASES];
+static atomic_int nDecisions;
+static instrumentDecision decisions[INSTRUMENT_MAX_DISPATCHES];
+
+// Slot of every OS thread, the OpenMP pool keeps its threads so slots are stable
+static atomic_int nSlots;
+static _Thread_local int slot = -1;
+
+// Counters of every OS thread, opened on first use
+static _Thread_local int countersOpen;
+static _Thread_local int cyclesFd = -1;
+static _Thread_local int missesFd = -1;
+
+static int openCounter(unsigned long long config) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  // Counts the calling thread on any cpu
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long readCounter(int fd) {
+  long long value;
+
+  if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+    return -1;
+
+  return value;
+}
+
+static int threadSlot(void) {
+  if (slot < 0) {
+    slot = atomic_fetch_add(&nSlots, 1);
+
+    if (slot >= INSTRUMENT_MAX_THREADS)
+      slot = INSTRUMENT_MAX_THREADS - 1;
+  }
+
+  return slot;
+}
+
+instrumentSample instrumentTic(void) {
+  instrumentSample sample = {0, -1, -1};
+
+  // Nothing is recorded outside a report, skip the counter reads
+  if (!atomic_load(&active))
+    return sample;
+
+  if (!countersOpen) {
+    cyclesFd = openCounter(PERF_COUNT_HW_CPU_CYCLES);
+    missesFd = openCounter(PERF_COUNT_HW_CACHE_MISSES);
+    countersOpen = 1;
+  }
+
+  sample.cycles = readCounter(cyclesFd);
+  sample.misses = readCounter(missesFd);
+  sample.seconds = omp_get_wtime();
+
+  return sample;
+}
+
+static instrumentPhase *findPhase(const char *name, int level) {
+  int n = atomic_load(&nPhases);
+
+  for (int i = 0; i < n; i++)
+    if (phases[i].name == name && phases[i].level == level)
+      return &phases[i];
+
+  instrumentPhase *phase = NULL;
+
+  // Phases are only added a few times per call, the lock keeps them unique
+  #pragma omp critical(instrumentPhases)
+  {
+    n = atomic_load(&nPhases);
+
+    for (int i = 0; i < n && phase == NULL; i++)
+      if (phases[i].name == name && phases[i].level == level)
+        phase = &phases[i];
+
+    if (phase == NULL && n < INSTRUMENT_MAX_PHASES) {
+      phase = &phases[n];
+      memset(phase, 0, sizeof(instrumentPhase));
+      phase->name = name;
+      phase->level = level;
+      atomic_store(&nPhases, n + 1);
+    }
+  }
+
+  return phase;
+}
+
+void instrumentToc(const instrumentSample *start, const char *phaseName, int level) {
+  if (!atomic_load(&active))
+    return;
+
+  instrumentSample end = instrumentTic();
+  instrumentPhase *phase = findPhase(phaseName, level);
+
+  if (phase == NULL)
+    return;
+
+  int t = threadSlot();
+
+  phase->calls[t]++;
+  phase->seconds[t] += end.seconds - start->seconds;
+  phase->cycles[t] = start->cycles < 0 || phase->cycles[t] < 0 ? -1 : phase->cycles[t] + end.cycles - start->cycles;
+  phase->misses[t] = start->misses < 0 || phase->misses[t] < 0 ? -1 : phase->misses[t] + end.misses - start->misses;
+}
+
+void instrumentDispatch(const char *pattern, const char *mode) {
+  if (!atomic_load(&active))
+    return;
+
+  instrumentDecision *decision = NULL;
+  int n = atomic_load(&nDecisions);
+
+  for (int i = 0; i < n && decision == NULL; i++)
+    if (decisions[i].pattern == pattern && decisions[i].mode == mode)
+      decision = &decisions[i];
+
+  // Same lock as the phases, new decisions are as rare
+  if (decision == NULL) {
+    #pragma omp critical(instrumentPhases)
+    {
+      n = atomic_load(&nDecisions);
+
+      for (int i = 0; i < n && decision == NULL; i++)
+        if (decisions[i].pattern == pattern && decisions[i].mode == mode)
+          decision = &decisions[i];
+
+      if (decision == NULL && n < INSTRUMENT_MAX_DISPATCHES) {
+        decision = &decisions[n];
+        decision->pattern = pattern;
+        decision->mode = mode;
+        atomic_init(&decision->calls, 0);
+        atomic_store(&nDecisions, n + 1);
+      }
+    }
+  }
+
+  if (decision != NULL)
+    atomic_fetch_add(&decision->calls, 1);
+}
+
+int instrumentBegin(const char *name) {
+  int expected = 0;
+
+  if (omp_in_parallel() || !atomic_compare_exchange_strong(&active, &expected, 1))
+    return 0;
+
+  callName = name;
+  atomic_store(&nPhases, 0);
+  atomic_store(&nDecisions, 0);
+  callStart = omp_get_wtime();
+
+  return 1;
+}
+
+static void printCount(long long count) {
+  if (count < 0)
+    fprintf(stderr, " %14s", "n/a");
+  else
+    fprintf(stderr, " %14lld", count);
+}
+
+void instrumentEnd(const int *owner) {
+  if (!*owner)
+    return;
+
+  double total = (omp_get_wtime() - callStart) * 1e6;
+  int n = atomic_load(&nPhases);
+
+  /*
+   * Busy time of every thread in each phase, a max well above the mean is a load
+   * imbalance and a phase run by a single thread is a serial bottleneck
+  */
+  fprintf(stderr, "[instrument] %s: %.1f us\n", callName, total);
+  fprintf(stderr, "  %-32s %7s %7s %10s %10s %10s %9s %14s %14s\n",
+          "phase", "threads", "calls", "min us", "mean us", "max us", "max/mean", "cycles", "llc misses");
+
+  for (int i = 0; i < n; i++) {
+    instrumentPhase *phase = &phases[i];
+    int nThreads = 0;
+    long calls = 0;
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+    long long cycles = 0;
+    long long misses = 0;
+
+    for (int t = 0; t < INSTRUMENT_MAX_THREADS; t++) {
+      if (phase->calls[t] == 0)
+        continue;
+
+      double us = phase->seconds[t] * 1e6;
+
+      min = nThreads == 0 || us < min ? us : min;
+      max = us > max ? us : max;
+      sum += us;
+      calls += phase->calls[t];
+      cycles = cycles < 0 || phase->cycles[t] < 0 ? -1 : cycles + phase->cycles[t];
+      misses = misses < 0 || phase->misses[t] < 0 ? -1 : misses + phase->misses[t];
+      nThreads++;
+    }
+
+    char label[64];
+
+    if (phase->level >= 0)
+      snprintf(label, sizeof(label), "%s [%d]", phase->name, phase->level);
+    else
+      snprintf(label, sizeof(label), "%s", phase->name);
+
+    double mean = sum / nThreads;
+
+    fprintf(stderr, "  %-32s %7d %7ld %10.1f %10.1f %10.1f %9.2f", label, nThreads, calls, min, mean, max,
+            mean > 0 ? max / mean : 1);
+    printCount(cycles);
+    printCount(misses);
+    fprintf(stderr, "\n");
+  }
+
+  // How every pattern of the call was run, nested calls included
+  n = atomic_load(&nDecisions);
+
+  if (n > 0)
+    fprintf(stderr, "  %-32s %7s\n", "dispatch", "calls");
+
+  for (int i = 0; i < n; i++) {
+    char label[64];
+
+    snprintf(label, sizeof(label), "%s: %s", decisions[i].pattern, decisions[i].mode);
+    fprintf(stderr, "  %-32s %7ld\n", label, atomic_load(&decisions[i].calls));
+  }
+
+  atomic_store(&active, 0);
+}
@@ -0,0 +1,61 @@
+#ifndef __INSTRUMENT_H
+#define __INSTRUMENT_H
+
+/*
+ * Hot path instrumentation - per thread timers and hardware counters for the phases
+ * of the patterns, compiled in with the PATTERNS_INSTRUMENT CMake option.
+ * The outermost pattern call opens a report, the phases of every pattern it runs,
+ * nested ones included, are added to it and the report goes to stderr when the call
+ * returns. Calls made from inside a parallel region never open a report of their own.
+ * Without the option every macro below expands to nothing.
+ */
+
+// Time and counters at the start of a phase
+typedef struct instrumentSample {
+    double seconds;
+    long long cycles;             // -1 when the counter is not available
+    long long misses;             // Last level cache misses, -1 when not available
+} instrumentSample;
+
+// Opens the report of a call, 1 if this call owns it
+int instrumentBegin(const char *name);
+
+// Prints and closes the report if the call owns it
+void instrumentEnd(const int *owner);
+
+instrumentSample instrumentTic(void);
+
+// Counts the execution mode a pattern of the report was dispatched to, both names are literals
+void instrumentDispatch(const char *pattern, const char *mode);
+
+// Adds the time since start to a phase of the calling thread, level tells levels of a tree apart, -1 for none
+void instrumentToc(const instrumentSample *start, const char *phase, int level);
+
+#ifdef PATTERNS_INSTRUMENT
+
+// Report of the enclosing function, closed on every return
+#define INSTRUMENT_CALL(name) int instrumentOwner __attribute__((cleanup(instrumentEnd))) = instrumentBegin(name)
+
+#define INSTRUMENT_TIC(sample) instrumentSample sample = instrumentTic()
+
+#define INSTRUMENT_TOC(sample, phase) instrumentToc(&sample, phase, -1)
+
+#define INSTRUMENT_TOC_LEVEL(sample, phase, level) instrumentToc(&sample, phase, level)
+
+#define INSTRUMENT_DISPATCH(pattern, mode) instrumentDispatch(pattern, mode)
+
+#else
+
+#define INSTRUMENT_CALL(name)
+
+#define INSTRUMENT_TIC(sample)
+
+#define INSTRUMENT_TOC(sample, phase)
+
+#define INSTRUMENT_TOC_LEVEL(sample, phase, level)
+
+#define INSTRUMENT_DISPATCH(pattern, mode)
+
+#endif
+
+#endif
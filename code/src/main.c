@@ -10,8 +10,17 @@
 #include "args.h"
 #include "unit.h"
 #include "debug.h"
+#include "placement.h"
+#include "outofcore.h"
+#include "bench.h"
+#include "tune.h"
+#include "regress.h"
 #include "omp.h"
 
+#ifdef PATTERNS_MPI
+#include <mpi.h>
+#endif
+
 // Global Argp Vars
 const char *argp_program_bug_address = "<f.luna@campus.fct.unl.pt> or <gl.batista@campus.fct.unl.pt>";
 const char *argp_program_version = "0.1";
@@ -19,6 +28,28 @@ const char *argp_program_version = "0.1";
 // Example documentation
 static const char *argp_doc = "Parallel Patterns with C and OpenMP - CP 2019.";
 
+// Sets an environment variable, 1 if it changed
+static int updateEnv(const char *name, const char *value) {
+  if (value == NULL || (getenv(name) != NULL && strcmp(getenv(name), value) == 0))
+    return 0;
+
+  setenv(name, value, 1);
+
+  return 1;
+}
+
+// OpenMP reads OMP_PLACES and OMP_PROC_BIND when the program is loaded,
+// so the program restarts itself once with the new environment
+static void applyAffinity(const argp_args *args, char *argv[]) {
+  int restart = updateEnv("OMP_PLACES", args->places);
+  restart |= updateEnv("OMP_PROC_BIND", args->bind);
+
+  if (restart) {
+    execv("/proc/self/exe", argv);
+    perror("Could not apply thread affinity");
+  }
+}
+
 int main(int argc, char *argv[]) {
   // Set up argp and extract configs
   struct argp argp = {argp_options, argp_option_parser, 0,
@@ -27,49 +58,173 @@ int main(int argc, char *argv[]) {
   argp_args args;
   argp_parse(&argp, argc, argv, 0, 0, &args);
 
+  applyAffinity(&args, argv);
+
+#ifdef PATTERNS_MPI
+  // Only the master thread of each rank calls MPI, the OpenMP teams never do
+  int provided;
+
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+  if (provided < MPI_THREAD_FUNNELED) {
+    fprintf(stderr, "MPI does not support MPI_THREAD_FUNNELED, the patterns need it\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+#endif
+
   if (args.debug_mode)
     DEBUG_MODE = 1;
 
   if (args.weighted)
     WEIGHTED_MODE = 1;
 
-  ITERATIONS = args.iterations;
+  OUTPUT_FILE = args.output;
+
+  // The parser already checked the type and width
+  unitSetElement(args.element, args.width);
+
+  long seed = time(NULL);
+
+#ifdef PATTERNS_MPI
+  // Every rank builds the whole source from the seed of the first one, the distributed tests take their block of it
+  MPI_Bcast(&seed, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+#endif
 
-  srand48(time(NULL));
-  srand48(time(NULL));
+  srand48(seed);
 
   // Setup OpenMP
   omp_set_num_threads(args.num_threads);
   omp_set_nested(1);
   omp_set_dynamic(0);
 
-  // Initialize src array for all iterations
-  printf("Initializing SRC array\n");
-  TYPE *src = malloc(TYPE_SIZE * args.iterations);
-
-  for (int i = 0; i < args.iterations; i++) {
-    if (strcmp(TYPE_NAME, "int") == 0) {
-      src[i] = (TYPE) (drand48() * INT_MAX);
-    } else if (strcmp(TYPE_NAME, "char") == 0) {
-      src[i] = (TYPE) (drand48() * CHAR_MAX);;
-    } else
-      src[i] = (int) (drand48() * 10);
+  patternCtxSetDefaultPlacement(args.placement, args.placement_node);
+
+  // The suite makes its own inputs, -i sets the size of the timed runs
+  if (args.regress) {
+    regressConfig config = {
+        args.iterations > 0 ? (size_t) args.iterations : REGRESS_JOBS,
+        args.warmup, args.repetitions, args.num_threads,
+        args.baseline, args.record, args.tolerance / 100.0, stdout
+    };
+
+    int status = regressRun(&config);
+
+    free(args.sizes);
+    free(args.thread_list);
+
+#ifdef PATTERNS_MPI
+    MPI_Finalize();
+#endif
+
+    return status;
   }
 
-  printf("Done!\n\n");
+  mappedFile input = {NULL, 0, -1};
+  size_t nJob = args.iterations;
+  char *src;
+
+  // The benchmark keeps stdout for its results
+  FILE *log = args.bench ? stderr : stdout;
+
+  // The source array holds the largest size of the sweep
+  for (int i = 0; i < args.n_sizes; i++)
+    if (args.sizes[i] > nJob)
+      nJob = args.sizes[i];
+
+  if (args.input != NULL) {
+    // Map the input file, pages are only read when a pattern reaches them
+    fprintf(log, "Mapping SRC file\n");
+
+    if (mappedOpen(&input, args.input) != 0) {
+      perror(args.input);
+      exit(1);
+    }
+
+    // -i limits the # elements taken from the file
+    if (nJob == 0 || input.bytes / ELEMENT_WIDTH < nJob)
+      nJob = input.bytes / ELEMENT_WIDTH;
+
+    for (int i = 0; i < args.n_sizes; i++) {
+      if (args.sizes[i] > nJob) {
+        fprintf(stderr, "%s: only %zu elements in the file\n", args.input, nJob);
+        exit(1);
+      }
+    }
+
+    if (nJob == 0) {
+      fprintf(stderr, "%s: no elements in the file\n", args.input);
+      exit(1);
+    }
+
+    src = input.data;
+  } else {
+    // Initialize src array for all iterations
+    // Pages are placed by the team before the serial fill writes the values
+    fprintf(log, "Initializing SRC array\n");
+    src = placementAlloc(nJob, ELEMENT_WIDTH, patternCtxDefault());
+
+    for (size_t i = 0; i < nJob; i++)
+      unitRandomElement(&src[i * ELEMENT_WIDTH]);
+  }
+
+  ITERATIONS = nJob < INT_MAX ? (int) nJob : INT_MAX;
 
-  printTYPE(src, args.iterations, "SRC");
+  // Tuned at the team size the test runs with, larger teams are never tried
+  if (args.calibrate) {
+    fprintf(log, "Calibrating the patterns\n");
+    unitCalibrate(nJob);
+
+    if (tuneSave(args.tuning) != 0) {
+      perror(args.tuning);
+      exit(1);
+    }
+  } else if (args.tuning != NULL && tuneLoad(args.tuning) != 0) {
+    perror(args.tuning);
+    exit(1);
+  }
 
-  double start_time = testFunction[args.test_id - 1](src, args.iterations, TYPE_SIZE);
+  fprintf(log, "Done!\n\n");
 
-  double timeElapsed = (omp_get_wtime() - start_time) * 1e6;
+  printTYPE(src, nJob, "SRC");
+
+  if (args.bench) {
+    // Without a list the sweep is the single size and thread count of a plain run
+    benchConfig config = {
+        args.warmup, args.repetitions,
+        args.sizes != NULL ? args.sizes : &nJob, args.sizes != NULL ? args.n_sizes : 1,
+        args.thread_list != NULL ? args.thread_list : &args.num_threads,
+        args.thread_list != NULL ? args.n_thread_list : 1,
+        args.format, stdout
+    };
+
+    const char *name = testNames[args.test_id - 1];
+
+    if (strncmp(name, "test: ", 6) == 0)
+      name += 6;
+
+    benchRun(&config, testFunction[args.test_id - 1], name, src, ELEMENT_WIDTH);
+  } else {
+    double start_time = testFunction[args.test_id - 1](src, nJob, ELEMENT_WIDTH);
+
+    double timeElapsed = (omp_get_wtime() - start_time) * 1e6;
+
+    printf("%s:\t%.0lf microseconds\n", testNames[args.test_id - 1], timeElapsed);
+
+    if (DEBUG_MODE)
+      printf("\n\n");
+  }
 
-  printf("%s:\t%.0lf microseconds\n", testNames[args.test_id - 1], timeElapsed);
+  free(args.sizes);
+  free(args.thread_list);
 
-  if (DEBUG_MODE)
-    printf("\n\n");
+  if (args.input != NULL)
+    mappedClose(&input);
+  else
+    free(src);
 
-  free(src);
+#ifdef PATTERNS_MPI
+  MPI_Finalize();
+#endif
 
   return 0;
 }
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <assert.h>
+#include <omp.h>
+#include "offload.h"
+
+// Tiles of the device scan, every tile is scanned by one device thread
+#define OFFLOAD_SCAN_TILES 4096
+
+/*
+ *  DEVICES
+*/
+
+int offloadTarget(const patternCtx *pctx) {
+  if (pctx->offloadDevice >= 0)
+    return pctx->offloadDevice;
+
+  return omp_get_num_devices() > 0 ? omp_get_default_device() : omp_get_initial_device();
+}
+
+int offloadWorthIt(size_t nJob, const patternCtx *pctx) {
+  size_t minJobs = pctx->offloadMinJobs > 0 ? pctx->offloadMinJobs : OFFLOAD_MIN_JOBS;
+
+  // Below the threshold the transfers and the launch cost more than the CPU kernels save.
+  // Target regions falling back to the host are slower than the CPU kernels, they only
+  // run there when the context asks for the host device
+  return nJob >= minJobs && (pctx->offloadDevice >= 0 || omp_get_num_devices() > 0);
+}
+
+int offloadAlloc(offloadBuffer *buffer, size_t bytes, int device) {
+  assert (buffer != NULL);
+
+  buffer->data = NULL;
+  buffer->bytes = bytes;
+  buffer->device = device;
+
+  if (bytes == 0)
+    return 0;
+
+  buffer->data = omp_target_alloc(bytes, device);
+
+  return buffer->data != NULL ? 0 : -1;
+}
+
+void offloadFree(offloadBuffer *buffer) {
+  if (buffer->data != NULL)
+    omp_target_free(buffer->data, buffer->device);
+
+  buffer->data = NULL;
+  buffer->bytes = 0;
+}
+
+int offloadUpload(offloadBuffer *buffer, const void *src, size_t bytes) {
+  assert (bytes <= buffer->bytes);
+
+  if (bytes == 0)
+    return 0;
+
+  return omp_target_memcpy(buffer->data, src, bytes, 0, 0, buffer->device, omp_get_initial_device()) == 0 ? 0 : -1;
+}
+
+int offloadDownload(void *dest, const offloadBuffer *buffer, size_t bytes) {
+  assert (bytes <= buffer->bytes);
+
+  if (bytes == 0)
+    return 0;
+
+  return omp_target_memcpy(dest, buffer->data, bytes, 0, 0, omp_get_initial_device(), buffer->device) == 0 ? 0 : -1;
+}
+
+// Buffers of one call have to live on the same device and hold the elements
+static void checkBuffers(const offloadBuffer *dest, const offloadBuffer *src, size_t bytes) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (dest->device == src->device);
+  assert (bytes <= dest->bytes && bytes <= src->bytes);
+
+  (void) dest;
+  (void) src;
+  (void) bytes;
+}
+
+/*
+ * Device loops - every pointer is a device address, the switch on the operator
+ * happens on the host and the loops are written once for every operator
+*/
+#define OFFLOAD_MAP_LOOP(OPFN)                                                \
+  TYPED_PRAGMA(omp target teams distribute parallel for is_device_ptr(dest, src) device(device)) \
+  for (size_t i = 0; i < nJob; i++)                                           \
+    dest[i] = OPFN(src[i], operand);
+
+#define OFFLOAD_REDUCE_LOOP(OPFN, IDENTITY, REDUCTION)                        \
+  acc = (IDENTITY);                                                           \
+  TYPED_PRAGMA(omp target teams distribute parallel for reduction(REDUCTION : acc) map(tofrom: acc) is_device_ptr(src) device(device)) \
+  for (size_t i = 0; i < nJob; i++)                                           \
+    acc = OPFN(acc, src[i]);
+
+// Tile reductions, exclusive scan of the tile reductions and tile scans seeded with it
+// There are few enough tiles for the middle phase to run on a single device thread
+#define OFFLOAD_SCAN_LOOPS(T, OPFN, IDENTITY)                                 \
+  TYPED_PRAGMA(omp target teams distribute parallel for is_device_ptr(src, carry) device(device)) \
+  for (size_t tile = 0; tile < nTiles; tile++) {                              \
+    size_t first = tile * tileSize + (tile < leftOver ? tile : leftOver);     \
+    size_t last = first + tileSize + (tile < leftOver ? 1 : 0);               \
+    T acc = (IDENTITY);                                                       \
+    for (size_t i = first; i < last; i++)                                     \
+      acc = OPFN(acc, src[i]);                                                \
+    carry[tile] = acc;                                                        \
+  }                                                                           \
+  TYPED_PRAGMA(omp target is_device_ptr(carry) device(device))                \
+  {                                                                           \
+    T prefix = (IDENTITY);                                                    \
+    for (size_t tile = 0; tile < nTiles; tile++) {                            \
+      T next = OPFN(prefix, carry[tile]);                                     \
+      carry[tile] = prefix;                                                   \
+      prefix = next;                                                          \
+    }                                                                         \
+  }                                                                           \
+  TYPED_PRAGMA(omp target teams distribute parallel for is_device_ptr(dest, src, carry) device(device)) \
+  for (size_t tile = 0; tile < nTiles; tile++) {                              \
+    size_t first = tile * tileSize + (tile < leftOver ? tile : leftOver);     \
+    size_t last = first + tileSize + (tile < leftOver ? 1 : 0);               \
+    T acc = carry[tile];                                                      \
+    for (size_t i = first; i < last; i++)                                     \
+      dest[i] = acc = OPFN(acc, src[i]);                                      \
+  }
+
+#define OFFLOAD_STENCIL_LOOP(T, OPFN, IDENTITY)                               \
+  TYPED_PRAGMA(omp target teams distribute parallel for is_device_ptr(dest, src) device(device)) \
+  for (size_t i = 0; i < nJob; i++) {                                         \
+    size_t first = i < (size_t) nShift ? 0 : i - nShift;                      \
+    size_t last = i + nShift < nJob ? i + nShift : nJob - 1;                  \
+    T acc = (IDENTITY);                                                       \
+    for (size_t j = first; j <= last; j++)                                    \
+      acc = OPFN(acc, src[j]);                                                \
+    dest[i] = acc;                                                            \
+  }
+
+/*
+ * Generates the device kernels and the host array and buffer entry points for one type
+*/
+#define DEFINE_OFFLOAD_PATTERNS(SUFFIX, T, MIN_VALUE, MAX_VALUE)              \
+static void mapDevice##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, T operand, int device) { \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      OFFLOAD_MAP_LOOP(TYPED_ADD)                                             \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      OFFLOAD_MAP_LOOP(TYPED_MUL)                                             \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      OFFLOAD_MAP_LOOP(TYPED_MIN)                                             \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      OFFLOAD_MAP_LOOP(TYPED_MAX)                                             \
+      break;                                                                  \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static T reduceDevice##SUFFIX(const T *src, size_t nJob, patternOp op, int device) { \
+  T acc = 0;                                                                  \
+                                                                              \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      OFFLOAD_REDUCE_LOOP(TYPED_ADD, 0, +)                                    \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      OFFLOAD_REDUCE_LOOP(TYPED_MUL, 1, *)                                    \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      OFFLOAD_REDUCE_LOOP(TYPED_MIN, MAX_VALUE, min)                          \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      OFFLOAD_REDUCE_LOOP(TYPED_MAX, MIN_VALUE, max)                          \
+      break;                                                                  \
+  }                                                                           \
+                                                                              \
+  return acc;                                                                 \
+}                                                                             \
+                                                                              \
+static void scanDevice##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, int device) { \
+  if (nJob == 0)                                                              \
+    return;                                                                   \
+                                                                              \
+  size_t nTiles = nJob < OFFLOAD_SCAN_TILES ? nJob : OFFLOAD_SCAN_TILES;      \
+  size_t tileSize = nJob / nTiles;                                            \
+  size_t leftOver = nJob % nTiles;                                            \
+  T *carry = omp_target_alloc(nTiles * sizeof(T), device);                    \
+                                                                              \
+  if (carry == NULL) {                                                        \
+    fprintf(stderr, "Could not allocate the scan carries on device %d\n", device); \
+    exit(1);                                                                  \
+  }                                                                           \
+                                                                              \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      OFFLOAD_SCAN_LOOPS(T, TYPED_ADD, 0)                                     \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      OFFLOAD_SCAN_LOOPS(T, TYPED_MUL, 1)                                     \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      OFFLOAD_SCAN_LOOPS(T, TYPED_MIN, MAX_VALUE)                             \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      OFFLOAD_SCAN_LOOPS(T, TYPED_MAX, MIN_VALUE)                             \
+      break;                                                                  \
+  }                                                                           \
+                                                                              \
+  omp_target_free(carry, device);                                             \
+}                                                                             \
+                                                                              \
+static void stencilDevice##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, int nShift, int device) { \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      OFFLOAD_STENCIL_LOOP(T, TYPED_ADD, 0)                                   \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      OFFLOAD_STENCIL_LOOP(T, TYPED_MUL, 1)                                   \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      OFFLOAD_STENCIL_LOOP(T, TYPED_MIN, MAX_VALUE)                           \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      OFFLOAD_STENCIL_LOOP(T, TYPED_MAX, MIN_VALUE)                           \
+      break;                                                                  \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+void mapOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, T operand, patternCtx *pctx) { \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+                                                                              \
+  if (!offloadWorthIt(nJob, pctx)) {                                          \
+    mapOp##SUFFIX(dest, src, nJob, op, operand);                              \
+    return;                                                                   \
+  }                                                                           \
+                                                                              \
+  int device = offloadTarget(pctx);                                           \
+                                                                              \
+  if (dest == src) {                                                          \
+    TYPED_PRAGMA(omp target data map(tofrom: dest[0:nJob]) device(device))    \
+    TYPED_PRAGMA(omp target data use_device_ptr(dest) device(device))         \
+    mapDevice##SUFFIX(dest, dest, nJob, op, operand, device);                 \
+  } else {                                                                    \
+    TYPED_PRAGMA(omp target data map(to: src[0:nJob]) map(from: dest[0:nJob]) device(device)) \
+    TYPED_PRAGMA(omp target data use_device_ptr(dest, src) device(device))    \
+    mapDevice##SUFFIX(dest, src, nJob, op, operand, device);                  \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+void reduceOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, patternCtx *pctx) { \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+                                                                              \
+  if (!offloadWorthIt(nJob, pctx)) {                                          \
+    reduceOp##SUFFIX(dest, src, nJob, op);                                    \
+    return;                                                                   \
+  }                                                                           \
+                                                                              \
+  int device = offloadTarget(pctx);                                           \
+                                                                              \
+  TYPED_PRAGMA(omp target data map(to: src[0:nJob]) device(device))           \
+  TYPED_PRAGMA(omp target data use_device_ptr(src) device(device))            \
+  *dest = reduceDevice##SUFFIX(src, nJob, op, device);                        \
+}                                                                             \
+                                                                              \
+void scanOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, patternCtx *pctx) { \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+                                                                              \
+  if (!offloadWorthIt(nJob, pctx)) {                                          \
+    scanOp##SUFFIX(dest, src, nJob, op);                                      \
+    return;                                                                   \
+  }                                                                           \
+                                                                              \
+  int device = offloadTarget(pctx);                                           \
+                                                                              \
+  if (dest == src) {                                                          \
+    TYPED_PRAGMA(omp target data map(tofrom: dest[0:nJob]) device(device))    \
+    TYPED_PRAGMA(omp target data use_device_ptr(dest) device(device))         \
+    scanDevice##SUFFIX(dest, dest, nJob, op, device);                         \
+  } else {                                                                    \
+    TYPED_PRAGMA(omp target data map(to: src[0:nJob]) map(from: dest[0:nJob]) device(device)) \
+    TYPED_PRAGMA(omp target data use_device_ptr(dest, src) device(device))    \
+    scanDevice##SUFFIX(dest, src, nJob, op, device);                          \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+void stencilOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, int nShift, patternCtx *pctx) { \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+  assert (nShift >= 0);                                                       \
+                                                                              \
+  if (!offloadWorthIt(nJob, pctx)) {                                          \
+    stencilOp##SUFFIX(dest, src, nJob, op, nShift);                           \
+    return;                                                                   \
+  }                                                                           \
+                                                                              \
+  int device = offloadTarget(pctx);                                           \
+                                                                              \
+  TYPED_PRAGMA(omp target data map(to: src[0:nJob]) map(from: dest[0:nJob]) device(device)) \
+  TYPED_PRAGMA(omp target data use_device_ptr(dest, src) device(device))      \
+  stencilDevice##SUFFIX(dest, src, nJob, op, nShift, device);                 \
+}                                                                             \
+                                                                              \
+void mapOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, T operand) { \
+  mapOffload##SUFFIX##Ctx(dest, src, nJob, op, operand, patternCtxDefault()); \
+}                                                                             \
+                                                                              \
+void reduceOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op) { \
+  reduceOffload##SUFFIX##Ctx(dest, src, nJob, op, patternCtxDefault());       \
+}                                                                             \
+                                                                              \
+void scanOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op) {  \
+  scanOffload##SUFFIX##Ctx(dest, src, nJob, op, patternCtxDefault());         \
+}                                                                             \
+                                                                              \
+void stencilOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, int nShift) { \
+  stencilOffload##SUFFIX##Ctx(dest, src, nJob, op, nShift, patternCtxDefault()); \
+}                                                                             \
+                                                                              \
+void mapBuffer##SUFFIX(offloadBuffer *dest, const offloadBuffer *src, size_t nJob, patternOp op, T operand) { \
+  checkBuffers(dest, src, nJob * sizeof(T));                                  \
+  mapDevice##SUFFIX(dest->data, src->data, nJob, op, operand, dest->device);  \
+}                                                                             \
+                                                                              \
+void reduceBuffer##SUFFIX(T *dest, const offloadBuffer *src, size_t nJob, patternOp op) { \
+  assert (dest != NULL);                                                      \
+  checkBuffers(src, src, nJob * sizeof(T));                                   \
+                                                                              \
+  *dest = reduceDevice##SUFFIX(src->data, nJob, op, src->device);             \
+}                                                                             \
+                                                                              \
+void scanBuffer##SUFFIX(offloadBuffer *dest, const offloadBuffer *src, size_t nJob, patternOp op) { \
+  checkBuffers(dest, src, nJob * sizeof(T));                                  \
+  scanDevice##SUFFIX(dest->data, src->data, nJob, op, dest->device);          \
+}                                                                             \
+                                                                              \
+void stencilBuffer##SUFFIX(offloadBuffer *dest, const offloadBuffer *src, size_t nJob, patternOp op, int nShift) { \
+  assert (nShift >= 0);                                                       \
+  assert (dest->data != src->data || nJob == 0);                              \
+  checkBuffers(dest, src, nJob * sizeof(T));                                  \
+                                                                              \
+  stencilDevice##SUFFIX(dest->data, src->data, nJob, op, nShift, dest->device); \
+}
+
+DEFINE_OFFLOAD_PATTERNS(Int, int, INT_MIN, INT_MAX)
+
+DEFINE_OFFLOAD_PATTERNS(Float, float, -INFINITY, INFINITY)
+
+DEFINE_OFFLOAD_PATTERNS(Double, double, -INFINITY, INFINITY)
+
+DEFINE_OFFLOAD_PATTERNS(Int64, int64_t, INT64_MIN, INT64_MAX)
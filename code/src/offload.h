@@ -0,0 +1,86 @@
+#ifndef __OFFLOAD_H
+#define __OFFLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "context.h"
+#include "typed.h"
+
+/*
+ * Offloaded typed patterns - map, reduce, scan and stencil of typed.h as OpenMP
+ * target regions. The workers of the generic patterns are host functions, so the
+ * device runs the built-in operators. Host arrays are mapped to the device for the
+ * call, arrays below the threshold of the context or hosts without a device take
+ * the CPU kernels of typed.h instead. Device buffers keep the data on the device
+ * between calls, chained patterns then move it once each way.
+ */
+
+// # elements below which host arrays stay on the CPU when the context does not set it
+#define OFFLOAD_MIN_JOBS (1 << 20)
+
+typedef struct offloadBuffer {
+    void *data;           // Device address, only valid inside target regions, NULL if nothing is allocated
+    size_t bytes;         // Size of the buffer
+    int device;           // Device holding the buffer
+} offloadBuffer;
+
+// Device the patterns of the context offload to, the host device when there is none
+int offloadTarget(const patternCtx *pctx);
+
+// 1 if the host array variants send nJob elements to the device
+int offloadWorthIt(size_t nJob, const patternCtx *pctx);
+
+// Allocates a buffer on a device, 0 on success and -1 on failure
+int offloadAlloc(
+    offloadBuffer *buffer, // Target buffer
+    size_t bytes,          // Size of the buffer
+    int device             // Device to allocate on, see offloadTarget
+);
+
+void offloadFree(offloadBuffer *buffer);
+
+// Copies host memory to the start of the buffer, 0 on success and -1 on failure
+int offloadUpload(offloadBuffer *buffer, const void *src, size_t bytes);
+
+// Copies the start of the buffer to host memory, 0 on success and -1 on failure
+int offloadDownload(void *dest, const offloadBuffer *buffer, size_t bytes);
+
+/*
+ * Kernels of every supported type - same arguments and results as the typed kernels,
+ * dest may be src for map and scan. The buffer variants run on the device of their
+ * buffers whatever the size and the context variants take device and threshold from pctx
+ */
+#define DECLARE_OFFLOAD_PATTERNS(SUFFIX, T)                                   \
+void mapOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, T operand); \
+                                                                              \
+void reduceOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op); \
+                                                                              \
+void scanOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op);   \
+                                                                              \
+void stencilOffload##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, int nShift); \
+                                                                              \
+void mapOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, T operand, patternCtx *pctx); \
+                                                                              \
+void reduceOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, patternCtx *pctx); \
+                                                                              \
+void scanOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, patternCtx *pctx); \
+                                                                              \
+void stencilOffload##SUFFIX##Ctx(T *dest, const T *src, size_t nJob, patternOp op, int nShift, patternCtx *pctx); \
+                                                                              \
+void mapBuffer##SUFFIX(offloadBuffer *dest, const offloadBuffer *src, size_t nJob, patternOp op, T operand); \
+                                                                              \
+void reduceBuffer##SUFFIX(T *dest, const offloadBuffer *src, size_t nJob, patternOp op); \
+                                                                              \
+void scanBuffer##SUFFIX(offloadBuffer *dest, const offloadBuffer *src, size_t nJob, patternOp op); \
+                                                                              \
+void stencilBuffer##SUFFIX(offloadBuffer *dest, const offloadBuffer *src, size_t nJob, patternOp op, int nShift);
+
+DECLARE_OFFLOAD_PATTERNS(Int, int)
+
+DECLARE_OFFLOAD_PATTERNS(Float, float)
+
+DECLARE_OFFLOAD_PATTERNS(Double, double)
+
+DECLARE_OFFLOAD_PATTERNS(Int64, int64_t)
+
+#endif
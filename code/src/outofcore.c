@@ -0,0 +1,230 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "outofcore.h"
+#include "patterns.h"
+
+// Window of the out-of-core patterns when the context does not set one
+#define OUTOFCORE_WINDOW_BYTES (64 * 1024 * 1024)
+
+/*
+ *  UTILS
+*/
+
+// Advice for the whole pages covering a range, madvise only takes page aligned ranges
+// The advice is only a hint, failures are ignored
+static void advise(const void *ptr, size_t bytes, int advice) {
+  if (ptr == NULL || bytes == 0)
+    return;
+
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t first = (uintptr_t) ptr / page * page;
+  uintptr_t last = ((uintptr_t) ptr + bytes + page - 1) / page * page;
+
+  (void) madvise((void *) first, last - first, advice);
+}
+
+static size_t windowJobs(const patternCtx *pctx, size_t sizeJob) {
+  size_t windowBytes = pctx->windowBytes > 0 ? pctx->windowBytes : OUTOFCORE_WINDOW_BYTES;
+
+  return windowBytes / sizeJob > 0 ? windowBytes / sizeJob : 1;
+}
+
+// Called before the window starting at first - prefetches the next window of the source and
+// makes the pages of the previous window the first ones to be reclaimed
+static void windowAdvance(char *d, char *s, size_t first, size_t count, size_t nJob, size_t sizeJob) {
+  size_t next = first + count;
+
+  if (next < nJob)
+    advise(&s[next * sizeJob], (count < nJob - next ? count : nJob - next) * sizeJob, MADV_WILLNEED);
+
+#ifdef MADV_COLD
+  if (first >= count) {
+    advise(&s[(first - count) * sizeJob], count * sizeJob, MADV_COLD);
+
+    if (d != NULL)
+      advise(&d[(first - count) * sizeJob], count * sizeJob, MADV_COLD);
+  }
+#else
+  (void) d;
+#endif
+}
+
+/*
+ *  FILES
+*/
+
+int mappedOpen(mappedFile *file, const char *path) {
+  assert (file != NULL);
+  assert (path != NULL);
+
+  struct stat info;
+
+  file->data = NULL;
+  file->fd = open(path, O_RDONLY);
+
+  if (file->fd < 0)
+    return -1;
+
+  if (fstat(file->fd, &info) != 0) {
+    close(file->fd);
+    return -1;
+  }
+
+  file->bytes = info.st_size;
+
+  if (file->bytes == 0)
+    return 0;
+
+  file->data = mmap(NULL, file->bytes, PROT_READ, MAP_SHARED, file->fd, 0);
+
+  if (file->data == MAP_FAILED) {
+    file->data = NULL;
+    close(file->fd);
+    return -1;
+  }
+
+  advise(file->data, file->bytes, MADV_SEQUENTIAL);
+
+  return 0;
+}
+
+int mappedCreate(mappedFile *file, const char *path, size_t bytes) {
+  assert (file != NULL);
+  assert (path != NULL);
+
+  file->data = NULL;
+  file->bytes = bytes;
+  file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (file->fd < 0)
+    return -1;
+
+  if (ftruncate(file->fd, bytes) != 0) {
+    close(file->fd);
+    return -1;
+  }
+
+  if (bytes == 0)
+    return 0;
+
+  file->data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+
+  if (file->data == MAP_FAILED) {
+    file->data = NULL;
+    close(file->fd);
+    return -1;
+  }
+
+  advise(file->data, file->bytes, MADV_SEQUENTIAL);
+
+  return 0;
+}
+
+void mappedClose(mappedFile *file) {
+  if (file->data != NULL)
+    munmap(file->data, file->bytes);
+
+  close(file->fd);
+
+  file->data = NULL;
+  file->fd = -1;
+}
+
+/*
+ *  PATTERNS
+*/
+
+void windowedMapCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), patternCtx *pctx) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  char *d = dest;
+  char *s = src;
+  size_t count = windowJobs(pctx, sizeJob);
+
+  for (size_t first = 0; first < nJob; first += count) {
+    windowAdvance(d, s, first, count, nJob, sizeJob);
+
+    mapCtx(&d[first * sizeJob], &s[first * sizeJob], count < nJob - first ? count : nJob - first, sizeJob, worker, pctx);
+  }
+}
+
+void windowedMap(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2)) {
+  windowedMapCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
+}
+
+void windowedReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  /*
+   * Every window is reduced on its own and folded into the running partial,
+   * windows are combined in source order
+  */
+
+  char *s = src;
+  size_t count = windowJobs(pctx, sizeJob);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *partial = arenaAlloc(arena, sizeJob);
+
+  memset(dest, 0, sizeJob);
+
+  for (size_t first = 0; first < nJob; first += count) {
+    windowAdvance(NULL, s, first, count, nJob, sizeJob);
+
+    reduceCtx(partial, &s[first * sizeJob], count < nJob - first ? count : nJob - first, sizeJob, worker, pctx);
+    worker(dest, dest, partial);
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void windowedReduce(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  windowedReduceCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
+}
+
+void windowedScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+
+  /*
+   * Every window is scanned seeded with the last element of the previous one,
+   * so the running partial never needs a pass of its own
+  */
+
+  char *d = dest;
+  char *s = src;
+  size_t count = windowJobs(pctx, sizeJob);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // Kept apart from dest, the previous window may already be on its way out
+  char *carry = arenaAlloc(arena, sizeJob);
+
+  for (size_t first = 0; first < nJob; first += count) {
+    size_t windowSize = count < nJob - first ? count : nJob - first;
+
+    windowAdvance(d, s, first, count, nJob, sizeJob);
+
+    scanSeededCtx(&d[first * sizeJob], &s[first * sizeJob], windowSize, sizeJob, worker, first > 0 ? carry : NULL, pctx);
+    memcpy(carry, &d[(first + windowSize - 1) * sizeJob], sizeJob);
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void windowedScan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  windowedScanCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
+}
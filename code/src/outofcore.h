@@ -0,0 +1,71 @@
+#ifndef __OUTOFCORE_H
+#define __OUTOFCORE_H
+
+#include <stddef.h>
+#include "context.h"
+
+/*
+ * Out-of-core patterns - map, reduce and scan over arrays larger than memory,
+ * usually files mapped with mappedOpen/mappedCreate. The arrays are walked in
+ * windows, the next window is prefetched while the current one is processed and
+ * the pages of finished windows are handed back to the kernel first.
+ */
+
+typedef struct mappedFile {
+    void *data;           // Contents of the file, NULL if nothing is mapped
+    size_t bytes;         // Size of the file
+    int fd;               // Descriptor the mapping was made from
+} mappedFile;
+
+// Maps an existing file read only, 0 on success and -1 with errno set on failure
+int mappedOpen(
+    mappedFile *file,     // Target mapping
+    const char *path      // File to be mapped
+);
+
+// Creates or truncates a file of the given size and maps it read write, 0 on success and -1 with errno set on failure
+int mappedCreate(
+    mappedFile *file,     // Target mapping
+    const char *path,     // File to be created
+    size_t bytes          // Size of the file
+);
+
+// Unmaps the file, writes made through a mappedCreate mapping stay in the file
+void mappedClose(mappedFile *file);
+
+void windowedMap(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2) // [ v1 = op (v2) ]
+);
+
+void windowedReduce(
+    void *dest,           // Target value
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+void windowedScan(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+/*
+ * Context aware variants - same arguments as above, plus the context
+ * the patterns take their team and window size from
+ */
+
+void windowedMapCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), patternCtx *pctx);
+
+void windowedReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void windowedScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+#endif
@@ -1,14 +1,56 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <assert.h>
 #include <malloc.h>
-#include <math.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <omp.h>
 #include "patterns.h"
+#include "sort.h"
+#include "instrument.h"
+#include "tune.h"
 
-// Define treshold where it makes more sense to serialize code
+// Define treshold where it makes more sense to serialize code, when the context does not set one
 #define QUICKSOORT_TRESHOLD 1000
 
+// Size of the tiles handed to batch workers, small enough to stay in cache
+#define BATCH_TILE_BYTES (16 * 1024)
+
+// Size of the tiles of the single pass scan, a tile is read twice so it has to stay in cache
+#define LOOKBACK_TILE_BYTES (64 * 1024)
+
+// Smallest tile of the parallel prefix, below it the scan stays serial
+#define PREFIX_TILE_TRESHOLD 4096
+
+// Spins before a thread waiting on a look-back flag gives up its core
+#define LOOKBACK_SPINS 128
+
+// Objects this large are sorted through a permutation instead of being swapped
+#define KEY_INDEX_SORT_TRESHOLD 32
+
+// Side of the wavefront tiles, shrunk when the grid has too few tiles for the team
+#define WAVEFRONT_TILE 64
+
+// Ranges a farm worker can keep, splitting in halves never needs more than one per bit of nJob
+#define FARM_DEQUE_CAPACITY 64
+
+// Grains per farm worker when the context does not set a chunk size
+#define FARM_SPLIT_FACTOR 16
+
+// Leaf block of the deterministic reduce when the context does not set one
+#define DETERMINISTIC_REDUCE_BLOCK 1024
+
+// Elements gather prefetches ahead when the context does not set a distance
+#define GATHER_PREFETCH_DISTANCE 16
+
+// Source region of each bucket of the bucketed gather when the context does not set one
+#define GATHER_BUCKET_BYTES (1024 * 1024)
+
+// Filter positions handed out at a time by the gather loop
+#define GATHER_BLOCK 1024
+
 /*
  *  UTILS
 */
@@ -39,6 +81,10 @@ size_t getTileIndex(int tile, int leftOverTiles, size_t tileSize) {
          : leftOverTiles * (tileSize + 1) + (tile - leftOverTiles) * tileSize;
 }
 
+static void workerAddSize(void *a, const void *b, const void *c) {
+  *(size_t *) a = *(const size_t *) b + *(const size_t *) c;
+}
+
 static void workerAddForPack(void *a, const void *b, const void *c) {
   *(int *) a = *(int *) b + *(int *) c;
 }
@@ -73,66 +119,135 @@ void pipelineAsserts(void *dest, void *src, size_t nJob, size_t sizeJob, void (*
     assert (workerList[i] != NULL);
 }
 
-struct treeNode {
-    char *sum;
-    char *fromLeft;
-} treeNode;
+void batchAsserts(void *dest, void *src, size_t sizeJob, batchWorker worker) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (worker != NULL);
+  assert (sizeJob > 0);
+}
+
+size_t batchTileSize(size_t sizeJob) {
+  return max(BATCH_TILE_BYTES / sizeJob, 1);
+}
 
-/*
- * TEMP TEST
-*/
-void printTree(struct treeNode *tree, size_t nJob) {
-  int h = 1;
-  for (size_t i = 0; i < nJob; i++) {
-    int currentHeight = (int) log2(i + 1) + 1;
+// Execution mode of a call, counted in the report of the call
+static patternExec dispatch(const char *name, const patternCtx *pctx, int nThreads, size_t nJob, size_t sizeJob) {
+  patternExec exec = patternCtxDispatch(pctx, nThreads, nJob, sizeJob);
 
-    if (currentHeight != h) {
-      printf("\n");
-      h++;
-    }
+  (void) name;
+  INSTRUMENT_DISPATCH(name, patternExecName(exec));
 
-    printf("(%.0lf, %.0lf) ", ((double *) tree[i].sum)[0], ((double *) tree[i].fromLeft)[0]);
-  }
+  return exec;
+}
+
+// Grain of the task loops, the schedule chunk size if one was set, split as finely as the farm otherwise
+static size_t taskGrain(size_t nJob, const patternCtx *pctx) {
+  if (pctx->chunkSize > 0)
+    return pctx->chunkSize;
 
-  printf("\n\n");
+  return max(nJob / (pctx->nThreads * FARM_SPLIT_FACTOR), 1);
 }
 
+// Every pipeline shape gives the same result, serially the item bound one keeps each element in registers
+static void pipelineSerial(char *d, char *s, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
+  for (size_t i = 0; i < nJob; i++) {
+    workerList[0](&d[i * sizeJob], &s[i * sizeJob]);
+
+    for (size_t j = 1; j < nWorkers; j++)
+      workerList[j](&d[i * sizeJob], &d[i * sizeJob]);
+  }
+}
 
 /*
  *  Parallel Patterns
 */
 
 // Implementation of map
-void mapImpl(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), int nThreads) {
+void mapCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), patternCtx *pctx) {
   basicAsserts(dest, src, worker);
-  assert (nThreads >= 1);
+  assert (pctx->nThreads >= 1);
+
+  INSTRUMENT_CALL("map");
 
   char *d = dest;
   char *s = src;
 
+  patternExec exec = dispatch("map", pctx, pctx->nThreads, nJob, sizeJob);
+
+  if (exec == EXEC_SERIAL) {
+    for (size_t i = 0; i < nJob; i++)
+      worker(&d[i * sizeJob], &s[i * sizeJob]);
+    return;
+  }
+
+  // Idle threads pick up the ranges left behind costly elements
+  if (exec == EXEC_TASKS) {
+    size_t grain = taskGrain(nJob, pctx);
+
+    #pragma omp parallel default(none) shared(worker, nJob, d, s, sizeJob, grain) num_threads(pctx->nThreads)
+    #pragma omp single
+    #pragma omp taskloop grainsize(grain)
+    for (size_t i = 0; i < nJob; i++)
+      worker(&d[i * sizeJob], &s[i * sizeJob]);
+
+    return;
+  }
+
+  INSTRUMENT_TIC(region);
+
   #pragma omp parallel default(none) \
-  shared(worker, nJob, d, s, sizeJob) num_threads(nThreads)
-  #pragma omp for schedule(static)
-  for (size_t i = 0; i < nJob; i++)
-    worker(&d[i * sizeJob], &s[i * sizeJob]);
+  shared(worker, nJob, d, s, sizeJob, pctx) num_threads(pctx->nThreads)
+  {
+    patternCtxApplySchedule(pctx);
+
+    INSTRUMENT_TIC(loop);
+
+    // The region ends right after, its barrier is the one of the loop
+    #pragma omp for schedule(runtime) nowait
+    for (size_t i = 0; i < nJob; i++)
+      worker(&d[i * sizeJob], &s[i * sizeJob]);
+
+    INSTRUMENT_TOC(loop, "map: loop");
+  }
+
+  INSTRUMENT_TOC(region, "map: region");
 }
 
 // Standalone map for tests
 void map(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2)) {
-  mapImpl(dest, src, nJob, sizeJob, worker, omp_get_max_threads());
+  mapCtx(dest, src, nJob, sizeJob, worker, tuneCtx(TUNE_MAP, nJob, sizeJob));
 }
 
 // Implementation of reduce
 void
-reduceImpl(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), int nThreads) {
+reduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
   basicAsserts2(dest, src, worker);
-  assert (nThreads >= 1);
+  assert (pctx->nThreads >= 1);
+
+  // The deterministic blocks start from their first element, tiles start from zero. Folding
+  // the result into zero as phase 2 does keeps both modes at the same value for any operator
+  if (pctx->reduce == REDUCE_DETERMINISTIC) {
+    deterministicReduceCtx(dest, src, nJob, sizeJob, worker, pctx);
+
+    if (nJob == 0)
+      return;
+
+    patternArena *arena = patternCtxArena(pctx);
+    arenaMark mark = arenaGetMark(arena);
+
+    worker(dest, arenaCalloc(arena, 1, sizeJob), dest);
+
+    arenaRelease(arena, mark);
+    return;
+  }
 
   /*
    * Implementation based on Structured Parallel Programming by Michael McCool et al.
    * The two phase implementation of reduce can be found on chapter 5
    */
 
+  INSTRUMENT_CALL("reduce");
+
   // Zero destination variable
   memset(dest, 0, sizeJob);
 
@@ -140,23 +255,41 @@ reduceImpl(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(vo
   if (nJob == 0)
     return;
 
-  char *result = calloc(1, sizeJob);
+  // A single tile, reduced straight into dest
+  if (dispatch("reduce", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    for (size_t i = 0; i < nJob; i++)
+      worker(dest, &((char *) src)[i * sizeJob], dest);
+    return;
+  }
+
+  INSTRUMENT_TIC(alloc);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *result = arenaCalloc(arena, 1, sizeJob);
   char *s = src;
 
   // Set size of tiles in relation to number of threads
   // set how many left over jobs, making a few threads work an extra job
+  int nThreads = pctx->nThreads;
   size_t tileSize = nJob / nThreads;
   int leftOverJobs = (int) (nJob % nThreads);
   int nTiles = min(nJob, nThreads);
 
   // Allocate space to hold the reduction of phase 1
   // Set first position as the first value of the src array
-  char *phase1reduction = calloc(nTiles, sizeJob);
+  char *phase1reduction = arenaCalloc(arena, nTiles, sizeJob);
+
+  INSTRUMENT_TOC(alloc, "reduce: alloc");
+  INSTRUMENT_TIC(region);
 
   #pragma omp parallel default(none) num_threads(nTiles) \
     shared(leftOverJobs, phase1reduction, worker, tileSize, nTiles, result, s, sizeJob)
   #pragma omp for schedule(static)
   for (int tile = 0; tile < nTiles; tile++) {
+    INSTRUMENT_TIC(phase1);
+
     // Calculate if this tile needs to do extra job
     // use tile size to create tile reduction array
     size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
@@ -166,300 +299,1611 @@ reduceImpl(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(vo
 
     for (size_t i = 0; i < tileSizeWithOffset; i++)
       worker(&phase1reduction[tile * sizeJob], &s[(i + tileIndex) * sizeJob], &phase1reduction[tile * sizeJob]);
+
+    INSTRUMENT_TOC(phase1, "reduce: phase 1");
   }
 
+  INSTRUMENT_TOC(region, "reduce: region");
+  INSTRUMENT_TIC(phase2);
+
   // Do phase 2 reduction
   for (int tile = 0; tile < nTiles; tile++)
     worker(result, result, &phase1reduction[tile * sizeJob]);
 
+  INSTRUMENT_TOC(phase2, "reduce: phase 2");
+
   memcpy(dest, result, sizeJob);
 
   // Free everything
-  free(result);
-  free(phase1reduction);
+  arenaRelease(arena, mark);
 }
 
 // Standalone reduce for tests
 void reduce(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
-  reduceImpl(dest, src, nJob, sizeJob, worker, omp_get_max_threads());
+  reduceCtx(dest, src, nJob, sizeJob, worker, tuneCtx(TUNE_REDUCE, nJob, sizeJob));
 }
 
-void scan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
-  basicAsserts2(dest, src, worker);
+void mapReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*mapWorker)(void *v1, const void *v2), void (*reduceWorker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  basicAsserts(dest, src, mapWorker);
+  assert (reduceWorker != NULL);
+  assert (pctx->nThreads >= 1);
 
   /*
-  * Implementation based on Structured Parallel Programming by Michael McCool et al.
-  * The Three-phase tiled implementation of scan can be found on chapter 5.6
-  * This is an INCLUSIVE scan
+   * Same tiles and combine order as reduce, phase 1 maps every element into a
+   * per tile slot right before reducing it, so the mapped array is never stored
   */
 
-  char *d = dest;
-  char *s = src;
-
-  if (nJob == 0)
-    return;
+  INSTRUMENT_CALL("mapReduce");
 
-  memcpy(d, s, sizeJob);
+  memset(dest, 0, sizeJob);
 
-  if (nJob == 1)
+  if (nJob == 0)
     return;
 
-  // Set size of tiles in relation to number of threads
-  // set how many left over jobs, making a few threads work an extra job
-  size_t tileSize = (nJob - 1) / omp_get_max_threads();
-  int leftOverJobs = (int) ((nJob - 1) % omp_get_max_threads());
-  int nTiles = min((nJob - 1), omp_get_max_threads());
-
-  // Allocate space to hold the reductions of phase 1 and 2
-  // Set first position for both as the first value of the src array
-  char *phase1reduction = calloc(nTiles, sizeJob);
-  char *phase2reduction = calloc(nTiles, sizeJob);
-  memcpy(phase1reduction, s, sizeJob);
-  memcpy(phase2reduction, s, sizeJob);
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
 
+  char *s = src;
 
-  // Start phase 1 for each tile with one tile per processor
-  // If there are less jobs than processors, only start the necessary tiles
-  #pragma omp parallel default(none) num_threads(nTiles) \
-    shared(leftOverJobs, worker, tileSize, phase1reduction, nTiles, s, sizeJob)
-  #pragma omp for schedule(static)
-  for (int tile = 0; tile < nTiles - 1; tile++) {
-    // Calculate if this tile needs to do extra job
-    // use tile size to create tile reduction array
-    size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
+  if (dispatch("mapReduce", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    char *mapped = arenaAlloc(arena, sizeJob);
 
-    // Get tile index with + 1 offset
-    size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize) + 1;
+    for (size_t i = 0; i < nJob; i++) {
+      mapWorker(mapped, &s[i * sizeJob]);
+      reduceWorker(dest, mapped, dest);
+    }
 
-    // Reduce tile
-    reduceImpl(&phase1reduction[(tile + 1) * sizeJob], &s[tileIndex * sizeJob], tileSizeWithOffset, sizeJob, worker, 1);
+    arenaRelease(arena, mark);
+    return;
   }
 
-  // Do phase 2 reductions
-  for (int tile = 1; tile < nTiles; tile++)
-    worker(&phase2reduction[tile * sizeJob], &phase2reduction[(tile - 1) * sizeJob], &phase1reduction[tile * sizeJob]);
+  int nThreads = pctx->nThreads;
+  size_t tileSize = nJob / nThreads;
+  int leftOverJobs = (int) (nJob % nThreads);
+  int nTiles = min(nJob, nThreads);
 
-  free(phase1reduction);
+  char *phase1reduction = arenaCalloc(arena, nTiles, sizeJob);
+  char *mapped = arenaAlloc(arena, nTiles * sizeJob);
 
-  // Do final phase
   #pragma omp parallel default(none) num_threads(nTiles) \
-    shared(leftOverJobs, worker, tileSize, phase2reduction, nTiles, d, s, sizeJob)
+    shared(leftOverJobs, phase1reduction, mapped, mapWorker, reduceWorker, tileSize, nTiles, s, sizeJob)
   #pragma omp for schedule(static)
   for (int tile = 0; tile < nTiles; tile++) {
-    // Calculate if this tile needs to do extra job
-    // use tile size to create tile reduction array
+    INSTRUMENT_TIC(phase1);
+
     size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
+    size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize);
 
-    // Get tile index with + 1 offset
-    size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize) + 1;
+    char *tileReduction = &phase1reduction[tile * sizeJob];
+    char *tileMapped = &mapped[tile * sizeJob];
 
-    // Set value of first value of tile from phase 2
-    worker(&d[tileIndex * sizeJob], &phase2reduction[tile * sizeJob], &s[tileIndex * sizeJob]);
+    for (size_t i = 0; i < tileSizeWithOffset; i++) {
+      mapWorker(tileMapped, &s[(i + tileIndex) * sizeJob]);
+      reduceWorker(tileReduction, tileMapped, tileReduction);
+    }
 
-    for (size_t i = 1; i < tileSizeWithOffset; i++)
-      worker(&d[(i + tileIndex) * sizeJob], &d[(i - 1 + tileIndex) * sizeJob], &s[(i + tileIndex) * sizeJob]);
+    INSTRUMENT_TOC(phase1, "mapReduce: phase 1");
   }
 
-  free(phase2reduction);
+  INSTRUMENT_TIC(phase2);
+
+  // Do phase 2 reduction
+  for (int tile = 0; tile < nTiles; tile++)
+    reduceWorker(dest, dest, &phase1reduction[tile * sizeJob]);
+
+  INSTRUMENT_TOC(phase2, "mapReduce: phase 2");
+
+  arenaRelease(arena, mark);
 }
 
-void exclusiveScan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
-  scan((char *) dest + sizeJob, src, nJob - 1, sizeJob, worker);
+void mapReduce(void *dest, void *src, size_t nJob, size_t sizeJob, void (*mapWorker)(void *v1, const void *v2), void (*reduceWorker)(void *v1, const void *v2, const void *v3)) {
+  mapReduceCtx(dest, src, nJob, sizeJob, mapWorker, reduceWorker, patternCtxDefault());
 }
 
+void deterministicReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  basicAsserts2(dest, src, worker);
+  assert (pctx->nThreads >= 1);
 
-int pack(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter) {
-  filteredAsserts(dest, src, nJob, sizeJob, filter);
+  /*
+   * The blocks only depend on nJob and the block size, never on the team, and the
+   * partials are combined by a fixed pairwise tree. Every run evaluates the same
+   * expression, so floating point results are bitwise identical for any # threads.
+   * Levels with fewer pairs than threads are combined by a single thread
+  */
 
-  char *d = dest;
+  INSTRUMENT_CALL("deterministicReduce");
+
+  memset(dest, 0, sizeJob);
+
+  if (nJob == 0)
+    return;
+
+  size_t blockSize = pctx->reduceBlock > 0 ? pctx->reduceBlock : DETERMINISTIC_REDUCE_BLOCK;
+  size_t nBlocks = (nJob + blockSize - 1) / blockSize;
   char *s = src;
 
-  int *bitSumArray = calloc(nJob, sizeof(int));
-  scan(&bitSumArray[1], (void *) filter, nJob - 1, sizeof(bitSumArray[0]), workerAddForPack);
+  // Serial calls keep the blocks and the tree, so the result is the same, only the team goes
+  patternExec exec = dispatch("deterministicReduce", pctx, pctx->nThreads, nJob, sizeJob);
+  int nThreads = exec == EXEC_SERIAL ? 1 : min(nBlocks, pctx->nThreads);
 
-  int packLength = bitSumArray[nJob - 1] + 1;
+  // A single block has no tree to combine
+  if (nBlocks == 1 && exec == EXEC_SERIAL) {
+    memcpy(dest, s, sizeJob);
 
-  #pragma omp parallel default(none) shared(nJob, d, s, filter, bitSumArray, sizeJob)
-  #pragma omp for schedule(static)
-  for (size_t i = 0; i < nJob; i++) {
-    if (filter[i])
-      memcpy(&d[bitSumArray[i] * sizeJob], &s[i * sizeJob], sizeJob);
+    for (size_t i = 1; i < nJob; i++)
+      worker(dest, dest, &s[i * sizeJob]);
+    return;
   }
 
-  free(bitSumArray);
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
 
-  return packLength;
-}
+  char *partial = arenaAlloc(arena, nBlocks * sizeJob);
 
-void gatherImpl(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter, int nThreads) {
-  filteredAsserts(dest, src, nJob, sizeJob, filter);
-  assert (nFilter >= 0);
+  #pragma omp parallel default(none) num_threads(nThreads) \
+  shared(s, nJob, sizeJob, worker, blockSize, nBlocks, nThreads, partial)
+  {
+    INSTRUMENT_TIC(blocks);
 
-  char *d = dest;
-  char *s = src;
+    #pragma omp for schedule(static) nowait
+    for (size_t block = 0; block < nBlocks; block++) {
+      size_t first = block * blockSize;
+      size_t last = min(first + blockSize, nJob);
+      char *acc = &partial[block * sizeJob];
 
-  #pragma omp parallel default(none) \
-  shared(filter, nFilter, d, s, sizeJob, nJob, stderr) num_threads(nThreads)
-  #pragma omp for schedule(static)
-  for (int i = 0; i < nFilter; i++) {
-    // This assertion fails due to a bug - error: ‘__PRETTY_FUNCTION__’ not specified in enclosing ‘parallel’
-    // assert (filter[i] < (int) nJob);
-    // I replaced it with a closely equivalent solution
-    if ((size_t) filter[i] >= nJob) {
-      fprintf(stderr, "Invalid filter index in Gather");
-      exit(1);
+      memcpy(acc, &s[first * sizeJob], sizeJob);
+
+      for (size_t i = first + 1; i < last; i++)
+        worker(acc, acc, &s[i * sizeJob]);
     }
 
-    memcpy(&d[i * sizeJob], &s[filter[i] * sizeJob], sizeJob);
+    INSTRUMENT_TOC(blocks, "deterministicReduce: blocks");
+
+    #pragma omp barrier
+
+    // Block b absorbs block b + stride, the left operand always comes first in the source
+    for (size_t stride = 1; stride < nBlocks; stride *= 2) {
+      size_t nPairs = (nBlocks + stride - 1) / (2 * stride);
+
+      INSTRUMENT_TIC(level);
+
+      if (nPairs >= (size_t) nThreads) {
+        #pragma omp for schedule(static) nowait
+        for (size_t pair = 0; pair < nPairs; pair++)
+          worker(&partial[2 * pair * stride * sizeJob], &partial[2 * pair * stride * sizeJob], &partial[(2 * pair + 1) * stride * sizeJob]);
+      } else {
+        #pragma omp single nowait
+        for (size_t pair = 0; pair < nPairs; pair++)
+          worker(&partial[2 * pair * stride * sizeJob], &partial[2 * pair * stride * sizeJob], &partial[(2 * pair + 1) * stride * sizeJob]);
+      }
+
+      INSTRUMENT_TOC_LEVEL(level, "deterministicReduce: tree", __builtin_ctzl(stride));
+
+      #pragma omp barrier
+    }
   }
+
+  memcpy(dest, partial, sizeJob);
+
+  arenaRelease(arena, mark);
 }
 
-void gather(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter) {
-  gatherImpl(dest, src, nJob, sizeJob, filter, nFilter, omp_get_max_threads());
+void deterministicReduce(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  deterministicReduceCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
 }
 
-void scatter(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter) {
-  filteredAsserts(dest, src, nJob, sizeJob, filter);
+void scanSeededCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), const void *seed, patternCtx *pctx) {
+  basicAsserts2(dest, src, worker);
+  assert (pctx->nThreads >= 1);
 
   /*
-   * Atomic implementation of scatter resorting ot quicksort to avoid collisions
+  * Implementation based on Structured Parallel Programming by Michael McCool et al.
+  * The Three-phase tiled implementation of scan can be found on chapter 5.6
+  * This is an INCLUSIVE scan
   */
 
+  INSTRUMENT_CALL("scan");
+
   char *d = dest;
   char *s = src;
 
-  // Do a mirror of original array due to limitations in method signature
-  // By using quick sort to sort the filter positions and their respective
-  // values, we can guarantee atomicity of memcpy operations
-  int *filter2 = malloc(nJob * sizeof(int));
-  memcpy(filter2, filter, nJob * sizeof(int));
-
-  int nThreads = omp_get_max_threads();
+  if (nJob == 0)
+    return;
 
-  quickSort2(filter2, src, sizeJob, nJob);
+  // Every element goes through the first one, so the seed only has to be applied there
+  if (seed != NULL)
+    worker(d, seed, s);
+  else
+    memcpy(d, s, sizeJob);
 
-  #pragma omp parallel default(none) shared(filter2, nJob, sizeJob, d, s, stderr) num_threads(nThreads)
-  #pragma omp for schedule(static)
-  for (size_t i = 0; i < nJob; i++) {
-    // Alternative to assert
-    if ((size_t) filter2[i] >= nJob) {
-      fprintf(stderr, "Invalid filter index in Scatter");
-      exit(1);
-    }
+  if (nJob == 1)
+    return;
 
-    // If the next position is the same as the current, there will be a race
-    // condition in the memcpy, as it copies data block by block.
-    // This workaround allows us to simulate atomicity in memcpy
-    // with minimal O(NlogN) overhead from the quicksort
-    if (i < nJob - 1 && filter2[i] == filter2[i + 1]) {
-      #pragma omp critical
-      memcpy(&d[filter2[i] * sizeJob], &s[i * sizeJob], sizeJob);
-    } else
-      memcpy(&d[filter2[i] * sizeJob], &s[i * sizeJob], sizeJob);
+  // A single tile, scanned on from the first element
+  if (dispatch("scan", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    for (size_t i = 1; i < nJob; i++)
+      worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
+    return;
   }
 
-  free(filter2);
-}
-
-void priorityScatter(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter) {
-  filteredAsserts(dest, src, nJob, sizeJob, filter);
+  // Set size of tiles in relation to number of threads
+  // set how many left over jobs, making a few threads work an extra job
+  int nThreads = pctx->nThreads;
+  size_t tileSize = (nJob - 1) / nThreads;
+  int leftOverJobs = (int) ((nJob - 1) % nThreads);
+  int nTiles = min((nJob - 1), nThreads);
 
-  char *d = dest;
-  char *s = src;
+  // Allocate space to hold the reductions of phase 1 and 2
+  // Set first position for both as the first value of the src array
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
 
-  #pragma omp parallel default(none) shared(filter, nJob, sizeJob, d, s, stderr)
-  #pragma omp for schedule(static) ordered // Priority is given to the elements with higher index in the filter
-  for (size_t i = 0; i < nJob; i++) {
-    // Alternative to assert
-    if ((size_t) filter[i] >= nJob) {
-      fprintf(stderr, "Invalid filter index in Priority Scatter");
-      exit(1);
-    }
+  char *phase1reduction = arenaCalloc(arena, nTiles, sizeJob);
+  char *phase2reduction = arenaCalloc(arena, nTiles, sizeJob);
+  memcpy(phase1reduction, d, sizeJob);
+  memcpy(phase2reduction, d, sizeJob);
 
-    memcpy(&d[filter[i] * sizeJob], &s[i * sizeJob], sizeJob);
-  }
-}
+  // All three phases share one team, phases are separated by the loop barriers
+  // If there are less jobs than processors, only start the necessary tiles
+  #pragma omp parallel default(none) num_threads(nTiles) \
+    shared(leftOverJobs, worker, tileSize, phase1reduction, phase2reduction, nTiles, d, s, sizeJob)
+  {
+    // Start phase 1 for each tile with one tile per processor
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles - 1; tile++) {
+      INSTRUMENT_TIC(phase1);
 
-void pipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
-  pipelineAsserts(dest, src, nJob, sizeJob, workerList, nWorkers);
+      // Calculate if this tile needs to do extra job
+      // use tile size to create tile reduction array
+      size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
 
-  /*
-  * This pipeline implementation is a succession of maps or "map pipeline"
-  * Its definition can be found in the book
-  */
+      // Get tile index with + 1 offset
+      size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize) + 1;
 
-  char *d = dest;
-  char *s = src;
+      // Reduce tile
+      char *tileReduction = &phase1reduction[(tile + 1) * sizeJob];
 
-  if (nWorkers == 0)
-    return;
+      for (size_t i = 0; i < tileSizeWithOffset; i++)
+        worker(tileReduction, &s[(i + tileIndex) * sizeJob], tileReduction);
 
-  int nThreads = omp_get_max_threads();
+      INSTRUMENT_TOC(phase1, "scan: phase 1");
+    }
 
-  // Do first cycle
-  mapImpl(d, s, nJob, sizeJob, workerList[0], nThreads);
+    // Do phase 2 reductions
+    #pragma omp single
+    {
+      INSTRUMENT_TIC(phase2);
 
-  // Following cycles
-  for (size_t j = 1; j < nWorkers; j++)
-    mapImpl(d, d, nJob, sizeJob, workerList[j], nThreads);
-}
+      for (int tile = 1; tile < nTiles; tile++)
+        worker(&phase2reduction[tile * sizeJob], &phase2reduction[(tile - 1) * sizeJob], &phase1reduction[tile * sizeJob]);
 
-void itemBoundPipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
-  pipelineAsserts(dest, src, nJob, sizeJob, workerList, nWorkers);
+      INSTRUMENT_TOC(phase2, "scan: phase 2");
+    }
 
-  /*
-   * In this version of the algorithm, a worker accompanies
-   * one block through all the transformations for better data locality
-   * https://ipcc.cs.uoregon.edu/lectures/lecture-10-pipeline.pdf
-  */
+    // Do final phase
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      INSTRUMENT_TIC(phase3);
 
-  char *d = dest;
-  char *s = src;
+      // Calculate if this tile needs to do extra job
+      // use tile size to create tile reduction array
+      size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
 
-  if (nWorkers == 0)
-    return;
+      // Get tile index with + 1 offset
+      size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize) + 1;
 
-  int nThreads = omp_get_max_threads();
+      // Set value of first value of tile from phase 2
+      worker(&d[tileIndex * sizeJob], &phase2reduction[tile * sizeJob], &s[tileIndex * sizeJob]);
 
-  #pragma omp parallel default(none) \
-  shared(workerList, nJob, nWorkers, d, s, sizeJob) num_threads(nThreads)
-  #pragma omp for schedule(static)
-  for (size_t i = 0; i < nJob; i++) {
-    // Do first worker
-    workerList[0](&d[i * sizeJob], &s[i * sizeJob]);
+      for (size_t i = 1; i < tileSizeWithOffset; i++)
+        worker(&d[(i + tileIndex) * sizeJob], &d[(i - 1 + tileIndex) * sizeJob], &s[(i + tileIndex) * sizeJob]);
 
-    // Do subsequent workers
-    for (size_t j = 1; j < nWorkers; j++)
-      workerList[j](&d[i * sizeJob], &d[i * sizeJob]);
+      INSTRUMENT_TOC(phase3, "scan: phase 3");
+    }
   }
+
+  arenaRelease(arena, mark);
 }
 
-void serialPipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
-  pipelineAsserts(dest, src, nJob, sizeJob, workerList, nWorkers);
+void scanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  scanSeededCtx(dest, src, nJob, sizeJob, worker, NULL, pctx);
+}
+
+void scan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  scanCtx(dest, src, nJob, sizeJob, worker, tuneCtx(TUNE_SCAN, nJob, sizeJob));
+}
+
+void transformScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*mapWorker)(void *v1, const void *v2), void (*scanWorker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  basicAsserts(dest, src, mapWorker);
+  assert (scanWorker != NULL);
+  assert (pctx->nThreads >= 1);
 
   /*
-   * In this version, the data is processed sequentially.
-   * This algorithm needs an equal number of threads and workers to work
-   * https://ipcc.cs.uoregon.edu/lectures/lecture-10-pipeline.pdf
+   * Three phase scan over the mapped elements. Phase 1 maps into a per tile slot,
+   * phase 3 maps straight into the destination and scans it in place
   */
 
+  INSTRUMENT_CALL("transformScan");
+
   char *d = dest;
   char *s = src;
 
-  // No workers means no jobs
-  if (nWorkers == 0)
+  if (nJob == 0)
     return;
 
-  // The number of workers has to be equal or less than the number of threads
-  size_t nThreads = omp_get_max_threads();
-  // assert(nWorkers <= nThreads);
+  mapWorker(d, s);
 
-  // Calculate number of necessary loop cycles
-  size_t nCycles = nWorkers + nJob - 1;
+  if (nJob == 1)
+    return;
+
+  if (dispatch("transformScan", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    for (size_t i = 1; i < nJob; i++) {
+      mapWorker(&d[i * sizeJob], &s[i * sizeJob]);
+      scanWorker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &d[i * sizeJob]);
+    }
+    return;
+  }
+
+  int nThreads = pctx->nThreads;
+  size_t tileSize = (nJob - 1) / nThreads;
+  int leftOverJobs = (int) ((nJob - 1) % nThreads);
+  int nTiles = min((nJob - 1), nThreads);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *phase1reduction = arenaCalloc(arena, nTiles, sizeJob);
+  char *phase2reduction = arenaCalloc(arena, nTiles, sizeJob);
+  char *mapped = arenaAlloc(arena, nTiles * sizeJob);
+  memcpy(phase1reduction, d, sizeJob);
+  memcpy(phase2reduction, d, sizeJob);
+
+  #pragma omp parallel default(none) num_threads(nTiles) \
+    shared(leftOverJobs, mapWorker, scanWorker, tileSize, phase1reduction, phase2reduction, mapped, nTiles, d, s, sizeJob)
+  {
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles - 1; tile++) {
+      INSTRUMENT_TIC(phase1);
+
+      size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
+      size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize) + 1;
+
+      char *tileReduction = &phase1reduction[(tile + 1) * sizeJob];
+      char *tileMapped = &mapped[tile * sizeJob];
+
+      for (size_t i = 0; i < tileSizeWithOffset; i++) {
+        mapWorker(tileMapped, &s[(i + tileIndex) * sizeJob]);
+        scanWorker(tileReduction, tileMapped, tileReduction);
+      }
+
+      INSTRUMENT_TOC(phase1, "transformScan: phase 1");
+    }
+
+    #pragma omp single
+    {
+      INSTRUMENT_TIC(phase2);
+
+      for (int tile = 1; tile < nTiles; tile++)
+        scanWorker(&phase2reduction[tile * sizeJob], &phase2reduction[(tile - 1) * sizeJob], &phase1reduction[tile * sizeJob]);
+
+      INSTRUMENT_TOC(phase2, "transformScan: phase 2");
+    }
+
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      INSTRUMENT_TIC(phase3);
+
+      size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
+      size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize) + 1;
+
+      mapWorker(&d[tileIndex * sizeJob], &s[tileIndex * sizeJob]);
+      scanWorker(&d[tileIndex * sizeJob], &phase2reduction[tile * sizeJob], &d[tileIndex * sizeJob]);
+
+      for (size_t i = 1; i < tileSizeWithOffset; i++) {
+        mapWorker(&d[(i + tileIndex) * sizeJob], &s[(i + tileIndex) * sizeJob]);
+        scanWorker(&d[(i + tileIndex) * sizeJob], &d[(i - 1 + tileIndex) * sizeJob], &d[(i + tileIndex) * sizeJob]);
+      }
+
+      INSTRUMENT_TOC(phase3, "transformScan: phase 3");
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void transformScan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*mapWorker)(void *v1, const void *v2), void (*scanWorker)(void *v1, const void *v2, const void *v3)) {
+  transformScanCtx(dest, src, nJob, sizeJob, mapWorker, scanWorker, patternCtxDefault());
+}
+
+/*
+ * Decoupled look-back, based on Single-pass Parallel Prefix Scan with Decoupled Look-back
+ * by Duane Merrill and Michael Garland. Tiles are claimed in order and each one publishes
+ * its aggregate as soon as it is known, the next tiles accumulate the published values
+ * backwards until they find a tile that already knows its inclusive prefix.
+*/
+enum lookbackFlag {
+    TILE_EMPTY,
+    TILE_AGGREGATE,
+    TILE_PREFIX
+};
+
+typedef struct lookbackState {
+    atomic_int *flags;      // Status of each tile
+    char *aggregates;       // Reduction of each tile alone
+    char *prefixes;         // Inclusive prefix of each tile
+    atomic_size_t nextTile; // Next tile to be claimed
+    size_t nTiles;
+    size_t sizeJob;
+} lookbackState;
+
+void lookbackInit(lookbackState *state, size_t nTiles, size_t sizeJob, patternArena *arena) {
+  state->flags = arenaAlloc(arena, nTiles * sizeof(atomic_int));
+  state->aggregates = arenaAlloc(arena, nTiles * sizeJob);
+  state->prefixes = arenaAlloc(arena, nTiles * sizeJob);
+  state->nTiles = nTiles;
+  state->sizeJob = sizeJob;
+
+  for (size_t tile = 0; tile < nTiles; tile++)
+    atomic_init(&state->flags[tile], TILE_EMPTY);
+
+  atomic_init(&state->nextTile, 0);
+}
+
+// Claiming tiles in order guarantees every tile we look back on is owned by a running thread
+size_t lookbackClaim(lookbackState *state) {
+  return atomic_fetch_add_explicit(&state->nextTile, 1, memory_order_relaxed);
+}
+
+// Publishes the aggregate of a tile and writes the reduction of all previous tiles to exclusive
+// Returns 0 if the tile has no predecessors and exclusive was left untouched
+int lookbackPublish(lookbackState *state, size_t tile, const void *aggregate, void *exclusive,
+                    void (*worker)(void *v1, const void *v2, const void *v3)) {
+  size_t sizeJob = state->sizeJob;
+
+  memcpy(&state->aggregates[tile * sizeJob], aggregate, sizeJob);
+
+  if (tile == 0) {
+    memcpy(&state->prefixes[0], aggregate, sizeJob);
+    atomic_store_explicit(&state->flags[0], TILE_PREFIX, memory_order_release);
+    return 0;
+  }
+
+  atomic_store_explicit(&state->flags[tile], TILE_AGGREGATE, memory_order_release);
+
+  // Walk back, prepending each predecessor to the accumulated value
+  int found = 0;
+
+  for (size_t prev = tile; prev-- > 0;) {
+    int flag;
+    int spins = 0;
+
+    while ((flag = atomic_load_explicit(&state->flags[prev], memory_order_acquire)) == TILE_EMPTY)
+      if (++spins % LOOKBACK_SPINS == 0)
+        sched_yield();
+
+    const char *value = flag == TILE_PREFIX
+                        ? &state->prefixes[prev * sizeJob]
+                        : &state->aggregates[prev * sizeJob];
+
+    if (found)
+      worker(exclusive, value, exclusive);
+    else
+      memcpy(exclusive, value, sizeJob);
+
+    found = 1;
+
+    if (flag == TILE_PREFIX)
+      break;
+  }
+
+  worker(&state->prefixes[tile * sizeJob], exclusive, aggregate);
+  atomic_store_explicit(&state->flags[tile], TILE_PREFIX, memory_order_release);
+
+  return 1;
+}
+
+// Returns the inclusive prefix of the previous tile if it is already known, NULL otherwise
+const char *lookbackReadyPrefix(lookbackState *state, size_t tile) {
+  if (tile == 0)
+    return NULL;
+
+  if (atomic_load_explicit(&state->flags[tile - 1], memory_order_acquire) != TILE_PREFIX)
+    return NULL;
+
+  return &state->prefixes[(tile - 1) * state->sizeJob];
+}
+
+// Publishes the inclusive prefix of a tile directly, skipping its aggregate
+void lookbackPublishPrefix(lookbackState *state, size_t tile, const void *inclusive) {
+  memcpy(&state->prefixes[tile * state->sizeJob], inclusive, state->sizeJob);
+  atomic_store_explicit(&state->flags[tile], TILE_PREFIX, memory_order_release);
+}
+
+void lookbackScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  basicAsserts2(dest, src, worker);
+  assert (sizeJob > 0);
+  assert (pctx->nThreads >= 1);
+
+  /*
+   * Single pass INCLUSIVE scan - each tile is reduced, published, and scanned
+   * with the prefix found in the look-back while it is still in cache
+  */
+
+  INSTRUMENT_CALL("lookbackScan");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nJob == 0)
+    return;
+
+  // Tiles scanned in order always find the prefix of the previous one ready, which is a plain scan
+  if (dispatch("lookbackScan", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    memcpy(d, s, sizeJob);
+
+    for (size_t i = 1; i < nJob; i++)
+      worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
+    return;
+  }
+
+  size_t tileSize = max(LOOKBACK_TILE_BYTES / sizeJob, 1);
+  size_t nTiles = (nJob + tileSize - 1) / tileSize;
+  int nThreads = min(nTiles, pctx->nThreads);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  lookbackState state;
+  lookbackInit(&state, nTiles, sizeJob, arena);
+
+  // Two values per thread, the tile aggregate and its exclusive prefix
+  char *scratch = arenaAlloc(arena, 2 * nThreads * sizeJob);
+
+  #pragma omp parallel default(none) num_threads(nThreads) \
+  shared(state, scratch, worker, d, s, nJob, sizeJob, tileSize, nTiles)
+  {
+    char *aggregate = &scratch[2 * omp_get_thread_num() * sizeJob];
+    char *exclusive = aggregate + sizeJob;
+
+    for (size_t tile = lookbackClaim(&state); tile < nTiles; tile = lookbackClaim(&state)) {
+      INSTRUMENT_TIC(tileSample);
+
+      size_t first = tile * tileSize;
+      size_t last = min(first + tileSize, nJob);
+
+      // If the previous tile is already done the tile can be scanned right away
+      const char *prefix = lookbackReadyPrefix(&state, tile);
+
+      if (tile == 0 || prefix != NULL) {
+        if (tile == 0)
+          memcpy(&d[first * sizeJob], &s[first * sizeJob], sizeJob);
+        else
+          worker(&d[first * sizeJob], prefix, &s[first * sizeJob]);
+
+        for (size_t i = first + 1; i < last; i++)
+          worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
+
+        lookbackPublishPrefix(&state, tile, &d[(last - 1) * sizeJob]);
+
+        INSTRUMENT_TOC(tileSample, "lookbackScan: ready tile");
+        continue;
+      }
+
+      // Reduce tile
+      memcpy(aggregate, &s[first * sizeJob], sizeJob);
+
+      for (size_t i = first + 1; i < last; i++)
+        worker(aggregate, aggregate, &s[i * sizeJob]);
+
+      INSTRUMENT_TIC(lookback);
+
+      // Scan tile, seeded with the prefix of the previous tiles
+      int seeded = lookbackPublish(&state, tile, aggregate, exclusive, worker);
+
+      INSTRUMENT_TOC(lookback, "lookbackScan: look-back");
+
+      if (seeded)
+        worker(&d[first * sizeJob], exclusive, &s[first * sizeJob]);
+      else
+        memcpy(&d[first * sizeJob], &s[first * sizeJob], sizeJob);
+
+      for (size_t i = first + 1; i < last; i++)
+        worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
+
+      INSTRUMENT_TOC(tileSample, "lookbackScan: reduced tile");
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void lookbackScan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  lookbackScanCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
+}
+
+void exclusiveLookbackScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  if (nJob == 0)
+    return;
+
+  lookbackScanCtx((char *) dest + sizeJob, src, nJob - 1, sizeJob, worker, pctx);
+}
+
+void exclusiveLookbackScan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  exclusiveLookbackScanCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
+}
+
+void exclusiveScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  if (nJob == 0)
+    return;
+
+  scanCtx((char *) dest + sizeJob, src, nJob - 1, sizeJob, worker, pctx);
+}
+
+void exclusiveScan(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  exclusiveScanCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
+}
+
+// Last segment starting at or before position, offsets are ascending
+size_t segmentAt(const size_t *offsets, size_t nSegments, size_t position) {
+  size_t lo = 0;
+  size_t hi = nSegments;
+
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (offsets[mid] <= position)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+void segmentedReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const size_t *offsets, size_t nSegments, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  basicAsserts2(dest, src, worker);
+  assert (offsets != NULL);
+  assert (sizeJob > 0);
+
+  /*
+   * Tiles split the elements, not the segments, so a long segment is shared by several
+   * threads. Phase 1 reduces every piece of a segment inside a tile, the piece holding
+   * the start of the segment goes straight to dest and the piece a tile starts with is
+   * kept as its carry. Phase 2 appends the carries to their segments in tile order
+  */
+
+  INSTRUMENT_CALL("segmentedReduce");
+
+  char *d = dest;
+  char *s = src;
+
+  // Empty segments are left with the zero identity
+  memset(d, 0, nSegments * sizeJob);
+
+  if (nJob == 0 || nSegments == 0)
+    return;
+
+  assert (offsets[0] == 0);
+
+  // A single tile, every segment is reduced straight into its slot
+  if (dispatch("segmentedReduce", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    for (size_t segment = 0; segment < nSegments; segment++) {
+      size_t first = offsets[segment];
+      size_t end = min(segment + 1 < nSegments ? offsets[segment + 1] : nJob, nJob);
+
+      if (end <= first)
+        continue;
+
+      memcpy(&d[segment * sizeJob], &s[first * sizeJob], sizeJob);
+
+      for (size_t i = first + 1; i < end; i++)
+        worker(&d[segment * sizeJob], &d[segment * sizeJob], &s[i * sizeJob]);
+    }
+    return;
+  }
+
+  int nTiles = min(nJob, pctx->nThreads);
+  size_t tileSize = nJob / nTiles;
+  int leftOverJobs = (int) (nJob % nTiles);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *carry = arenaAlloc(arena, nTiles * sizeJob);
+  size_t *carrySegment = arenaAlloc(arena, nTiles * sizeof(size_t));
+
+  #pragma omp parallel default(none) num_threads(nTiles) \
+  shared(d, s, nJob, sizeJob, offsets, nSegments, worker, nTiles, tileSize, leftOverJobs, carry, carrySegment)
+  {
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      INSTRUMENT_TIC(phase1);
+
+      size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+      size_t last = first + tileSize + (tile < leftOverJobs);
+      size_t segment = segmentAt(offsets, nSegments, first);
+
+      // No carry unless the first segment started in an earlier tile
+      carrySegment[tile] = offsets[segment] < first ? segment : nSegments;
+
+      for (size_t i = first; i < last; segment++) {
+        size_t end = min(segment + 1 < nSegments ? offsets[segment + 1] : nJob, last);
+
+        if (end <= i)
+          continue;
+
+        char *piece = carrySegment[tile] == segment ? &carry[tile * sizeJob] : &d[segment * sizeJob];
+
+        memcpy(piece, &s[i * sizeJob], sizeJob);
+
+        for (i++; i < end; i++)
+          worker(piece, piece, &s[i * sizeJob]);
+      }
+
+      INSTRUMENT_TOC(phase1, "segmentedReduce: phase 1");
+    }
+
+    #pragma omp single
+    {
+      INSTRUMENT_TIC(phase2);
+
+      for (int tile = 1; tile < nTiles; tile++)
+        if (carrySegment[tile] != nSegments)
+          worker(&d[carrySegment[tile] * sizeJob], &d[carrySegment[tile] * sizeJob], &carry[tile * sizeJob]);
+
+      INSTRUMENT_TOC(phase2, "segmentedReduce: phase 2");
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void segmentedReduce(void *dest, void *src, size_t nJob, size_t sizeJob, const size_t *offsets, size_t nSegments, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  segmentedReduceCtx(dest, src, nJob, sizeJob, offsets, nSegments, worker, patternCtxDefault());
+}
+
+void segmentedScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *flags, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
+  basicAsserts2(dest, src, worker);
+  assert (flags != NULL);
+  assert (sizeJob > 0);
+
+  /*
+   * Three phase tiled scan that restarts at every head flag. Phase 1 reduces
+   * the part of each tile after its last head, phase 2 turns those into the value
+   * carried into every tile and phase 3 scans the tiles seeded with the carry.
+   * This is an INCLUSIVE scan, the first element always starts a segment
+  */
+
+  INSTRUMENT_CALL("segmentedScan");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nJob == 0)
+    return;
+
+  if (dispatch("segmentedScan", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    memcpy(d, s, sizeJob);
+
+    for (size_t i = 1; i < nJob; i++) {
+      if (flags[i])
+        memcpy(&d[i * sizeJob], &s[i * sizeJob], sizeJob);
+      else
+        worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
+    }
+    return;
+  }
+
+  int nTiles = min(nJob, pctx->nThreads);
+  size_t tileSize = nJob / nTiles;
+  int leftOverJobs = (int) (nJob % nTiles);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *tail = arenaAlloc(arena, nTiles * sizeJob);
+  char *carry = arenaAlloc(arena, nTiles * sizeJob);
+  int *hasHead = arenaAlloc(arena, nTiles * sizeof(int));
+
+  #pragma omp parallel default(none) num_threads(nTiles) \
+  shared(d, s, nJob, sizeJob, flags, worker, nTiles, tileSize, leftOverJobs, tail, carry, hasHead)
+  {
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles - 1; tile++) {
+      INSTRUMENT_TIC(phase1);
+
+      size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+      size_t last = first + tileSize + (tile < leftOverJobs);
+      size_t start = last - 1;
+
+      // Only the part after the last head reaches the next tile
+      while (start > first && !flags[start])
+        start--;
+
+      hasHead[tile] = tile == 0 || flags[start] != 0;
+
+      memcpy(&tail[tile * sizeJob], &s[start * sizeJob], sizeJob);
+
+      for (size_t i = start + 1; i < last; i++)
+        worker(&tail[tile * sizeJob], &tail[tile * sizeJob], &s[i * sizeJob]);
+
+      INSTRUMENT_TOC(phase1, "segmentedScan: phase 1");
+    }
+
+    // Tile 0 has no carry, every other tile gets the open segment of the previous ones
+    #pragma omp single
+    {
+      INSTRUMENT_TIC(phase2);
+
+      for (int tile = 1; tile < nTiles; tile++) {
+        if (tile == 1 || hasHead[tile - 1])
+          memcpy(&carry[tile * sizeJob], &tail[(tile - 1) * sizeJob], sizeJob);
+        else
+          worker(&carry[tile * sizeJob], &carry[(tile - 1) * sizeJob], &tail[(tile - 1) * sizeJob]);
+      }
+
+      INSTRUMENT_TOC(phase2, "segmentedScan: phase 2");
+    }
+
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      INSTRUMENT_TIC(phase3);
+
+      size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+      size_t last = first + tileSize + (tile < leftOverJobs);
+
+      if (tile == 0 || flags[first])
+        memcpy(&d[first * sizeJob], &s[first * sizeJob], sizeJob);
+      else
+        worker(&d[first * sizeJob], &carry[tile * sizeJob], &s[first * sizeJob]);
+
+      for (size_t i = first + 1; i < last; i++) {
+        if (flags[i])
+          memcpy(&d[i * sizeJob], &s[i * sizeJob], sizeJob);
+        else
+          worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
+      }
+
+      INSTRUMENT_TOC(phase3, "segmentedScan: phase 3");
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void segmentedScan(void *dest, void *src, size_t nJob, size_t sizeJob, const int *flags, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  segmentedScanCtx(dest, src, nJob, sizeJob, flags, worker, patternCtxDefault());
+}
+
+int packCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx) {
+  filteredAsserts(dest, src, nJob, sizeJob, filter);
+
+  INSTRUMENT_CALL("pack");
+
+  char *d = dest;
+  char *s = src;
+
+  // Offsets are counted on the way, no scan and no scratch
+  if (dispatch("pack", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    int packLength = 0;
+
+    for (size_t i = 0; i < nJob; i++)
+      if (filter[i])
+        memcpy(&d[packLength++ * sizeJob], &s[i * sizeJob], sizeJob);
+
+    return packLength;
+  }
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // The scan reports its own phases nested under this call
+  INSTRUMENT_TIC(offsets);
+
+  int *bitSumArray = arenaCalloc(arena, nJob, sizeof(int));
+  scanCtx(&bitSumArray[1], (void *) filter, nJob - 1, sizeof(bitSumArray[0]), workerAddForPack, pctx);
+
+  int packLength = bitSumArray[nJob - 1] + (filter[nJob - 1] != 0);
+
+  INSTRUMENT_TOC(offsets, "pack: offsets");
+
+  #pragma omp parallel default(none) shared(nJob, d, s, filter, bitSumArray, sizeJob, pctx) \
+  num_threads(pctx->nThreads)
+  {
+    patternCtxApplySchedule(pctx);
+
+    INSTRUMENT_TIC(copy);
+
+    #pragma omp for schedule(runtime) nowait
+    for (size_t i = 0; i < nJob; i++) {
+      if (filter[i])
+        memcpy(&d[bitSumArray[i] * sizeJob], &s[i * sizeJob], sizeJob);
+    }
+
+    INSTRUMENT_TOC(copy, "pack: copy");
+  }
+
+  arenaRelease(arena, mark);
+
+  return packLength;
+}
+
+int pack(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter) {
+  return packCtx(dest, src, nJob, sizeJob, filter, patternCtxDefault());
+}
+
+// Compacts a tile in place, returns the # elements kept
+size_t packTileInPlace(char *s, size_t first, size_t last, size_t sizeJob, int (*predicate)(const void *v1)) {
+  size_t kept = first;
+
+  for (size_t i = first; i < last; i++) {
+    if (!predicate(&s[i * sizeJob]))
+      continue;
+
+    if (kept != i)
+      memcpy(&s[kept * sizeJob], &s[i * sizeJob], sizeJob);
+
+    kept++;
+  }
+
+  return kept - first;
+}
+
+int packIfInPlace(char *s, size_t nJob, size_t sizeJob, int (*predicate)(const void *v1), patternCtx *pctx) {
+  /*
+   * Every thread compacts its own tile to the front of the tile, then
+   * the blocks slide down in order, each one next to the previous one
+  */
+
+  int nThreads = min(nJob, pctx->nThreads);
+  size_t tileSize = nJob / nThreads;
+  size_t leftOverJobs = nJob % nThreads;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  size_t *counts = arenaAlloc(arena, nThreads * sizeof(size_t));
+
+  #pragma omp parallel for default(none) shared(s, sizeJob, predicate, counts, nThreads, tileSize, leftOverJobs) \
+  schedule(static) num_threads(nThreads)
+  for (int tile = 0; tile < nThreads; tile++) {
+    size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+    size_t last = first + tileSize + ((size_t) tile < leftOverJobs);
+
+    counts[tile] = packTileInPlace(s, first, last, sizeJob, predicate);
+  }
+
+  // Blocks can overlap the source of the previous ones, so they move in order
+  size_t packLength = counts[0];
+
+  for (int tile = 1; tile < nThreads; tile++) {
+    size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+
+    memmove(&s[packLength * sizeJob], &s[first * sizeJob], counts[tile] * sizeJob);
+    packLength += counts[tile];
+  }
+
+  arenaRelease(arena, mark);
+
+  return (int) packLength;
+}
+
+int packIfCtx(void *dest, void *src, size_t nJob, size_t sizeJob, int (*predicate)(const void *v1), patternCtx *pctx) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (predicate != NULL);
+  assert (sizeJob > 0);
+  assert (nJob <= (size_t) INT_MAX);
+
+  /*
+   * Single pass pack - the predicate runs once per element, on a cache sized tile.
+   * The kept elements are counted, the count is published with the look-back used
+   * by the scan and the tile is written as soon as its offset is known
+  */
+
+  INSTRUMENT_CALL("packIf");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nJob == 0)
+    return 0;
+
+  if (dispatch("packIf", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    if (dest == src)
+      return (int) packTileInPlace(s, 0, nJob, sizeJob, predicate);
+
+    size_t packLength = 0;
+
+    for (size_t i = 0; i < nJob; i++)
+      if (predicate(&s[i * sizeJob]))
+        memcpy(&d[packLength++ * sizeJob], &s[i * sizeJob], sizeJob);
+
+    return (int) packLength;
+  }
+
+  if (dest == src)
+    return packIfInPlace(s, nJob, sizeJob, predicate, pctx);
+
+  size_t tileSize = max(LOOKBACK_TILE_BYTES / sizeJob, 1);
+  size_t nTiles = (nJob + tileSize - 1) / tileSize;
+  int nThreads = min(nTiles, pctx->nThreads);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  lookbackState state;
+  lookbackInit(&state, nTiles, sizeof(size_t), arena);
+
+  // Predicate results of the tile each thread is working on
+  unsigned char *keepScratch = arenaAlloc(arena, nThreads * tileSize);
+
+  #pragma omp parallel default(none) num_threads(nThreads) \
+  shared(state, keepScratch, predicate, d, s, nJob, sizeJob, tileSize, nTiles)
+  {
+    unsigned char *keep = &keepScratch[omp_get_thread_num() * tileSize];
+
+    for (size_t tile = lookbackClaim(&state); tile < nTiles; tile = lookbackClaim(&state)) {
+      size_t first = tile * tileSize;
+      size_t last = min(first + tileSize, nJob);
+      size_t count = 0;
+      size_t offset = 0;
+
+      for (size_t i = first; i < last; i++) {
+        keep[i - first] = predicate(&s[i * sizeJob]) != 0;
+        count += keep[i - first];
+      }
+
+      // If the previous tile is already done its prefix is the offset, no look-back needed
+      const size_t *prefix = (const size_t *) lookbackReadyPrefix(&state, tile);
+
+      if (prefix != NULL) {
+        offset = *prefix;
+
+        size_t inclusive = offset + count;
+        lookbackPublishPrefix(&state, tile, &inclusive);
+      } else
+        lookbackPublish(&state, tile, &count, &offset, workerAddSize); // Leaves the offset at 0 for the first tile
+
+      for (size_t i = first; i < last; i++)
+        if (keep[i - first])
+          memcpy(&d[offset++ * sizeJob], &s[i * sizeJob], sizeJob);
+    }
+  }
+
+  // The inclusive prefix of the last tile is the # elements kept
+  size_t packLength = ((size_t *) state.prefixes)[nTiles - 1];
+
+  arenaRelease(arena, mark);
+
+  return (int) packLength;
+}
+
+int packIf(void *dest, void *src, size_t nJob, size_t sizeJob, int (*predicate)(const void *v1)) {
+  return packIfCtx(dest, src, nJob, sizeJob, predicate, patternCtxDefault());
+}
+
+// Word copies for the common element sizes, may_alias keeps them valid for any element type
+typedef uint32_t __attribute__((may_alias, aligned(1))) gatherWord32;
+typedef uint64_t __attribute__((may_alias, aligned(1))) gatherWord64;
+
+// Visits entries [first, last) of indices, landing on the positions of order or on j itself when it is NULL
+#define GATHER_RANGE(COPY)                                                     \
+  for (size_t j = first; j < last; j++) {                                      \
+    size_t i = order != NULL ? (size_t) order[j] : j;                          \
+    size_t index = (size_t) indices[j];                                        \
+                                                                               \
+    if (distance > 0 && j + distance < last) {                                 \
+      size_t ahead = (size_t) indices[j + distance];                           \
+                                                                               \
+      if (ahead < nJob)                                                        \
+        __builtin_prefetch(&s[ahead * sizeJob]);                               \
+    }                                                                          \
+                                                                               \
+    if (index >= nJob) {                                                       \
+      invalid = 1;                                                             \
+      continue;                                                                \
+    }                                                                          \
+                                                                               \
+    COPY;                                                                      \
+  }
+
+// dest[order[j]] = src[indices[j]] over a range of entries, returns 1 if it skipped an index out of range
+static int gatherRange(char *d, const char *s, size_t nJob, size_t sizeJob, const int *indices, const int *order,
+                       size_t first, size_t last, size_t distance) {
+  int invalid = 0;
+
+  // One loop per size, so the copy is a single load and store instead of a memcpy call
+  switch (sizeJob) {
+    case 4:
+      GATHER_RANGE(*(gatherWord32 *) &d[i * 4] = *(const gatherWord32 *) &s[index * 4])
+      break;
+    case 8:
+      GATHER_RANGE(*(gatherWord64 *) &d[i * 8] = *(const gatherWord64 *) &s[index * 8])
+      break;
+    default:
+      GATHER_RANGE(memcpy(&d[i * sizeJob], &s[index * sizeJob], sizeJob))
+  }
+
+  return invalid;
+}
+
+// Counting sort of the filter by the bucket of the source each index reads from, stable within a bucket
+// The sorted indices go to indices and their filter positions to order, so the gather reads both in sequence
+// Indices out of range go to the first bucket, the gather skips them
+static void gatherBuckets(int *order, int *indices, const int *filter, int nFilter, size_t nJob, size_t sizeJob,
+                          size_t bucketBytes, patternCtx *pctx) {
+  // Buckets are a power of two bytes, the bucket of an element is a shift
+  int shift = 0;
+
+  while (((size_t) 2 << shift) <= bucketBytes)
+    shift++;
+
+  size_t nBuckets = ((nJob * sizeJob - 1) >> shift) + 1;
+  int nTiles = min((size_t) nFilter, pctx->nThreads);
+  size_t tileSize = nFilter / nTiles;
+  int leftOverJobs = nFilter % nTiles;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // One histogram per tile, kept apart so the tiles never write the same lines
+  size_t *counts = arenaCalloc(arena, nBuckets * nTiles, sizeof(size_t));
+
+  #pragma omp parallel default(none) num_threads(nTiles) \
+  shared(order, indices, filter, nJob, sizeJob, shift, nBuckets, nTiles, tileSize, leftOverJobs, counts)
+  {
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+      size_t last = first + tileSize + (tile < leftOverJobs);
+      size_t *histogram = &counts[tile * nBuckets];
+
+      for (size_t i = first; i < last; i++) {
+        size_t index = (size_t) filter[i];
+
+        histogram[index < nJob ? index * sizeJob >> shift : 0]++;
+      }
+    }
+
+    // Bucket major offsets, tile order inside each bucket keeps the sort stable
+    #pragma omp single
+    {
+      size_t offset = 0;
+
+      for (size_t bucket = 0; bucket < nBuckets; bucket++) {
+        for (int tile = 0; tile < nTiles; tile++) {
+          size_t count = counts[tile * nBuckets + bucket];
+
+          counts[tile * nBuckets + bucket] = offset;
+          offset += count;
+        }
+      }
+    }
+
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+      size_t last = first + tileSize + (tile < leftOverJobs);
+      size_t *offsets = &counts[tile * nBuckets];
+
+      for (size_t i = first; i < last; i++) {
+        size_t index = (size_t) filter[i];
+
+        size_t slot = offsets[index < nJob ? index * sizeJob >> shift : 0]++;
+
+        order[slot] = (int) i;
+        indices[slot] = filter[i];
+      }
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void gatherCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter, patternCtx *pctx) {
+  filteredAsserts(dest, src, nJob, sizeJob, filter);
+  assert (nFilter >= 0);
+
+  /*
+   * With random indices into a large source every load misses, so the loads are
+   * prefetched a few elements ahead. The bucketed mode goes further and first sorts
+   * the filter positions by source region, the reads then stay within one region
+   * at a time while every element still lands on its own position of dest.
+   * Indices out of range are only counted inside the loop and reported after it
+  */
+
+  INSTRUMENT_CALL("gather");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nFilter == 0)
+    return;
+
+  size_t distance = pctx->gatherPrefetch < 0 ? 0
+                    : pctx->gatherPrefetch == 0 ? GATHER_PREFETCH_DISTANCE : (size_t) pctx->gatherPrefetch;
+  size_t bucketBytes = pctx->gatherBucketBytes != 0 ? pctx->gatherBucketBytes : GATHER_BUCKET_BYTES;
+
+  // Few enough loads that sorting them by region would cost more than it saves
+  if (dispatch("gather", pctx, pctx->nThreads, nFilter, sizeJob) == EXEC_SERIAL) {
+    if (gatherRange(d, s, nJob, sizeJob, filter, NULL, 0, nFilter, distance)) {
+      fprintf(stderr, "Invalid filter index in Gather");
+      exit(1);
+    }
+    return;
+  }
+
+  size_t nBlocks = ((size_t) nFilter + GATHER_BLOCK - 1) / GATHER_BLOCK;
+  int invalid = 0;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // A source that fits in one bucket is already local
+  const int *indices = filter;
+  int *order = NULL;
+
+  if (pctx->gather == GATHER_BUCKETED && nJob * sizeJob > bucketBytes) {
+    INSTRUMENT_TIC(bucket);
+
+    int *sorted = arenaAlloc(arena, nFilter * sizeof(int));
+    order = arenaAlloc(arena, nFilter * sizeof(int));
+
+    gatherBuckets(order, sorted, filter, nFilter, nJob, sizeJob, bucketBytes, pctx);
+    indices = sorted;
+
+    INSTRUMENT_TOC(bucket, "gather: bucket");
+  }
+
+  #pragma omp parallel default(none) \
+  shared(indices, nFilter, order, d, s, sizeJob, nJob, distance, nBlocks, pctx) \
+  reduction(|:invalid) num_threads(pctx->nThreads)
+  {
+    patternCtxApplySchedule(pctx);
+
+    INSTRUMENT_TIC(loop);
+
+    #pragma omp for schedule(runtime) nowait
+    for (size_t block = 0; block < nBlocks; block++) {
+      size_t first = block * GATHER_BLOCK;
+      size_t last = min(first + GATHER_BLOCK, (size_t) nFilter);
+
+      invalid |= gatherRange(d, s, nJob, sizeJob, indices, order, first, last, distance);
+    }
+
+    INSTRUMENT_TOC(loop, "gather: loop");
+  }
+
+  arenaRelease(arena, mark);
+
+  if (invalid) {
+    fprintf(stderr, "Invalid filter index in Gather");
+    exit(1);
+  }
+}
+
+void gather(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter) {
+  gatherCtx(dest, src, nJob, sizeJob, filter, nFilter, patternCtxDefault());
+}
+
+// Marks every destination slot with the highest source index landing on it, 0 if none does
+// Must be called by the whole team, ends with a barrier
+void scatterClaim(atomic_size_t *owner, const int *filter, size_t nJob) {
+  #pragma omp for schedule(static)
+  for (size_t i = 0; i < nJob; i++)
+    atomic_init(&owner[i], 0);
+
+  #pragma omp for schedule(static)
+  for (size_t i = 0; i < nJob; i++) {
+    // Alternative to assert
+    if ((size_t) filter[i] >= nJob) {
+      fprintf(stderr, "Invalid filter index in Scatter");
+      exit(1);
+    }
+
+    // Atomic max, the claim is stored shifted by one so 0 means unclaimed
+    atomic_size_t *slot = &owner[filter[i]];
+    size_t claim = atomic_load_explicit(slot, memory_order_relaxed);
+
+    while (claim < i + 1
+           && !atomic_compare_exchange_weak_explicit(slot, &claim, i + 1, memory_order_relaxed, memory_order_relaxed));
+  }
+}
+
+void scatterClaimCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx) {
+  /*
+   * Collisions are resolved before any data moves, every slot gets exactly
+   * one memcpy from its winner and the source is never reordered
+  */
+
+  char *d = dest;
+  char *s = src;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  atomic_size_t *owner = arenaAlloc(arena, nJob * sizeof(atomic_size_t));
+
+  #pragma omp parallel default(none) shared(owner, filter, nJob, sizeJob, d, s) num_threads(pctx->nThreads)
+  {
+    scatterClaim(owner, filter, nJob);
+
+    // Walk the destination so the writes stay sequential
+    #pragma omp for schedule(static)
+    for (size_t j = 0; j < nJob; j++) {
+      size_t claim = atomic_load_explicit(&owner[j], memory_order_relaxed);
+
+      if (claim != 0)
+        memcpy(&d[j * sizeJob], &s[(claim - 1) * sizeJob], sizeJob);
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void scatterSortedCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx) {
+  /*
+   * Sorting the filter positions groups the collisions together, only the
+   * last element of each group is written. The sort works on a permutation,
+   * so the source is neither copied nor reordered
+  */
+
+  char *d = dest;
+  char *s = src;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  int *perm = arenaAlloc(arena, nJob * sizeof(int));
+
+  sortPermutationCtx(perm, filter, nJob, pctx);
+
+  #pragma omp parallel default(none) shared(perm, filter, nJob, sizeJob, d, s, stderr) num_threads(pctx->nThreads)
+  #pragma omp for schedule(static)
+  for (size_t i = 0; i < nJob; i++) {
+    size_t slot = (size_t) filter[perm[i]];
+
+    // Alternative to assert
+    if (slot >= nJob) {
+      fprintf(stderr, "Invalid filter index in Scatter");
+      exit(1);
+    }
+
+    // Equal positions keep their source order, the last one of the group wins
+    if (i == nJob - 1 || (size_t) filter[perm[i + 1]] != slot)
+      memcpy(&d[slot * sizeJob], &s[perm[i] * sizeJob], sizeJob);
+  }
+
+  arenaRelease(arena, mark);
+}
+
+// In source order the later elements overwrite the earlier ones, so the highest source index wins
+void scatterSerial(char *d, const char *s, size_t nJob, size_t sizeJob, const int *filter) {
+  for (size_t i = 0; i < nJob; i++) {
+    // Alternative to assert
+    if ((size_t) filter[i] >= nJob) {
+      fprintf(stderr, "Invalid filter index in Scatter");
+      exit(1);
+    }
+
+    memcpy(&d[filter[i] * sizeJob], &s[i * sizeJob], sizeJob);
+  }
+}
+
+void scatterCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx) {
+  filteredAsserts(dest, src, nJob, sizeJob, filter);
+
+  INSTRUMENT_CALL("scatter");
+
+  if (dispatch("scatter", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL)
+    scatterSerial(dest, src, nJob, sizeJob, filter);
+  else if (pctx->scatter == SCATTER_SORTED)
+    scatterSortedCtx(dest, src, nJob, sizeJob, filter, pctx);
+  else
+    scatterClaimCtx(dest, src, nJob, sizeJob, filter, pctx);
+}
+
+void scatter(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter) {
+  scatterCtx(dest, src, nJob, sizeJob, filter, patternCtxDefault());
+}
+
+void priorityScatterCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx) {
+  filteredAsserts(dest, src, nJob, sizeJob, filter);
+
+  INSTRUMENT_CALL("priorityScatter");
+
+  // Priority is given to the elements with higher index in the filter, which is what the claims keep
+  if (dispatch("priorityScatter", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL)
+    scatterSerial(dest, src, nJob, sizeJob, filter);
+  else
+    scatterClaimCtx(dest, src, nJob, sizeJob, filter, pctx);
+}
+
+void priorityScatter(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter) {
+  priorityScatterCtx(dest, src, nJob, sizeJob, filter, patternCtxDefault());
+}
+
+void pipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx) {
+  pipelineAsserts(dest, src, nJob, sizeJob, workerList, nWorkers);
+
+  /*
+  * This pipeline implementation is a succession of maps or "map pipeline"
+  * Its definition can be found in the book
+  */
+
+  INSTRUMENT_CALL("pipeline");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nWorkers == 0)
+    return;
+
+  // Each stage is a map of its own, every element weighs all of them
+  if (dispatch("pipeline", pctx, pctx->nThreads, nJob, sizeJob * nWorkers) == EXEC_SERIAL) {
+    pipelineSerial(d, s, nJob, sizeJob, workerList, nWorkers);
+    return;
+  }
+
+  // Do first cycle
+  mapCtx(d, s, nJob, sizeJob, workerList[0], pctx);
+
+  // Following cycles
+  for (size_t j = 1; j < nWorkers; j++)
+    mapCtx(d, d, nJob, sizeJob, workerList[j], pctx);
+}
+
+void pipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
+  pipelineCtx(dest, src, nJob, sizeJob, workerList, nWorkers, patternCtxDefault());
+}
+
+void itemBoundPipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx) {
+  pipelineAsserts(dest, src, nJob, sizeJob, workerList, nWorkers);
+
+  /*
+   * In this version of the algorithm, a worker accompanies
+   * one block through all the transformations for better data locality
+   * https://ipcc.cs.uoregon.edu/lectures/lecture-10-pipeline.pdf
+  */
+
+  INSTRUMENT_CALL("itemBoundPipeline");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nWorkers == 0)
+    return;
+
+  patternExec exec = dispatch("itemBoundPipeline", pctx, pctx->nThreads, nJob, sizeJob * nWorkers);
+
+  if (exec == EXEC_SERIAL) {
+    pipelineSerial(d, s, nJob, sizeJob, workerList, nWorkers);
+    return;
+  }
+
+  if (exec == EXEC_TASKS) {
+    size_t grain = taskGrain(nJob, pctx);
 
-  for (size_t i = 0; i < nCycles; i++) {
     #pragma omp parallel default(none) \
-    shared(workerList, nJob, nWorkers, d, s, i, sizeJob) num_threads(nThreads)
+    shared(workerList, nJob, nWorkers, d, s, sizeJob, grain) num_threads(pctx->nThreads)
+    #pragma omp single
+    #pragma omp taskloop grainsize(grain)
+    for (size_t i = 0; i < nJob; i++) {
+      workerList[0](&d[i * sizeJob], &s[i * sizeJob]);
+
+      for (size_t j = 1; j < nWorkers; j++)
+        workerList[j](&d[i * sizeJob], &d[i * sizeJob]);
+    }
+
+    return;
+  }
+
+  #pragma omp parallel default(none) \
+  shared(workerList, nJob, nWorkers, d, s, sizeJob, pctx) num_threads(pctx->nThreads)
+  {
+    patternCtxApplySchedule(pctx);
+
+    #pragma omp for schedule(runtime)
+    for (size_t i = 0; i < nJob; i++) {
+      // Do first worker
+      workerList[0](&d[i * sizeJob], &s[i * sizeJob]);
+
+      // Do subsequent workers
+      for (size_t j = 1; j < nWorkers; j++)
+        workerList[j](&d[i * sizeJob], &d[i * sizeJob]);
+    }
+  }
+}
+
+void itemBoundPipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
+  itemBoundPipelineCtx(dest, src, nJob, sizeJob, workerList, nWorkers, patternCtxDefault());
+}
+
+void fusedPipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx) {
+  pipelineAsserts(dest, src, nJob, sizeJob, workerList, nWorkers);
+
+  /*
+   * Map pipeline fused by blocks - every stage runs over a cache sized block
+   * before the next block is loaded, so dest is streamed through memory only once
+  */
+
+  INSTRUMENT_CALL("fusedPipeline");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nWorkers == 0)
+    return;
+
+  if (dispatch("fusedPipeline", pctx, pctx->nThreads, nJob, sizeJob * nWorkers) == EXEC_SERIAL) {
+    pipelineSerial(d, s, nJob, sizeJob, workerList, nWorkers);
+    return;
+  }
+
+  size_t blockSize = patternCtxBlockSize(pctx, sizeJob);
+  size_t nBlocks = (nJob + blockSize - 1) / blockSize;
+
+  #pragma omp parallel default(none) \
+  shared(workerList, nJob, nWorkers, d, s, sizeJob, blockSize, nBlocks, pctx) num_threads(pctx->nThreads)
+  {
+    patternCtxApplySchedule(pctx);
+
+    #pragma omp for schedule(runtime)
+    for (size_t block = 0; block < nBlocks; block++) {
+      size_t first = block * blockSize;
+      size_t last = min(first + blockSize, nJob);
+
+      // Do first stage
+      for (size_t i = first; i < last; i++)
+        workerList[0](&d[i * sizeJob], &s[i * sizeJob]);
+
+      // Do subsequent stages on the cached block
+      for (size_t j = 1; j < nWorkers; j++)
+        for (size_t i = first; i < last; i++)
+          workerList[j](&d[i * sizeJob], &d[i * sizeJob]);
+    }
+  }
+}
+
+void fusedPipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
+  fusedPipelineCtx(dest, src, nJob, sizeJob, workerList, nWorkers, patternCtxDefault());
+}
+
+void serialPipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx) {
+  pipelineAsserts(dest, src, nJob, sizeJob, workerList, nWorkers);
+
+  /*
+   * In this version, the data is processed sequentially.
+   * This algorithm needs an equal number of threads and workers to work
+   * https://ipcc.cs.uoregon.edu/lectures/lecture-10-pipeline.pdf
+  */
+
+  char *d = dest;
+  char *s = src;
+
+  INSTRUMENT_CALL("serialPipeline");
+
+  // No workers means no jobs
+  if (nWorkers == 0)
+    return;
+
+  // One barrier per cycle costs far more than the stages of a small call
+  if (dispatch("serialPipeline", pctx, pctx->nThreads, nJob, sizeJob * nWorkers) == EXEC_SERIAL) {
+    pipelineSerial(d, s, nJob, sizeJob, workerList, nWorkers);
+    return;
+  }
+
+  // The number of workers has to be equal or less than the number of threads
+  // assert(nWorkers <= nThreads);
+
+  // Calculate number of necessary loop cycles
+  size_t nCycles = nWorkers + nJob - 1;
+
+  // The whole team lives through every cycle, cycles are separated by the loop barrier
+  #pragma omp parallel default(none) \
+  shared(workerList, nJob, nWorkers, nCycles, d, s, sizeJob) num_threads(pctx->nThreads)
+  for (size_t i = 0; i < nCycles; i++) {
     #pragma omp for schedule(static)
     for (size_t j = 0; j < min(i + 1, nWorkers); j++) {
       size_t currJob = i - j;
@@ -473,251 +1917,631 @@ void serialPipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*w
   }
 }
 
-void farm(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), size_t nWorkers) {
+void serialPipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers) {
+  serialPipelineCtx(dest, src, nJob, sizeJob, workerList, nWorkers, patternCtxDefault());
+}
+
+/*
+ * Work-stealing farm. Every worker owns a deque of index ranges seeded with an even
+ * slice of the jobs, the owner splits the newest range in halves until it reaches the
+ * grain size and idle workers steal the oldest, and therefore largest, range of a victim.
+*/
+typedef struct farmRange {
+    size_t first;
+    size_t last;
+} farmRange;
+
+typedef struct farmDeque {
+    omp_lock_t lock;
+    size_t top;             // Oldest range, thieves steal from here
+    size_t bottom;          // Newest range, the owner pushes and pops here
+    farmRange ranges[FARM_DEQUE_CAPACITY];
+} farmDeque;
+
+// Part of the jobs a farm body handles in one call
+typedef void (*farmBody)(size_t first, size_t count, void *arg);
+
+// Returns 0 if the deque is full
+int farmPush(farmDeque *deque, size_t first, size_t last) {
+  int pushed = 0;
+
+  omp_set_lock(&deque->lock);
+
+  if (deque->bottom - deque->top < FARM_DEQUE_CAPACITY) {
+    deque->ranges[deque->bottom % FARM_DEQUE_CAPACITY] = (farmRange) {first, last};
+    deque->bottom++;
+    pushed = 1;
+  }
+
+  omp_unset_lock(&deque->lock);
+
+  return pushed;
+}
+
+int farmPop(farmDeque *deque, farmRange *range) {
+  int popped = 0;
+
+  omp_set_lock(&deque->lock);
+
+  if (deque->bottom > deque->top) {
+    deque->bottom--;
+    *range = deque->ranges[deque->bottom % FARM_DEQUE_CAPACITY];
+    popped = 1;
+  }
+
+  omp_unset_lock(&deque->lock);
+
+  return popped;
+}
+
+int farmSteal(farmDeque *deque, farmRange *range) {
+  int stolen = 0;
+
+  omp_set_lock(&deque->lock);
+
+  if (deque->bottom > deque->top) {
+    *range = deque->ranges[deque->top % FARM_DEQUE_CAPACITY];
+    deque->top++;
+    stolen = 1;
+  }
+
+  omp_unset_lock(&deque->lock);
+
+  return stolen;
+}
+
+void farmRun(size_t nJob, size_t grain, size_t nWorkers, farmBody body, void *arg, patternCtx *pctx) {
+  assert (grain >= 1);
+
+  if (nJob == 0)
+    return;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // Deques are set up before the region so thieves never see an uninitialized lock
+  farmDeque *deques = arenaAlloc(arena, nWorkers * sizeof(farmDeque));
+  atomic_size_t remaining;
+
+  for (size_t w = 0; w < nWorkers; w++) {
+    omp_init_lock(&deques[w].lock);
+    deques[w].top = 0;
+    deques[w].bottom = 0;
+  }
+
+  atomic_init(&remaining, nJob);
+
+  #pragma omp parallel default(none) shared(nJob, grain, body, arg, deques, remaining) num_threads(nWorkers)
+  {
+    int self = omp_get_thread_num();
+    int nThreads = omp_get_num_threads();
+
+    // The team may be smaller than asked for, seed only the deques of running threads
+    size_t tileSize = nJob / nThreads;
+    size_t leftOverJobs = nJob % nThreads;
+    size_t first = getTileIndex(self, leftOverJobs, tileSize);
+    size_t last = first + tileSize + ((size_t) self < leftOverJobs);
+
+    if (first < last)
+      farmPush(&deques[self], first, last);
+
+    farmRange range;
+    int spins = 0;
+
+    while (atomic_load_explicit(&remaining, memory_order_acquire) > 0) {
+      int found = farmPop(&deques[self], &range);
+
+      // Look for work in the other deques, starting with the next thread
+      for (int v = 1; !found && v < nThreads; v++)
+        found = farmSteal(&deques[(self + v) % nThreads], &range);
+
+      if (!found) {
+        if (++spins % LOOKBACK_SPINS == 0)
+          sched_yield();
+        continue;
+      }
+
+      // Keep the lower half and expose the upper half to thieves
+      while (range.last - range.first > grain) {
+        size_t middle = range.first + (range.last - range.first) / 2;
+
+        if (!farmPush(&deques[self], middle, range.last))
+          break;
+
+        range.last = middle;
+      }
+
+      INSTRUMENT_TIC(rangeSample);
+
+      body(range.first, range.last - range.first, arg);
+
+      INSTRUMENT_TOC(rangeSample, "farm: range");
+
+      atomic_fetch_sub_explicit(&remaining, range.last - range.first, memory_order_release);
+      spins = 0;
+    }
+  }
+
+  for (size_t w = 0; w < nWorkers; w++)
+    omp_destroy_lock(&deques[w].lock);
+
+  arenaRelease(arena, mark);
+}
+
+// Grain of the farm, the schedule chunk size if one was set
+size_t farmGrain(size_t nJob, size_t nWorkers, const patternCtx *pctx) {
+  if (pctx->chunkSize > 0)
+    return pctx->chunkSize;
+
+  return max(nJob / (nWorkers * FARM_SPLIT_FACTOR), 1);
+}
+
+typedef struct farmArgs {
+    char *d;
+    char *s;
+    size_t sizeJob;
+    void (*worker)(void *v1, const void *v2);
+} farmArgs;
+
+void farmElements(size_t first, size_t count, void *arg) {
+  farmArgs *args = arg;
+
+  for (size_t i = first; i < first + count; i++)
+    args->worker(&args->d[i * args->sizeJob], &args->s[i * args->sizeJob]);
+}
+
+void farmCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx) {
   basicAsserts(dest, src, worker);
   assert (nWorkers >= 1);
   assert (sizeJob > 0);
 
-  char *d = dest;
-  char *s = src;
+  INSTRUMENT_CALL("farm");
+
+  farmArgs args = {dest, src, sizeJob, worker};
+
+  if (dispatch("farm", pctx, nWorkers, nJob, sizeJob) == EXEC_SERIAL) {
+    farmElements(0, nJob, &args);
+    return;
+  }
+
+  farmRun(nJob, farmGrain(nJob, nWorkers, pctx), nWorkers, farmElements, &args, pctx);
+}
+
+void farm(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), size_t nWorkers) {
+  farmCtx(dest, src, nJob, sizeJob, worker, nWorkers, patternCtxDefault());
+}
+
+void stencilCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), int nShift, patternCtx *pctx) {
+  basicAsserts(dest, src, worker);
+  assert(nShift >= 0);
+  /*
+  * Based on McCool book - Structured Parallel Programming - Chapter 7.1.
+  */
+
+  INSTRUMENT_CALL("stencil");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nJob == 0)
+    return;
+
+  // Every element reads its whole neighbourhood
+  if (dispatch("stencil", pctx, pctx->nThreads, nJob, sizeJob * (2 * (size_t) nShift + 1)) == EXEC_SERIAL) {
+    patternArena *arena = patternCtxArena(pctx);
+    arenaMark mark = arenaGetMark(arena);
+    char *result = arenaAlloc(arena, sizeJob);
+
+    for (size_t i = 0; i < nJob; i++) {
+      memset(result, 0, sizeJob);
+
+      for (size_t j = max(i - nShift, 0); j <= min(i + nShift, nJob - 1); j++)
+        worker(result, &s[j * sizeJob]);
+
+      memcpy(&d[i * sizeJob], result, sizeJob);
+    }
+
+    arenaRelease(arena, mark);
+    return;
+  }
 
-  size_t nThreads = omp_get_max_threads();
+  // Make sure the thread arenas exist before the region
+  patternCtxArena(pctx);
 
-  #pragma omp parallel default(none) shared(d, s, nJob, sizeJob, worker) num_threads(nThreads)
+  #pragma omp parallel default(none) \
+  shared(worker, nJob, d, s, nShift, sizeJob, pctx) num_threads(pctx->nThreads)
   {
-    #pragma omp single
+    patternCtxApplySchedule(pctx);
+
+    // Accumulator reused for every element of this thread
+    patternArena *arena = patternCtxThreadArena(pctx, omp_get_thread_num());
+    arenaMark mark = arenaGetMark(arena);
+    char *result = arenaAlloc(arena, sizeJob);
+
+    INSTRUMENT_TIC(loop);
+
+    #pragma omp for schedule(runtime) nowait
     for (size_t i = 0; i < nJob; i++) {
-      #pragma omp task default(none) shared(d, s, i, sizeJob, worker)
-      worker(&d[i * sizeJob], &s[i * sizeJob]);
+      memset(result, 0, sizeJob);
+
+      for (size_t j = max(i - nShift, 0); j <= min(i + nShift, nJob - 1); j++)
+        worker(result, &s[j * sizeJob]);
+
+      memcpy(&d[i * sizeJob], result, sizeJob);
     }
-  }
 
+    INSTRUMENT_TOC(loop, "stencil: loop");
+
+    arenaRelease(arena, mark);
+  }
 }
 
 void stencil(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), int nShift) {
-  basicAsserts(dest, src, worker);
-  assert(nShift >= 0);
-  /*
-  * Based on McCool book - Structured Parallel Programming - Chapter 7.1.
-  */
+  stencilCtx(dest, src, nJob, sizeJob, worker, nShift, patternCtxDefault());
+}
 
-  char *d = dest;
-  char *s = src;
+// Brent-Kung inclusive scan in place on a contiguous buffer, must be called by the whole team
+// Levels are separated by barriers, strides are kept as integers
+void prefixTree(char *buf, size_t n, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  size_t stride;
+  int level;
 
-  int nThreads = omp_get_max_threads();
+  // Up pass - every 2 * stride block keeps its sum in its last element
+  for (stride = 1, level = 0; stride < n; stride *= 2, level++) {
+    INSTRUMENT_TIC(up);
 
-  #pragma omp parallel default(none) \
-  shared(worker, nJob, d, s, nShift, sizeJob) num_threads(nThreads)
-  #pragma omp for schedule(static)
-  for (size_t i = 0; i < nJob; i++) {
-    char *result = calloc(1, sizeJob);
+    #pragma omp for schedule(static) nowait
+    for (size_t i = 2 * stride - 1; i < n; i += 2 * stride)
+      worker(&buf[i * sizeJob], &buf[(i - stride) * sizeJob], &buf[i * sizeJob]);
+
+    INSTRUMENT_TOC_LEVEL(up, "prefixTree: up-sweep", level);
+
+    #pragma omp barrier
+  }
+
+  // Down pass - push the block sums into the middle of the next block
+  for (stride /= 2, level--; stride >= 1; stride /= 2, level--) {
+    INSTRUMENT_TIC(down);
+
+    #pragma omp for schedule(static) nowait
+    for (size_t i = 3 * stride - 1; i < n; i += 2 * stride)
+      worker(&buf[i * sizeJob], &buf[(i - stride) * sizeJob], &buf[i * sizeJob]);
 
-    for (size_t j = max(i - nShift, 0); j <= min(i + nShift, nJob); j++)
-      worker(&result, &s[j * sizeJob]);
+    INSTRUMENT_TOC_LEVEL(down, "prefixTree: down-sweep", level);
 
-    memcpy(&d[i * sizeJob], &result, sizeJob);
+    #pragma omp barrier
   }
 }
 
-void parallelPrefix(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+void parallelPrefixCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
   basicAsserts2(dest, src, worker);
+  assert (pctx->nThreads >= 1);
 
   /*
   * Up/Down pass implementation based on the slides and
   * https://www.cs.princeton.edu/courses/archive/fall13/cos326/lec/23-parallel-scan.pdf
   * This is an inclusive scan
+  *
+  * The tree works in place on contiguous buffers, a tiled hybrid keeps it small:
+  * each tile is scanned serially in dest, the tree only runs across the tile sums
+  * and the resulting prefixes are then applied to every tile but the first
   */
 
+  INSTRUMENT_CALL("parallelPrefix");
+
   if (nJob == 0)
     return;
 
-  if (nJob == 1) {
-    memcpy(dest, src, sizeJob);
+  char *s = src;
+  char *d = dest;
+
+  // A single tile, which needs neither the tree nor the tile sums
+  if (dispatch("parallelPrefix", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    memcpy(d, s, sizeJob);
+
+    for (size_t i = 1; i < nJob; i++)
+      worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
     return;
   }
 
-  // Create tree structure ----------------------
-  // Calculate how many elems tree has in order to have nJob elements at base
-  size_t nTreeElems = nJob <= 1
-                      ? nJob
-                      : nJob % 2 == 0
-                        ? nJob * 2 - 1
-                        : (nJob - 1) * 2;
+  // Tiles smaller than the treshold are not worth a thread
+  int nTiles = min(max(nJob / PREFIX_TILE_TRESHOLD, 1), pctx->nThreads);
+  size_t tileSize = nJob / nTiles;
+  int leftOverJobs = (int) (nJob % nTiles);
 
-  // Calculate how many levels tree will have and verify if it is odd or not (one less element)
-  int treeHeight = (int) log2(nTreeElems) + 1;
-  struct treeNode *tree = calloc(nTreeElems, sizeof(treeNode));
-  int nThreads = omp_get_max_threads();
+  // Sum of each tile, which the tree turns into the inclusive prefix of each tile
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
 
-  // Initialize all the elements of the tree struct
-  for (size_t n = 0; n < nTreeElems; n++) {
-    tree[n].sum = calloc(1, sizeJob);
-    tree[n].fromLeft = calloc(1, sizeJob);
-  }
+  char *tileSums = arenaAlloc(arena, nTiles * sizeJob);
 
-  char *s = src;
-  char *d = dest;
+  #pragma omp parallel default(none) num_threads(nTiles) \
+  shared(worker, s, d, sizeJob, tileSums, nTiles, tileSize, leftOverJobs)
+  {
+    // Serial scan within each tile
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      INSTRUMENT_TIC(tileScan);
+
+      size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+      size_t last = first + tileSize + (tile < leftOverJobs ? 1 : 0);
+
+      memcpy(&d[first * sizeJob], &s[first * sizeJob], sizeJob);
+
+      for (size_t i = first + 1; i < last; i++)
+        worker(&d[i * sizeJob], &d[(i - 1) * sizeJob], &s[i * sizeJob]);
+
+      memcpy(&tileSums[tile * sizeJob], &d[(last - 1) * sizeJob], sizeJob);
 
-  // Begin up pass
-  // Travel each level and do computations
-  for (int level = treeHeight; level > 0; level--) {
-    // Calculate current and next levels
-    size_t firstNode = pow(2, level - 1) - 1;
-    size_t lastNode = level == treeHeight
-                      ? nTreeElems - 1
-                      : pow(2, level) - 2;
-
-    #pragma omp parallel default(none) num_threads(nThreads) \
-    shared(worker, nJob, s, sizeJob, tree, treeHeight, level, firstNode, lastNode, nTreeElems)
+      INSTRUMENT_TOC(tileScan, "parallelPrefix: tile scan");
+    }
+
+    // Tree across tiles
+    prefixTree(tileSums, nTiles, sizeJob, worker);
+
+    // Apply prefix of the previous tiles
     #pragma omp for schedule(static)
-    for (size_t node = firstNode; node <= lastNode; node++) {
-      // Check if node has left and/or right children - not leaf
-      if (node * 2 + 1 < nTreeElems) {
-        if (node * 2 + 2 < nTreeElems)
-          worker(&tree[node].sum[0], &tree[node * 2 + 1].sum[0], &tree[node * 2 + 2].sum[0]);
-        else
-          memcpy(&tree[node].sum[0], &tree[node * 2 + 1].sum[0], sizeJob);
-        continue;
-      }
+    for (int tile = 1; tile < nTiles; tile++) {
+      INSTRUMENT_TIC(apply);
 
-      // If node has no children - its a leaf - assign value -------
-      // Check if last level and calculate node number accordingly
-      size_t nodeNum = node - firstNode;
+      size_t first = getTileIndex(tile, leftOverJobs, tileSize);
+      size_t last = first + tileSize + (tile < leftOverJobs ? 1 : 0);
 
-      if (level != treeHeight) {
-        size_t lastLevelNodes = nTreeElems - (pow(2, level) - 1) + nJob % 2;
-        nodeNum += lastLevelNodes / 2 - lastLevelNodes % 2;
-      }
+      for (size_t i = first; i < last; i++)
+        worker(&d[i * sizeJob], &tileSums[(tile - 1) * sizeJob], &d[i * sizeJob]);
 
-      memcpy(&tree[node].sum[0], &s[nodeNum * sizeJob], sizeJob);
+      INSTRUMENT_TOC(apply, "parallelPrefix: apply");
     }
   }
 
-  // printTree(tree, nTreeElems);
+  arenaRelease(arena, mark);
+}
 
-  // Begin down pass
-  // Travel each level and do computations
-  for (int level = 1; level <= treeHeight; level++) {
-    // Calculate current and next levels
-    size_t firstNode = pow(2, level - 1) - 1;
-    size_t lastNode = level == treeHeight
-                      ? nTreeElems - 1
-                      : pow(2, level) - 2;
+void parallelPrefix(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  parallelPrefixCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
+}
 
-    #pragma omp parallel default(none)  num_threads(nThreads) \
-    shared(worker, nJob, d, sizeJob, tree, treeHeight, level, firstNode, lastNode, nTreeElems)
-    #pragma omp for schedule(static)
-    for (size_t node = firstNode; node <= lastNode; node++) {
-      // If first node in level, keep from left value of 0
-      if (level == 1)
-        continue;
+/*
+ * Tiled wavefront - tiles are released as soon as the tiles they depend on are done,
+ * every tile keeps a counter of unfinished predecessors and the thread that brings
+ * it to zero schedules it, so there is no barrier between tile diagonals.
+*/
+typedef struct wavefrontState {
+    atomic_int *pending;    // Unfinished predecessors of each tile
+    size_t height;
+    size_t width;
+    size_t tileSize;
+    size_t nTileRows;
+    size_t nTileCols;
+    int deps;               // Dependencies between tiles, not between cells
+    void (*cell)(size_t row, size_t col, void *ctx);
+    void *ctx;
+} wavefrontState;
+
+// Returns 1 if the tile became ready
+int wavefrontRelease(wavefrontState *state, size_t row, size_t col) {
+  if (row >= state->nTileRows || col >= state->nTileCols)
+    return 0;
 
-      // If its not root, check if node is right or left node
-      if (node % 2 == 0)
-        worker(&tree[node].fromLeft[0], &tree[(node - 1) / 2].fromLeft[0], &tree[node - 1].sum[0]);
-      else
-        worker(&tree[node].fromLeft[0], &tree[node].fromLeft[0], &tree[(node - 1) / 2].fromLeft[0]);
+  return atomic_fetch_sub_explicit(&state->pending[row * state->nTileCols + col], 1, memory_order_acq_rel) == 1;
+}
 
-      // If node has no children - its a leaf - assign value to destiny array
-      // Check if last level and calculate node number accordingly
-      if (node * 2 + 1 >= nTreeElems) {
-        size_t nodeNum = node - firstNode;
+void wavefrontTile(wavefrontState *state, size_t row, size_t col) {
+  for (;;) {
+    size_t lastRow = min((row + 1) * state->tileSize, state->height);
+    size_t lastCol = min((col + 1) * state->tileSize, state->width);
 
-        if (level != treeHeight) {
-          size_t lastLevelNodes = nTreeElems - (pow(2, level) - 1) + nJob % 2;
-          nodeNum += lastLevelNodes / 2 - lastLevelNodes % 2;
-        }
+    // Row major order inside the tile satisfies every dependency shape
+    for (size_t i = row * state->tileSize; i < lastRow; i++)
+      for (size_t j = col * state->tileSize; j < lastCol; j++)
+        state->cell(i, j, state->ctx);
 
-        worker(&d[nodeNum * sizeJob], &tree[node].fromLeft[0], &tree[node].sum[0]);
-      }
+    size_t ready[2][2];
+    int nReady = 0;
+
+    if ((state->deps & WAVEFRONT_UP) && wavefrontRelease(state, row + 1, col)) {
+      ready[nReady][0] = row + 1;
+      ready[nReady++][1] = col;
+    }
+
+    if ((state->deps & WAVEFRONT_LEFT) && wavefrontRelease(state, row, col + 1)) {
+      ready[nReady][0] = row;
+      ready[nReady++][1] = col + 1;
+    }
+
+    if (nReady == 0)
+      return;
+
+    // Hand all but one ready tile to the team, this thread carries on with the last one
+    for (int k = 0; k < nReady - 1; k++) {
+      size_t nextRow = ready[k][0];
+      size_t nextCol = ready[k][1];
+
+      #pragma omp task default(none) firstprivate(state, nextRow, nextCol)
+      wavefrontTile(state, nextRow, nextCol);
+    }
+
+    row = ready[nReady - 1][0];
+    col = ready[nReady - 1][1];
+  }
+}
+
+void wavefrontCtx(size_t height, size_t width, size_t tileSize, int deps, void (*cell)(size_t row, size_t col, void *ctx), void *ctx, patternCtx *pctx) {
+  assert (cell != NULL);
+  assert ((deps & ~(WAVEFRONT_UP | WAVEFRONT_LEFT | WAVEFRONT_UP_LEFT)) == 0);
+
+  INSTRUMENT_CALL("wavefront");
+
+  if (height == 0 || width == 0)
+    return;
+
+  // Cells weigh one value each, row major order satisfies every dependency shape
+  if (dispatch("wavefront", pctx, pctx->nThreads, height * width, sizeof(double)) == EXEC_SERIAL) {
+    for (size_t i = 0; i < height; i++)
+      for (size_t j = 0; j < width; j++)
+        cell(i, j, ctx);
+    return;
+  }
+
+  // Large tiles, unless the grid would have too few tiles per diagonal to keep the team busy
+  if (tileSize == 0) {
+    tileSize = WAVEFRONT_TILE;
+
+    while (tileSize > 1 && (max(height, width) + tileSize - 1) / tileSize < 2 * (size_t) pctx->nThreads)
+      tileSize /= 2;
+  }
+
+  wavefrontState state;
+  state.height = height;
+  state.width = width;
+  state.tileSize = tileSize;
+  state.nTileRows = (height + tileSize - 1) / tileSize;
+  state.nTileCols = (width + tileSize - 1) / tileSize;
+  state.cell = cell;
+  state.ctx = ctx;
+
+  /*
+   * The up-left neighbour of the cells on the top row or left column of a tile lies in the
+   * tile above or to the left, so at tile granularity UP_LEFT means both of them. The
+   * diagonal tile is a predecessor of either one, it needs no counter of its own
+  */
+
+  state.deps = deps & WAVEFRONT_UP_LEFT ? WAVEFRONT_UP | WAVEFRONT_LEFT : deps;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  size_t nTiles = state.nTileRows * state.nTileCols;
+  size_t *seeds = arenaAlloc(arena, nTiles * sizeof(size_t));
+  size_t nSeeds = 0;
+
+  state.pending = arenaAlloc(arena, nTiles * sizeof(atomic_int));
+
+  // Tiles without predecessors are listed up front, the counters change as soon as tasks run
+  for (size_t i = 0; i < state.nTileRows; i++) {
+    for (size_t j = 0; j < state.nTileCols; j++) {
+      int count = ((state.deps & WAVEFRONT_UP) && i > 0) + ((state.deps & WAVEFRONT_LEFT) && j > 0);
+
+      atomic_init(&state.pending[i * state.nTileCols + j], count);
+
+      if (count == 0)
+        seeds[nSeeds++] = i * state.nTileCols + j;
     }
   }
 
-  // printTree(tree, nTreeElems);
+  wavefrontState *statePtr = &state;
+
+  // Tasks run until the end of the region, which waits for every tile
+  #pragma omp parallel default(none) shared(statePtr, seeds, nSeeds) num_threads(pctx->nThreads)
+  {
+    #pragma omp single
+    for (size_t k = 0; k < nSeeds; k++) {
+      size_t i = seeds[k] / statePtr->nTileCols;
+      size_t j = seeds[k] % statePtr->nTileCols;
 
-  for (size_t elem = 0; elem < nTreeElems; elem++) {
-    free(tree[elem].sum);
-    free(tree[elem].fromLeft);
+      #pragma omp task default(none) firstprivate(statePtr, i, j)
+      wavefrontTile(statePtr, i, j);
+    }
   }
 
-  free(tree);
+  arenaRelease(arena, mark);
 }
 
-// Standalone map for tests
-void hyperplane(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+void wavefront(size_t height, size_t width, size_t tileSize, int deps, void (*cell)(size_t row, size_t col, void *ctx), void *ctx) {
+  wavefrontCtx(height, width, tileSize, deps, cell, ctx, patternCtxDefault());
+}
+
+typedef struct hyperplaneArgs {
+    char *d;
+    char *s;
+    char *compMatrix;
+    size_t sizeJob;
+    size_t width;
+    size_t height;
+    void (*worker)(void *v1, const void *v2, const void *v3);
+} hyperplaneArgs;
+
+void hyperplaneCell(size_t currV, size_t currH, void *arg) {
+  hyperplaneArgs *args = arg;
+  char *m = args->compMatrix;
+  char *s = args->s;
+  size_t sizeJob = args->sizeJob;
+  size_t width = args->width;
+  size_t currPos = currV * width + currH;
+
+  // The top row reads the first width elements of the source, the left column the rest
+  const char *up = currV == 0 ? &s[currH * sizeJob] : &m[(currPos - width) * sizeJob];
+  const char *left = currH == 0 ? &s[(currV + width) * sizeJob] : &m[(currPos - 1) * sizeJob];
+
+  args->worker(&m[currPos * sizeJob], up, left);
+
+  // Deal with bottom and right edge-cases
+  if (currV == args->height - 1)
+    memcpy(&args->d[currH * sizeJob], &m[currPos * sizeJob], sizeJob);
+
+  if (currH == width - 1)
+    memcpy(&args->d[(currV + width) * sizeJob], &m[currPos * sizeJob], sizeJob);
+}
+
+void hyperplaneCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx) {
   basicAsserts2(dest, src, worker);
   assert(nJob >= 2);
 
   /*
    * Based on McCool book - Structured Parallel Programming - Chapter 7.5.
+   * Runs on the tiled wavefront, every cell depends on the cells above and to its left
   */
 
-  int nThreads = omp_get_max_threads();
-
-  char *d = dest;
-  char *s = src;
+  INSTRUMENT_CALL("hyperplane");
 
   // Calculate height and width
   size_t height = nJob / 2;
   size_t width = nJob / 2 + nJob % 2;
 
   // Create computation matrix
-  char *compMatrix = calloc(height * width, sizeJob);
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
 
-  for (size_t i = 0; i < width + height - 1; i++) {
-    // Calculate number of cycles for this sweep
-    size_t nCycles = i < height ? i + 1 : height + width - i - 1;
+  hyperplaneArgs args = {dest, src, arenaAlloc(arena, height * width * sizeJob), sizeJob, width, height, worker};
 
-    // Calculate base node vertical and horizontal position
-    // Derive base node position in array
-    // The root (0,0) is the top-left corner
-    size_t baseH = i < height ? 0 : i - height + 1;
-    size_t baseV = i < height ? i : height - 1;
+  // The wavefront cannot tell how large the cells are, so the decision is taken here
+  if (dispatch("hyperplane", pctx, pctx->nThreads, height * width, sizeJob) == EXEC_SERIAL) {
+    for (size_t i = 0; i < height; i++)
+      for (size_t j = 0; j < width; j++)
+        hyperplaneCell(i, j, &args);
+  } else
+    wavefrontCtx(height, width, 0, WAVEFRONT_UP | WAVEFRONT_LEFT, hyperplaneCell, &args, pctx);
 
-    #pragma omp parallel default(none) num_threads(nThreads) \
-    shared(worker, nJob, d, s, sizeJob, width, height, compMatrix, nCycles, baseH, baseV)
-    #pragma omp for schedule(static)
-    for (size_t j = 0; j < nCycles; j++) {
-      // Calculate current node
-      size_t currH = baseH + j;
-      size_t currV = baseV - j;
-      size_t currPos = currV * width + currH;
-
-      // Deal with root case
-      if (currV == 0 && currH == 0) {
-        worker(&compMatrix[0], &s[0], &s[width * sizeJob]);
-        continue;
-      }
-
-      // Deal with top and left edge-cases
-      if (currV == 0)
-        worker(&compMatrix[currPos * sizeJob], &s[currH * sizeJob], &compMatrix[(currPos - 1) * sizeJob]);
-      else if (currH == 0)
-        worker(&compMatrix[currPos * sizeJob], &compMatrix[(currPos - width) * sizeJob], &s[(currV + width) * sizeJob]);
-      else {
-        // Normal case
-        worker(&compMatrix[currPos * sizeJob], &compMatrix[(currPos - width) * sizeJob], &compMatrix[(currPos - 1) * sizeJob]);
-      }
-
-      // Deal with bottom and right edge-cases
-      if (currV == height - 1)
-        memcpy(&d[currH * sizeJob], &compMatrix[currPos * sizeJob], sizeJob);
-
-      if (currH == width - 1)
-        memcpy(&d[(currV + width) * sizeJob], &compMatrix[currPos * sizeJob], sizeJob);
-    }
-  }
+  arenaRelease(arena, mark);
+}
 
-  free(compMatrix);
+// Standalone map for tests
+void hyperplane(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  hyperplaneCtx(dest, src, nJob, sizeJob, worker, patternCtxDefault());
 }
 
 long partition(int *arr, long pivot, long right) {
+  // Median of three as the pivot value, so sorted input does not degrade to O(N^2)
+  long middle = pivot + (right - pivot) / 2;
+
+  if ((arr[pivot] <= arr[middle]) == (arr[middle] <= arr[right])) {
+    int temp = arr[middle];
+    arr[middle] = arr[right];
+    arr[right] = temp;
+  } else if ((arr[middle] <= arr[pivot]) == (arr[pivot] <= arr[right])) {
+    int temp = arr[pivot];
+    arr[pivot] = arr[right];
+    arr[right] = temp;
+  }
+
   // Partition sliding window starts at pivot - 1
   long rValue = arr[right];
   long wStart = pivot - 1;
+  int sendLeft = 0;
 
   for (long wFinish = pivot; wFinish <= right - 1; wFinish++) {
-    if (arr[wFinish] > rValue)
+    // Elements equal to the pivot alternate sides, otherwise duplicates pile up on the left
+    if (arr[wFinish] > rValue || (arr[wFinish] == rValue && (sendLeft ^= 1) == 0))
       continue;
 
     wStart++;
@@ -734,29 +2558,33 @@ long partition(int *arr, long pivot, long right) {
   return wStart + 1;
 }
 
-void quickSortImpl(int *arr, long pivot, long right) {
+void quickSortImpl(int *arr, long pivot, long right, long cutoff) {
   if (pivot >= right)
     return;
 
+  INSTRUMENT_TIC(partitionSample);
+
   long partitionPivot = partition(arr, pivot, right);
 
+  INSTRUMENT_TOC(partitionSample, "quickSort: partition");
+
   // Keep from making tasks when amount of work is low
-  if (right - pivot < QUICKSOORT_TRESHOLD) {
-    quickSortImpl(arr, pivot, partitionPivot - 1);
+  if (right - pivot < cutoff) {
+    quickSortImpl(arr, pivot, partitionPivot - 1, cutoff);
 
-    quickSortImpl(arr, partitionPivot + 1, right);
+    quickSortImpl(arr, partitionPivot + 1, right, cutoff);
   } else {
-    #pragma omp task default(none) shared(arr, pivot, partitionPivot)
-    quickSortImpl(arr, pivot, partitionPivot - 1);
+    #pragma omp task default(none) shared(arr, pivot, partitionPivot, cutoff)
+    quickSortImpl(arr, pivot, partitionPivot - 1, cutoff);
 
-    #pragma omp task default(none) shared(arr, pivot, partitionPivot, right)
-    quickSortImpl(arr, partitionPivot + 1, right);
+    #pragma omp task default(none) shared(arr, pivot, partitionPivot, right, cutoff)
+    quickSortImpl(arr, partitionPivot + 1, right, cutoff);
 
     #pragma omp taskwait
   }
 }
 
-void quickSort(int *arr, size_t arrSize) {
+void quickSortCtx(int *arr, size_t arrSize, patternCtx *pctx) {
   /*
    * Quick Sort implementation based on Introduction to Algorithms book
    * Ideally it would work with every type of data but the fact ints and doubles
@@ -768,25 +2596,45 @@ void quickSort(int *arr, size_t arrSize) {
   assert(arr != NULL);
   assert(arrSize > 0);
 
+  INSTRUMENT_CALL("quickSort");
+
   if (arrSize == 1)
     return;
 
-  int nThreads = omp_get_max_threads();
+  // With no cutoff the recursion never reaches a task, so it stays on the calling thread
+  if (dispatch("quickSort", pctx, pctx->nThreads, arrSize, sizeof(int)) == EXEC_SERIAL) {
+    quickSortImpl(arr, 0, (long) arrSize - 1, LONG_MAX);
+    return;
+  }
+
+  long cutoff = pctx->sortCutoff > 0 ? (long) pctx->sortCutoff : QUICKSOORT_TRESHOLD;
 
-  #pragma omp parallel default(none) shared(arr, arrSize) num_threads(nThreads)
+  #pragma omp parallel default(none) shared(arr, arrSize, cutoff) num_threads(pctx->nThreads)
   {
+    // Recursion is the time of the whole task tree minus its partitions
     #pragma omp single
-    quickSortImpl(arr, 0, (long) arrSize - 1);
+    {
+      INSTRUMENT_TIC(tree);
+
+      quickSortImpl(arr, 0, (long) arrSize - 1, cutoff);
+
+      INSTRUMENT_TOC(tree, "quickSort: task tree");
+    }
   }
 }
 
-long partition2(int *arr1, char *arr2, size_t sizeJob, long pivot, long right) {
+void quickSort(int *arr, size_t arrSize) {
+  quickSortCtx(arr, arrSize, tuneCtx(TUNE_QUICKSORT, arrSize, sizeof(int)));
+}
+
+long partition2(int *arr1, char *arr2, size_t sizeJob, long pivot, long right, char *swapSpace) {
   // Partition sliding window starts at pivot - 1
   long rValue = arr1[right];
   long wStart = pivot - 1;
 
+  // Partitions never yield, so each thread can keep reusing its own swap slot
   int temp1;
-  char *temp2 = calloc(1, sizeJob);
+  char *temp2 = &swapSpace[omp_get_thread_num() * sizeJob];
 
   for (long wFinish = pivot; wFinish <= right - 1; wFinish++) {
     if (arr1[wFinish] > rValue)
@@ -815,34 +2663,36 @@ long partition2(int *arr1, char *arr2, size_t sizeJob, long pivot, long right) {
   memcpy(&arr2[(wStart + 1) * sizeJob], &arr2[right * sizeJob], sizeJob);
   memcpy(&arr2[right * sizeJob], temp2, sizeJob);
 
-  free(temp2);
-
   return wStart + 1;
 }
 
-void quickSortImpl2(int *arr1, char *arr2, size_t sizeJob, long pivot, long right) {
+void quickSortImpl2(int *arr1, char *arr2, size_t sizeJob, long pivot, long right, char *swapSpace, long cutoff) {
   if (pivot >= right)
     return;
 
-  long partitionPivot = partition2(arr1, arr2, sizeJob, pivot, right);
+  INSTRUMENT_TIC(partitionSample);
+
+  long partitionPivot = partition2(arr1, arr2, sizeJob, pivot, right, swapSpace);
+
+  INSTRUMENT_TOC(partitionSample, "quickSort2: partition");
 
   // Keep from making tasks when amount of work is low
-  if (right - pivot < QUICKSOORT_TRESHOLD) {
-    quickSortImpl2(arr1, arr2, sizeJob, pivot, partitionPivot - 1);
+  if (right - pivot < cutoff) {
+    quickSortImpl2(arr1, arr2, sizeJob, pivot, partitionPivot - 1, swapSpace, cutoff);
 
-    quickSortImpl2(arr1, arr2, sizeJob, partitionPivot + 1, right);
+    quickSortImpl2(arr1, arr2, sizeJob, partitionPivot + 1, right, swapSpace, cutoff);
   } else {
-    #pragma omp task default(none) shared(arr1, arr2, sizeJob, pivot, partitionPivot)
-    quickSortImpl2(arr1, arr2, sizeJob, pivot, partitionPivot - 1);
+    #pragma omp task default(none) shared(arr1, arr2, sizeJob, pivot, partitionPivot, swapSpace, cutoff)
+    quickSortImpl2(arr1, arr2, sizeJob, pivot, partitionPivot - 1, swapSpace, cutoff);
 
-    #pragma omp task default(none) shared(arr1, arr2, sizeJob, pivot, partitionPivot, right)
-    quickSortImpl2(arr1, arr2, sizeJob, partitionPivot + 1, right);
+    #pragma omp task default(none) shared(arr1, arr2, sizeJob, pivot, partitionPivot, right, swapSpace, cutoff)
+    quickSortImpl2(arr1, arr2, sizeJob, partitionPivot + 1, right, swapSpace, cutoff);
 
     #pragma omp taskwait
   }
 }
 
-void quickSort2(int *arr1, char *arr2, size_t sizeJob, size_t arrSize) {
+void quickSort2Ctx(int *arr1, char *arr2, size_t sizeJob, size_t arrSize, patternCtx *pctx) {
   /*
    * This quicksort implementation sorts an array and reflects its positions on the second one
    * This second array can have objects of any type
@@ -852,14 +2702,220 @@ void quickSort2(int *arr1, char *arr2, size_t sizeJob, size_t arrSize) {
   assert(arr2 != NULL);
   assert(arrSize > 0);
 
+  INSTRUMENT_CALL("quickSort2");
+
   if (arrSize == 1)
     return;
 
-  int nThreads = omp_get_max_threads();
+  // Every swap of a large object costs three memcpys, moving each one once is cheaper
+  if (sizeJob >= KEY_INDEX_SORT_TRESHOLD) {
+    keyIndexSortCtx(arr1, arr2, sizeJob, arrSize, pctx);
+    return;
+  }
+
+  /*
+   * Serial calls still open a team of one, the swap slots are indexed by the thread
+   * number and a caller inside another region does not have number 0. Without a
+   * cutoff the recursion then never makes a task
+  */
+  int serial = dispatch("quickSort2", pctx, pctx->nThreads, arrSize, sizeof(int) + sizeJob) == EXEC_SERIAL;
+  int nThreads = serial ? 1 : pctx->nThreads;
+  long cutoff = serial ? LONG_MAX : pctx->sortCutoff > 0 ? (long) pctx->sortCutoff : QUICKSOORT_TRESHOLD;
+
+  // One swap slot per thread, shared by all the partitions that thread runs
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+  char *swapSpace = arenaAlloc(arena, nThreads * sizeJob);
 
-  #pragma omp parallel default(none) shared(arr1, arr2, sizeJob, arrSize) num_threads(nThreads)
+  #pragma omp parallel default(none) shared(arr1, arr2, sizeJob, arrSize, swapSpace, cutoff) num_threads(nThreads)
   {
     #pragma omp single
-    quickSortImpl2(arr1, arr2, sizeJob, 0, (long) arrSize - 1);
+    {
+      INSTRUMENT_TIC(tree);
+
+      quickSortImpl2(arr1, arr2, sizeJob, 0, (long) arrSize - 1, swapSpace, cutoff);
+
+      INSTRUMENT_TOC(tree, "quickSort2: task tree");
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void quickSort2(int *arr1, char *arr2, size_t sizeJob, size_t arrSize) {
+  quickSort2Ctx(arr1, arr2, sizeJob, arrSize, patternCtxDefault());
+}
+
+/*
+ *  Batch Patterns
+ *  Same patterns as above, but workers get a whole tile per call
+*/
+
+void mapBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker worker, void *ctx, patternCtx *pctx) {
+  batchAsserts(dest, src, sizeJob, worker);
+
+  if (nJob == 0)
+    return;
+
+  INSTRUMENT_CALL("mapBatch");
+
+  char *d = dest;
+  char *s = src;
+
+  // A single tile, the worker sees every element in one call
+  if (dispatch("mapBatch", pctx, pctx->nThreads, nJob, sizeJob) == EXEC_SERIAL) {
+    worker(d, s, nJob, sizeJob, ctx);
+    return;
+  }
+
+  // One tile per thread, worker is called once per tile
+  int nTiles = min(nJob, pctx->nThreads);
+  size_t tileSize = nJob / nTiles;
+  int leftOverJobs = (int) (nJob % nTiles);
+
+  #pragma omp parallel default(none) num_threads(nTiles) \
+  shared(worker, ctx, d, s, sizeJob, tileSize, leftOverJobs, nTiles)
+  #pragma omp for schedule(static)
+  for (int tile = 0; tile < nTiles; tile++) {
+    size_t tileSizeWithOffset = tileSize + (tile < leftOverJobs ? 1 : 0);
+    size_t tileIndex = getTileIndex(tile, leftOverJobs, tileSize);
+
+    worker(&d[tileIndex * sizeJob], &s[tileIndex * sizeJob], tileSizeWithOffset, sizeJob, ctx);
+  }
+}
+
+void mapBatch(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker worker, void *ctx) {
+  mapBatchCtx(dest, src, nJob, sizeJob, worker, ctx, patternCtxDefault());
+}
+
+// Gathers entries [first, last) of the filter, then transforms them while they are still hot
+void gatherBatchTile(char *d, const char *s, size_t nJob, size_t sizeJob, const int *filter, size_t first, size_t last,
+                     batchWorker worker, void *ctx) {
+  for (size_t i = first; i < last; i++) {
+    if ((size_t) filter[i] >= nJob) {
+      fprintf(stderr, "Invalid filter index in Gather");
+      exit(1);
+    }
+
+    memcpy(&d[i * sizeJob], &s[filter[i] * sizeJob], sizeJob);
   }
+
+  worker(&d[first * sizeJob], &d[first * sizeJob], last - first, sizeJob, ctx);
+}
+
+void gatherBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter, batchWorker worker, void *ctx, patternCtx *pctx) {
+  filteredAsserts(dest, src, nJob, sizeJob, filter);
+  assert (worker != NULL);
+  assert (nFilter >= 0);
+
+  INSTRUMENT_CALL("gatherBatch");
+
+  char *d = dest;
+  char *s = src;
+
+  // Gather one cache sized tile, then transform it while it is still hot
+  size_t tileSize = batchTileSize(sizeJob);
+  size_t nTiles = (nFilter + tileSize - 1) / tileSize;
+
+  if (dispatch("gatherBatch", pctx, pctx->nThreads, nFilter, sizeJob) == EXEC_SERIAL) {
+    for (size_t tile = 0; tile < nTiles; tile++)
+      gatherBatchTile(d, s, nJob, sizeJob, filter, tile * tileSize, min((tile + 1) * tileSize, nFilter), worker, ctx);
+    return;
+  }
+
+  #pragma omp parallel default(none) num_threads(pctx->nThreads) \
+  shared(filter, nFilter, d, s, sizeJob, nJob, worker, ctx, tileSize, nTiles)
+  #pragma omp for schedule(static)
+  for (size_t tile = 0; tile < nTiles; tile++)
+    gatherBatchTile(d, s, nJob, sizeJob, filter, tile * tileSize, min((tile + 1) * tileSize, nFilter), worker, ctx);
+}
+
+void gatherBatch(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter, batchWorker worker, void *ctx) {
+  gatherBatchCtx(dest, src, nJob, sizeJob, filter, nFilter, worker, ctx, patternCtxDefault());
+}
+
+void itemBoundPipelineBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker workerList[], size_t nWorkers, void *ctx, patternCtx *pctx) {
+  assert (dest != NULL);
+  assert (src != NULL);
+  assert (workerList != NULL);
+  assert (sizeJob > 0);
+  for (size_t i = 0; i < nWorkers; i++)
+    assert (workerList[i] != NULL);
+
+  /*
+   * Same as the item bound pipeline, but a worker accompanies
+   * a cache sized tile instead of a single element through every stage
+  */
+
+  INSTRUMENT_CALL("itemBoundPipelineBatch");
+
+  char *d = dest;
+  char *s = src;
+
+  if (nWorkers == 0)
+    return;
+
+  size_t tileSize = batchTileSize(sizeJob);
+  size_t nTiles = (nJob + tileSize - 1) / tileSize;
+
+  // Tiles one after the other, the same calls as the team would make
+  int serial = dispatch("itemBoundPipelineBatch", pctx, pctx->nThreads, nJob, sizeJob * nWorkers) == EXEC_SERIAL;
+
+  #pragma omp parallel default(none) num_threads(pctx->nThreads) if (!serial) \
+  shared(workerList, nJob, nWorkers, d, s, sizeJob, ctx, tileSize, nTiles)
+  #pragma omp for schedule(static)
+  for (size_t tile = 0; tile < nTiles; tile++) {
+    size_t first = tile * tileSize;
+    size_t count = min(first + tileSize, nJob) - first;
+
+    // Do first worker
+    workerList[0](&d[first * sizeJob], &s[first * sizeJob], count, sizeJob, ctx);
+
+    // Do subsequent workers
+    for (size_t j = 1; j < nWorkers; j++)
+      workerList[j](&d[first * sizeJob], &d[first * sizeJob], count, sizeJob, ctx);
+  }
+}
+
+void itemBoundPipelineBatch(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker workerList[], size_t nWorkers, void *ctx) {
+  itemBoundPipelineBatchCtx(dest, src, nJob, sizeJob, workerList, nWorkers, ctx, patternCtxDefault());
+}
+
+typedef struct farmBatchArgs {
+    char *d;
+    char *s;
+    size_t sizeJob;
+    batchWorker worker;
+    void *ctx;
+} farmBatchArgs;
+
+void farmBatchRange(size_t first, size_t count, void *arg) {
+  farmBatchArgs *args = arg;
+
+  args->worker(&args->d[first * args->sizeJob], &args->s[first * args->sizeJob], count, args->sizeJob, args->ctx);
+}
+
+void farmBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker worker, size_t nWorkers, void *ctx, patternCtx *pctx) {
+  batchAsserts(dest, src, sizeJob, worker);
+  assert (nWorkers >= 1);
+
+  INSTRUMENT_CALL("farmBatch");
+
+  farmBatchArgs args = {dest, src, sizeJob, worker, ctx};
+
+  // Tiles in order, still at most one tile per call
+  if (dispatch("farmBatch", pctx, nWorkers, nJob, sizeJob) == EXEC_SERIAL) {
+    for (size_t first = 0; first < nJob; first += batchTileSize(sizeJob))
+      farmBatchRange(first, min(first + batchTileSize(sizeJob), nJob) - first, &args);
+    return;
+  }
+
+  // Workers get ranges of at most one tile, stolen tiles are split again by the thief
+  size_t grain = min(farmGrain(nJob, nWorkers, pctx), batchTileSize(sizeJob));
+
+  farmRun(nJob, grain, nWorkers, farmBatchRange, &args, pctx);
+}
+
+void farmBatch(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker worker, size_t nWorkers, void *ctx) {
+  farmBatchCtx(dest, src, nJob, sizeJob, worker, nWorkers, ctx, patternCtxDefault());
 }
@@ -1,6 +1,14 @@
 #ifndef __PATTERNS_H
 #define __PATTERNS_H
 
+#include <stddef.h>
+#include "context.h"
+
+// Batch worker - processes count elements spaced stride bytes apart in one call
+// [ dest[i] = op (src[i]) for i < count ], ctx is user data passed through untouched
+typedef void (*batchWorker)(void *dest, const void *src, size_t count, size_t stride, void *ctx);
+
+// map, reduce, scan and quickSort run with the tuned settings of their input size, see tune.h
 void map(
     void *dest,           // Target array
     void *src,            // Source array
@@ -17,6 +25,25 @@ void reduce(
     void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
 );
 
+// Reduce of the mapped elements, the mapped array is never stored
+void mapReduce(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*mapWorker)(void *v1, const void *v2), // [ v1 = map (v2) ]
+    void (*reduceWorker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+// Reduce with a fixed blocking and a pairwise tree combine, bitwise reproducible for any # threads
+void deterministicReduce(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
 void scan(
     void *dest,           // Target array
     void *src,            // Source array
@@ -25,6 +52,16 @@ void scan(
     void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
 );
 
+// Inclusive scan of the mapped elements, the mapped array is never stored
+void transformScan(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*mapWorker)(void *v1, const void *v2), // [ v1 = map (v2) ]
+    void (*scanWorker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
 void exclusiveScan(
     void *dest,           // Target array
     void *src,            // Source array
@@ -33,6 +70,43 @@ void exclusiveScan(
     void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
 );
 
+void lookbackScan(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+void exclusiveLookbackScan(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+// Reduces every segment of the source, segment k is [offsets[k], offsets[k + 1]), the last one ends at nJob
+void segmentedReduce(
+    void *dest,           // Target array, one element per segment
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    const size_t *offsets, // Start of each segment, ascending from 0
+    size_t nSegments,     // # segments
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+// Inclusive scan that restarts at every element with a head flag
+void segmentedScan(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    const int *flags,     // Non zero for the first element of each segment
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
 int pack(
     void *dest,           // Target array
     void *src,            // Source array
@@ -41,6 +115,16 @@ int pack(
     const int *filter     // Filer for pack
 );
 
+// Keeps the elements the predicate accepts, in order, and returns how many were kept
+// dest may be src, in which case the kept elements are compacted in place
+int packIf(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    int (*predicate)(const void *v1) // Non zero for the elements to keep
+);
+
 void gather(
     void *dest,           // Target array
     void *src,            // Source array
@@ -84,6 +168,15 @@ void pipeline(
     size_t nWorkers       // # stages in the pipeline
 );
 
+void fusedPipeline(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*workerList[])(void *v1, const void *v2), // one function for each stage of the pipeline
+    size_t nWorkers       // # stages in the pipeline
+);
+
 void serialPipeline(
     void *dest,           // Target array
     void *src,            // Source array
@@ -127,6 +220,22 @@ void hyperplane(
     void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
 );
 
+// Neighbours a wavefront cell reads, any combination of them
+typedef enum wavefrontDeps {
+    WAVEFRONT_UP = 1,       // (row - 1, col)
+    WAVEFRONT_LEFT = 2,     // (row, col - 1)
+    WAVEFRONT_UP_LEFT = 4   // (row - 1, col - 1)
+} wavefrontDeps;
+
+void wavefront(
+    size_t height,        // # rows of the grid
+    size_t width,         // # columns of the grid
+    size_t tileSize,      // Side of the square tiles, 0 picks it from the grid and the team size
+    int deps,             // Neighbours each cell depends on, WAVEFRONT_* flags
+    void (*cell)(size_t row, size_t col, void *ctx), // Computes one cell
+    void *ctx             // User data for the cell function
+);
+
 void quickSort(
     int *arr, // Source int array
     size_t arrSize // # elements in the source int array
@@ -139,5 +248,114 @@ void quickSort2(
     size_t arrSize // # elements in the source int array
 );
 
+void mapBatch(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    batchWorker worker,   // Called once per tile
+    void *ctx             // User data for the worker
+);
+
+void gatherBatch(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    const int *filter,    // Filter for gather
+    int nFilter,          // # elements in the filter
+    batchWorker worker,   // Applied in place to each gathered tile
+    void *ctx             // User data for the worker
+);
+
+void itemBoundPipelineBatch(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    batchWorker workerList[], // one function for each stage of the pipeline
+    size_t nWorkers,      // # stages in the pipeline
+    void *ctx             // User data for the workers
+);
+
+void farmBatch(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    batchWorker worker,   // Called once per tile
+    size_t nWorkers,      // # workers in the farm
+    void *ctx             // User data for the worker
+);
+
+/*
+ * Context aware variants - same arguments as above, plus the context
+ * the pattern takes its team and scheduling from
+ */
+
+void mapCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), patternCtx *pctx);
+
+void reduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void mapReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*mapWorker)(void *v1, const void *v2), void (*reduceWorker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void deterministicReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void scanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+// Inclusive scan that starts from seed, [ dest[0] = op (seed, src[0]) ], NULL for a plain scan
+void scanSeededCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), const void *seed, patternCtx *pctx);
+
+void transformScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*mapWorker)(void *v1, const void *v2), void (*scanWorker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void exclusiveScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void lookbackScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void exclusiveLookbackScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void segmentedReduceCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const size_t *offsets, size_t nSegments, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void segmentedScanCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *flags, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+int packCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx);
+
+int packIfCtx(void *dest, void *src, size_t nJob, size_t sizeJob, int (*predicate)(const void *v1), patternCtx *pctx);
+
+void gatherCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter, patternCtx *pctx);
+
+void scatterCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx);
+
+void priorityScatterCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, patternCtx *pctx);
+
+void itemBoundPipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx);
+
+void pipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx);
+
+void fusedPipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx);
+
+void serialPipelineCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx);
+
+void farmCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), size_t nWorkers, patternCtx *pctx);
+
+void stencilCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2), int nShift, patternCtx *pctx);
+
+void parallelPrefixCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void hyperplaneCtx(void *dest, void *src, size_t nJob, size_t sizeJob, void (*worker)(void *v1, const void *v2, const void *v3), patternCtx *pctx);
+
+void wavefrontCtx(size_t height, size_t width, size_t tileSize, int deps, void (*cell)(size_t row, size_t col, void *ctx), void *ctx, patternCtx *pctx);
+
+void quickSortCtx(int *arr, size_t arrSize, patternCtx *pctx);
+
+void quickSort2Ctx(int *arr1, char *arr2, size_t sizeJob, size_t arrSize, patternCtx *pctx);
+
+void mapBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker worker, void *ctx, patternCtx *pctx);
+
+void gatherBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, const int *filter, int nFilter, batchWorker worker, void *ctx, patternCtx *pctx);
+
+void itemBoundPipelineBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker workerList[], size_t nWorkers, void *ctx, patternCtx *pctx);
+
+void farmBatchCtx(void *dest, void *src, size_t nJob, size_t sizeJob, batchWorker worker, size_t nWorkers, void *ctx, patternCtx *pctx);
 
 #endif
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <omp.h>
+#include "placement.h"
+
+// Largest node id the masks can hold
+#define PLACEMENT_MAX_NODES 64
+
+// Nodes with memory, read from sysfs as a list like "0-3,6", node 0 when unavailable
+static unsigned long onlineNodes(void) {
+  FILE *file = fopen("/sys/devices/system/node/online", "r");
+  unsigned long mask = 0;
+  int first;
+  int last;
+  char separator;
+
+  if (file == NULL)
+    return 1;
+
+  while (fscanf(file, "%d", &first) == 1) {
+    last = first;
+
+    if (fscanf(file, "%c", &separator) == 1 && separator == '-')
+      if (fscanf(file, "%d%c", &last, &separator) < 1)
+        break;
+
+    for (int node = first; node <= last && node < PLACEMENT_MAX_NODES; node++)
+      mask |= 1UL << node;
+
+    if (separator != ',')
+      break;
+  }
+
+  fclose(file);
+
+  return mask != 0 ? mask : 1;
+}
+
+int placementApply(void *ptr, size_t bytes, patternPlacement placement, int node) {
+  assert (ptr != NULL);
+  assert (node >= 0 && node < PLACEMENT_MAX_NODES);
+
+  unsigned long mask;
+  int mode;
+
+  switch (placement) {
+    case PLACEMENT_INTERLEAVE:
+      mode = MPOL_INTERLEAVE;
+      mask = onlineNodes();
+      break;
+    case PLACEMENT_BIND:
+      mode = MPOL_BIND;
+      mask = 1UL << node;
+      break;
+    default:
+      return 0;
+  }
+
+  // Called through syscall so the build does not depend on libnuma
+  return syscall(SYS_mbind, ptr, bytes, mode, &mask, PLACEMENT_MAX_NODES + 1, 0) == 0 ? 0 : -1;
+}
+
+void placementFirstTouch(void *ptr, size_t nJob, size_t sizeJob, patternCtx *pctx) {
+  assert (ptr != NULL);
+  assert (pctx->nThreads >= 1);
+
+  char *p = ptr;
+  int nThreads = pctx->nThreads;
+
+  /*
+   * Same split as schedule(static) without a chunk size, which is also the
+   * split of the tiled patterns, so each thread touches the pages it will use
+  */
+  if (pctx->schedule == SCHEDULE_STATIC && pctx->chunkSize == 0) {
+    #pragma omp parallel default(none) shared(p, nJob, sizeJob) num_threads(nThreads)
+    {
+      size_t nTeam = omp_get_num_threads();
+      size_t thread = omp_get_thread_num();
+      size_t tileSize = nJob / nTeam;
+      size_t leftOverJobs = nJob % nTeam;
+      size_t first = thread * tileSize + (thread < leftOverJobs ? thread : leftOverJobs);
+      size_t last = first + tileSize + (thread < leftOverJobs);
+
+      memset(&p[first * sizeJob], 0, (last - first) * sizeJob);
+    }
+
+    return;
+  }
+
+  /*
+   * Other schedules touch the buffer with the same loop as the element wise patterns.
+   * Chunked static schedules land every page where the pattern will use it, dynamic and
+   * guided ones hand out their chunks at run time, so no first touch can predict them
+  */
+  #pragma omp parallel default(none) shared(p, nJob, sizeJob, pctx) num_threads(nThreads)
+  {
+    patternCtxApplySchedule(pctx);
+
+    #pragma omp for schedule(runtime)
+    for (size_t i = 0; i < nJob; i++)
+      memset(&p[i * sizeJob], 0, sizeJob);
+  }
+}
+
+void *placementAlloc(size_t nJob, size_t sizeJob, patternCtx *pctx) {
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t bytes = (nJob * sizeJob + pageSize - 1) / pageSize * pageSize;
+
+  // Placement works on whole pages, the buffer never shares one with other data
+  void *ptr = aligned_alloc(pageSize, bytes > 0 ? bytes : pageSize);
+
+  if (ptr == NULL) {
+    fprintf(stderr, "Could not allocate %zu bytes\n", bytes);
+    exit(1);
+  }
+
+  if (bytes > 0 && placementApply(ptr, bytes, pctx->placement, pctx->placementNode) != 0) {
+    static int warned = 0;
+
+    if (!warned)
+      fprintf(stderr, "Page policy not available, falling back to first touch\n");
+
+    warned = 1;
+  }
+
+  placementFirstTouch(ptr, nJob, sizeJob, pctx);
+
+  return ptr;
+}
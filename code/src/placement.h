@@ -0,0 +1,39 @@
+#ifndef __PLACEMENT_H
+#define __PLACEMENT_H
+
+#include <stddef.h>
+#include "context.h"
+
+/*
+ * NUMA aware buffers - pages are only placed when first written, so a buffer
+ * initialized by one thread lives on one node no matter which threads use it.
+ * These helpers touch every buffer with the team and schedule of the pattern that
+ * will use it, optionally under an interleave or bind policy from the context.
+ * Pages only match the pattern for static schedules, and only when the pattern runs
+ * with the same team and chunk, a context rewritten by the tuner may split differently.
+ */
+
+// Page aligned zeroed buffer placed for the schedule of the context over nJob elements, release it with free
+void *placementAlloc(
+    size_t nJob,          // # elements in the buffer
+    size_t sizeJob,       // Size of each element in the buffer
+    patternCtx *pctx      // Team and page policy
+);
+
+// Zeroes a buffer with the split of nJob elements the schedule of the context gives its team
+void placementFirstTouch(
+    void *ptr,            // Buffer, none of its pages should have been written yet
+    size_t nJob,          // # elements in the buffer
+    size_t sizeJob,       // Size of each element in the buffer
+    patternCtx *pctx      // Team and schedule of the pattern that will use the buffer
+);
+
+// Sets the page policy of a page aligned range, 0 if the kernel took it, -1 if it did not
+int placementApply(
+    void *ptr,            // Page aligned start of the range
+    size_t bytes,         // Size of the range
+    patternPlacement placement, // Page policy
+    int node              // Node of PLACEMENT_BIND
+);
+
+#endif
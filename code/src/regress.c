@@ -0,0 +1,1433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <omp.h>
+#include "regress.h"
+#include "patterns.h"
+#include "sort.h"
+#include "stencil.h"
+#include "stream.h"
+#include "typed.h"
+#include "offload.h"
+#include "outofcore.h"
+
+// Random sizes, values and filters are the same on every run
+#define REGRESS_SEED 2019
+
+// # random sizes checked besides the corner cases, none above REGRESS_MAX_RANDOM
+#define REGRESS_RANDOM_SIZES 4
+#define REGRESS_MAX_RANDOM 100000
+
+// Smallest team of the forced runs, odd so the tiles do not divide the inputs evenly
+#define REGRESS_TEAM 3
+
+// Chunk of the dynamic schedule of the forced runs
+#define REGRESS_CHUNK 3
+
+// Half width of the stencil window
+#define REGRESS_SHIFT 2
+
+// Row length of the 2D grids and the tall wavefronts, prime so rows never line up with the tiles
+#define REGRESS_WIDTH 37
+
+// # rows of the wide wavefronts
+#define REGRESS_ROWS 4
+
+// Tile of the wavefronts of every dependency shape, small so most cells sit on a tile edge,
+// and their largest grid, since every tile is a task
+#define REGRESS_TILE 2
+#define REGRESS_WAVEFRONT_JOBS (1 << 16)
+
+// # time steps of the grid stencils
+#define REGRESS_STEPS 3
+
+// Cache block and out-of-core window of the forced runs, in elements, so tiles and windows
+// are cut even on the corner case sizes
+#define REGRESS_BLOCK 64
+#define REGRESS_WINDOW 100
+
+// Spreads the values over all 64 bits, for the sorts on full width keys
+#define REGRESS_GOLDEN 0x9E3779B97F4A7C15ull
+
+// Longest line and pattern name of a baseline file
+#define REGRESS_LINE 256
+#define REGRESS_NAME 32
+
+static const size_t edgeSizes[] = {0, 1, 2, 3, 7, 31, 33, 100, 1023, 1025, 4099};
+
+typedef uint64_t elem;
+
+// Inputs of every pattern, generated for nJob elements
+typedef struct regressData {
+    size_t nJob;
+    elem *src;
+    elem *dest;             // Output of the pattern
+    elem *expected;         // Output of the reference
+    int *filter;            // Random positions below nJob, for gather and scatter
+    int *mask;              // 0 or 1 for every element, for pack
+    int *flags;             // Segment heads, the first element always is one
+    size_t *offsets;        // Start of every segment, some segments are empty
+    size_t nSegments;
+    int *keys;              // Unsorted keys with duplicates
+    int *sortKeys;          // Keys the sort runs on
+    double *reals;          // Source values as doubles, for the compensated sum
+    size_t nOut;            // # values of dest the pattern produced
+} regressData;
+
+typedef struct regressCase {
+    const char *name;
+    size_t minJob;          // Smallest # elements the pattern accepts
+    size_t maxJob;          // Largest # elements it is run on, 0 for no limit
+    int traffic;            // # arrays of nJob elements a run reads or writes, for the bandwidth
+    double (*run)(regressData *data, size_t nJob, patternCtx *pctx); // Seconds of the pattern alone
+    size_t (*reference)(regressData *data, size_t nJob); // # values written to expected
+} regressCase;
+
+typedef struct regressBaseline {
+    char name[REGRESS_NAME];
+    size_t nJob;
+    int nThreads;
+    double elementsPerSecond;
+} regressBaseline;
+
+/*
+ *  WORKERS
+*/
+
+// Unsigned arithmetic wraps, so sums of any length are exact and the same in every order
+static void workerInc(void *v1, const void *v2) {
+  *(elem *) v1 = *(const elem *) v2 + 1;
+}
+
+static void workerDouble(void *v1, const void *v2) {
+  *(elem *) v1 = *(const elem *) v2 * 2;
+}
+
+static void workerAccumulate(void *v1, const void *v2) {
+  *(elem *) v1 += *(const elem *) v2;
+}
+
+static void workerAdd(void *v1, const void *v2, const void *v3) {
+  *(elem *) v1 = *(const elem *) v2 + *(const elem *) v3;
+}
+
+static int predicateOdd(const void *v1) {
+  return (int) (*(const elem *) v1 & 1);
+}
+
+static void batchInc(void *dest, const void *src, size_t count, size_t stride, void *ctx) {
+  (void) ctx;
+
+  for (size_t i = 0; i < count; i++)
+    *(elem *) ((char *) dest + i * stride) = *(const elem *) ((const char *) src + i * stride) + 1;
+}
+
+static void (*pipelineStages[])(void *v1, const void *v2) = {workerInc, workerDouble, workerInc};
+
+static batchWorker batchStages[] = {batchInc, batchInc};
+
+#define N_STAGES(stages) (sizeof(stages) / sizeof(stages[0]))
+
+static int compareKeys(const void *a, const void *b) {
+  int x = *(const int *) a;
+  int y = *(const int *) b;
+
+  return (x > y) - (x < y);
+}
+
+static int compareElems(const void *a, const void *b) {
+  elem x = *(const elem *) a;
+  elem y = *(const elem *) b;
+
+  return (x > y) - (x < y);
+}
+
+static void workerSubtract(void *v1, const void *v2) {
+  *(elem *) v1 -= *(const elem *) v2;
+}
+
+// Sum of the box of the grid radius around the cell
+static void gridSum(void *dest, const stencilCell *cell, void *ctx) {
+  const stencilGrid *grid = ctx;
+  elem sum = 0;
+
+  for (int dy = -grid->radius[1]; dy <= grid->radius[1]; dy++)
+    for (int dx = -grid->radius[0]; dx <= grid->radius[0]; dx++)
+      sum += *(const elem *) STENCIL_AT(cell, dx, dy, 0);
+
+  *(elem *) dest = sum;
+}
+
+// Grid of a wavefront run, src and the target are row major
+typedef struct regressWavefront {
+    const elem *src;
+    elem *m;                // Target grid, zero before the run
+    size_t width;
+    int deps;               // WAVEFRONT_* flags the cells read
+} regressWavefront;
+
+/*
+ * Every cell adds its source value to the neighbours it depends on, missing ones count as
+ * zero. The sum is added to the zeroed target, so a cell that runs twice, or before one of
+ * its neighbours, leaves a value that differs from the reference
+ */
+static void wavefrontCell(size_t row, size_t col, void *ctx) {
+  regressWavefront *w = ctx;
+  size_t i = row * w->width + col;
+  elem value = w->src[i];
+
+  if ((w->deps & WAVEFRONT_UP) && row > 0)
+    value += w->m[i - w->width];
+
+  if ((w->deps & WAVEFRONT_LEFT) && col > 0)
+    value += w->m[i - 1];
+
+  if ((w->deps & WAVEFRONT_UP_LEFT) && row > 0 && col > 0)
+    value += w->m[i - w->width - 1];
+
+  w->m[i] += value;
+}
+
+// Whole rows of REGRESS_WIDTH cells of the first nJob elements
+static size_t planeCells(size_t nJob) {
+  return nJob / REGRESS_WIDTH * REGRESS_WIDTH;
+}
+
+static stencilGrid lineGrid(size_t nJob) {
+  stencilGrid grid = {{nJob, 1, 1}, {REGRESS_SHIFT, 0, 0}, STENCIL_CLAMP, 0};
+
+  return grid;
+}
+
+static stencilGrid planeGrid(size_t nJob) {
+  stencilGrid grid = {{REGRESS_WIDTH, nJob / REGRESS_WIDTH, 1}, {1, 1, 0}, STENCIL_ZERO, 0};
+
+  return grid;
+}
+
+static stencilGrid slidingGrid(size_t nJob) {
+  stencilGrid grid = {{REGRESS_WIDTH, nJob / REGRESS_WIDTH, 1}, {REGRESS_SHIFT, 1, 0}, STENCIL_ZERO, 0};
+
+  return grid;
+}
+
+// Signed keys around zero, with duplicates
+static void signedKeys(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->sortKeys[i] = data->keys[i] - (int) (nJob / 4);
+}
+
+// Key in the upper and position in the lower half, so a plain sort of them is a stable sort of the keys
+static void keyPositions(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = (elem) data->keys[i] << 32 | i;
+
+  qsort(data->expected, nJob, sizeof(elem), compareElems);
+}
+
+/*
+ *  PATTERNS UNDER TEST
+*/
+
+#define TIMED(call) do {                                                      \
+  double start = omp_get_wtime();                                             \
+  call;                                                                       \
+  return omp_get_wtime() - start;                                             \
+} while (0)
+
+// The typed kernels take their team from the OpenMP default, set to the one of the context
+#define TIMED_TEAM(pctx, call) do {                                           \
+  int previous = omp_get_max_threads();                                       \
+  omp_set_num_threads((pctx)->nThreads);                                      \
+  double start = omp_get_wtime();                                             \
+  call;                                                                       \
+  double elapsed = omp_get_wtime() - start;                                   \
+  omp_set_num_threads(previous);                                              \
+  return elapsed;                                                             \
+} while (0)
+
+static double runMap(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(mapCtx(data->dest, data->src, nJob, sizeof(elem), workerInc, pctx));
+}
+
+static double runReduce(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = 1;
+  TIMED(reduceCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runMapReduce(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = 1;
+  TIMED(mapReduceCtx(data->dest, data->src, nJob, sizeof(elem), workerDouble, workerAdd, pctx));
+}
+
+static double runDeterministicReduce(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = 1;
+  TIMED(deterministicReduceCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runScan(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(scanCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runTransformScan(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(transformScanCtx(data->dest, data->src, nJob, sizeof(elem), workerDouble, workerAdd, pctx));
+}
+
+static double runExclusiveScan(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(exclusiveScanCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runLookbackScan(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(lookbackScanCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runExclusiveLookbackScan(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(exclusiveLookbackScanCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runSegmentedReduce(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = data->nSegments;
+  TIMED(segmentedReduceCtx(data->dest, data->src, nJob, sizeof(elem), data->offsets, data->nSegments, workerAdd, pctx));
+}
+
+static double runSegmentedScan(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(segmentedScanCtx(data->dest, data->src, nJob, sizeof(elem), data->flags, workerAdd, pctx));
+}
+
+static double runPack(regressData *data, size_t nJob, patternCtx *pctx) {
+  double start = omp_get_wtime();
+  int kept = packCtx(data->dest, data->src, nJob, sizeof(elem), data->mask, pctx);
+  double elapsed = omp_get_wtime() - start;
+
+  data->nOut = kept;
+  return elapsed;
+}
+
+static double runPackIf(regressData *data, size_t nJob, patternCtx *pctx) {
+  double start = omp_get_wtime();
+  int kept = packIfCtx(data->dest, data->src, nJob, sizeof(elem), predicateOdd, pctx);
+  double elapsed = omp_get_wtime() - start;
+
+  data->nOut = kept;
+  return elapsed;
+}
+
+static double runGather(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(gatherCtx(data->dest, data->src, nJob, sizeof(elem), data->filter, (int) nJob, pctx));
+}
+
+static double runScatter(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(scatterCtx(data->dest, data->src, nJob, sizeof(elem), data->filter, pctx));
+}
+
+static double runPriorityScatter(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(priorityScatterCtx(data->dest, data->src, nJob, sizeof(elem), data->filter, pctx));
+}
+
+static double runPipeline(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(pipelineCtx(data->dest, data->src, nJob, sizeof(elem), pipelineStages, N_STAGES(pipelineStages), pctx));
+}
+
+static double runItemBoundPipeline(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(itemBoundPipelineCtx(data->dest, data->src, nJob, sizeof(elem), pipelineStages, N_STAGES(pipelineStages), pctx));
+}
+
+static double runFusedPipeline(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(fusedPipelineCtx(data->dest, data->src, nJob, sizeof(elem), pipelineStages, N_STAGES(pipelineStages), pctx));
+}
+
+static double runSerialPipeline(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(serialPipelineCtx(data->dest, data->src, nJob, sizeof(elem), pipelineStages, N_STAGES(pipelineStages), pctx));
+}
+
+static double runFarm(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(farmCtx(data->dest, data->src, nJob, sizeof(elem), workerInc, pctx->nThreads, pctx));
+}
+
+static double runStencil(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(stencilCtx(data->dest, data->src, nJob, sizeof(elem), workerAccumulate, REGRESS_SHIFT, pctx));
+}
+
+static double runParallelPrefix(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(parallelPrefixCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runHyperplane(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(hyperplaneCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+// The keys are copied before the clock starts and to dest after it stops
+static double runQuickSort(regressData *data, size_t nJob, patternCtx *pctx) {
+  memcpy(data->sortKeys, data->keys, nJob * sizeof(int));
+
+  double start = omp_get_wtime();
+  quickSortCtx(data->sortKeys, nJob, pctx);
+  double elapsed = omp_get_wtime() - start;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->dest[i] = data->sortKeys[i];
+
+  data->nOut = nJob;
+  return elapsed;
+}
+
+// Every payload is three times its key, so it shows whether it moved with it
+static double runQuickSort2(regressData *data, size_t nJob, patternCtx *pctx) {
+  memcpy(data->sortKeys, data->keys, nJob * sizeof(int));
+
+  for (size_t i = 0; i < nJob; i++)
+    data->dest[i] = (elem) data->keys[i] * 3;
+
+  data->nOut = nJob;
+  TIMED(quickSort2Ctx(data->sortKeys, (char *) data->dest, sizeof(elem), nJob, pctx));
+}
+
+static double runMapBatch(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(mapBatchCtx(data->dest, data->src, nJob, sizeof(elem), batchInc, NULL, pctx));
+}
+
+static double runGatherBatch(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(gatherBatchCtx(data->dest, data->src, nJob, sizeof(elem), data->filter, (int) nJob, batchInc, NULL, pctx));
+}
+
+static double runItemBoundPipelineBatch(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(itemBoundPipelineBatchCtx(data->dest, data->src, nJob, sizeof(elem), batchStages, N_STAGES(batchStages), NULL, pctx));
+}
+
+static double runFarmBatch(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(farmBatchCtx(data->dest, data->src, nJob, sizeof(elem), batchInc, pctx->nThreads, NULL, pctx));
+}
+
+// The middle stage is farmed out to the team
+static double runStreamingPipeline(regressData *data, size_t nJob, patternCtx *pctx) {
+  int nStageWorkers[] = {1, pctx->nThreads, 1};
+
+  data->nOut = nJob;
+  TIMED(streamingPipeline(data->dest, data->src, nJob, sizeof(elem), pipelineStages, nStageWorkers,
+                          N_STAGES(pipelineStages)));
+}
+
+static double runGridStencilLine(regressData *data, size_t nJob, patternCtx *pctx) {
+  stencilGrid grid = lineGrid(nJob);
+
+  data->nOut = nJob;
+  TIMED(gridStencilCtx(data->dest, data->src, sizeof(elem), &grid, gridSum, REGRESS_STEPS, &grid, pctx));
+}
+
+static double runGridStencilPlane(regressData *data, size_t nJob, patternCtx *pctx) {
+  stencilGrid grid = planeGrid(nJob);
+
+  data->nOut = planeCells(nJob);
+  TIMED(gridStencilCtx(data->dest, data->src, sizeof(elem), &grid, gridSum, REGRESS_STEPS, &grid, pctx));
+}
+
+static double runSlidingStencil(regressData *data, size_t nJob, patternCtx *pctx) {
+  stencilGrid grid = slidingGrid(nJob);
+
+  data->nOut = planeCells(nJob);
+  TIMED(slidingStencilCtx(data->dest, data->src, sizeof(elem), &grid, workerAccumulate, workerSubtract, pctx));
+}
+
+static double runWavefrontGrid(regressData *data, size_t nJob, size_t width, size_t tileSize, int deps,
+                               patternCtx *pctx) {
+  regressWavefront w = {data->src, data->dest, width, deps};
+  size_t height = width > 0 ? nJob / width : 0;
+
+  data->nOut = height * width;
+  TIMED(wavefrontCtx(height, width, tileSize, deps, wavefrontCell, &w, pctx));
+}
+
+static double runWavefront(regressData *data, size_t nJob, patternCtx *pctx) {
+  return runWavefrontGrid(data, nJob, REGRESS_WIDTH, 0, WAVEFRONT_UP | WAVEFRONT_LEFT | WAVEFRONT_UP_LEFT, pctx);
+}
+
+static double runWindowedMap(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(windowedMapCtx(data->dest, data->src, nJob, sizeof(elem), workerInc, pctx));
+}
+
+static double runWindowedReduce(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = 1;
+  TIMED(windowedReduceCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runWindowedScan(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED(windowedScanCtx(data->dest, data->src, nJob, sizeof(elem), workerAdd, pctx));
+}
+
+static double runSampleSort(regressData *data, size_t nJob, patternCtx *pctx) {
+  memcpy(data->dest, data->src, nJob * sizeof(elem));
+
+  data->nOut = nJob;
+  TIMED(sampleSortCtx(data->dest, nJob, sizeof(elem), compareElems, pctx));
+}
+
+static double runRadixSortInt(regressData *data, size_t nJob, patternCtx *pctx) {
+  signedKeys(data, nJob);
+
+  double start = omp_get_wtime();
+  radixSortIntCtx(data->sortKeys, nJob, pctx);
+  double elapsed = omp_get_wtime() - start;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->dest[i] = (elem) data->sortKeys[i];
+
+  data->nOut = nJob;
+  return elapsed;
+}
+
+// The upper half of the spread values, every byte of the keys is random
+static double runRadixSortUint32(regressData *data, size_t nJob, patternCtx *pctx) {
+  uint32_t *keys = (uint32_t *) data->sortKeys;
+
+  for (size_t i = 0; i < nJob; i++)
+    keys[i] = (uint32_t) (data->src[i] * REGRESS_GOLDEN >> 32);
+
+  double start = omp_get_wtime();
+  radixSortUint32Ctx(keys, nJob, pctx);
+  double elapsed = omp_get_wtime() - start;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->dest[i] = keys[i];
+
+  data->nOut = nJob;
+  return elapsed;
+}
+
+static double runRadixSortUint64(regressData *data, size_t nJob, patternCtx *pctx) {
+  for (size_t i = 0; i < nJob; i++)
+    data->dest[i] = data->src[i] * REGRESS_GOLDEN;
+
+  data->nOut = nJob;
+  TIMED(radixSortUint64Ctx(data->dest, nJob, pctx));
+}
+
+static double runParallelSortInt(regressData *data, size_t nJob, patternCtx *pctx) {
+  signedKeys(data, nJob);
+
+  double start = omp_get_wtime();
+  parallelSortIntCtx(data->sortKeys, nJob, pctx);
+  double elapsed = omp_get_wtime() - start;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->dest[i] = (elem) data->sortKeys[i];
+
+  data->nOut = nJob;
+  return elapsed;
+}
+
+static double runSortPermutation(regressData *data, size_t nJob, patternCtx *pctx) {
+  double start = omp_get_wtime();
+  sortPermutationCtx(data->sortKeys, data->keys, nJob, pctx);
+  double elapsed = omp_get_wtime() - start;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->dest[i] = (elem) data->sortKeys[i];
+
+  data->nOut = nJob;
+  return elapsed;
+}
+
+// The objects are the source values, so they show where every key went
+static double runKeyIndexSort(regressData *data, size_t nJob, patternCtx *pctx) {
+  memcpy(data->sortKeys, data->keys, nJob * sizeof(int));
+  memcpy(data->dest, data->src, nJob * sizeof(elem));
+
+  data->nOut = nJob;
+  TIMED(keyIndexSortCtx(data->sortKeys, data->dest, sizeof(elem), nJob, pctx));
+}
+
+static double runKeyIndexSortInto(regressData *data, size_t nJob, patternCtx *pctx) {
+  memcpy(data->sortKeys, data->keys, nJob * sizeof(int));
+
+  data->nOut = nJob;
+  TIMED(keyIndexSortIntoCtx(data->sortKeys, data->dest, data->src, sizeof(elem), nJob, pctx));
+}
+
+/*
+ * The source values stay below 2^31, so none of the signed typed kernels overflows
+ * and every sum of a million of them is still exact as a double
+ */
+
+static double runMapOpInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, mapOpInt64((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD, 1));
+}
+
+static double runReduceOpInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = 1;
+  TIMED_TEAM(pctx, reduceOpInt64((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD));
+}
+
+static double runReduceMinInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = 1;
+  TIMED_TEAM(pctx, reduceOpInt64((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_MIN));
+}
+
+static double runScanOpInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, scanOpInt64((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD));
+}
+
+static double runExclusiveScanOpInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, exclusiveScanOpInt64((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD));
+}
+
+static double runStencilOpInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, stencilOpInt64((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD, REGRESS_SHIFT));
+}
+
+static double runStencilMinInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, stencilOpInt64((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_MIN, REGRESS_SHIFT));
+}
+
+// Blocks of the schedule chunk, so the forced runs combine many of them
+static double runCompensatedSum(regressData *data, size_t nJob, patternCtx *pctx) {
+  int previous = omp_get_max_threads();
+  double sum;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->reals[i] = (double) data->src[i];
+
+  omp_set_num_threads(pctx->nThreads);
+
+  double start = omp_get_wtime();
+  compensatedSumDouble(&sum, data->reals, nJob, pctx->chunkSize);
+  double elapsed = omp_get_wtime() - start;
+
+  omp_set_num_threads(previous);
+
+  data->dest[0] = (elem) sum;
+  data->nOut = 1;
+  return elapsed;
+}
+
+static double runMapOffloadInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, mapOffloadInt64Ctx((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD, 1, pctx));
+}
+
+static double runReduceOffloadInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = 1;
+  TIMED_TEAM(pctx, reduceOffloadInt64Ctx((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD, pctx));
+}
+
+static double runScanOffloadInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, scanOffloadInt64Ctx((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD, pctx));
+}
+
+static double runStencilOffloadInt64(regressData *data, size_t nJob, patternCtx *pctx) {
+  data->nOut = nJob;
+  TIMED_TEAM(pctx, stencilOffloadInt64Ctx((int64_t *) data->dest, (const int64_t *) data->src, nJob, OP_ADD,
+                                          REGRESS_SHIFT, pctx));
+}
+
+/*
+ *  REFERENCES
+*/
+
+static long clampIndex(long i, long n) {
+  return i < 0 ? 0 : i >= n ? n - 1 : i;
+}
+
+static size_t refMapInc(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = data->src[i] + 1;
+
+  return nJob;
+}
+
+static size_t refSum(regressData *data, size_t nJob) {
+  data->expected[0] = 0;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[0] += data->src[i];
+
+  return 1;
+}
+
+static size_t refSumDouble(regressData *data, size_t nJob) {
+  data->expected[0] = 0;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[0] += data->src[i] * 2;
+
+  return 1;
+}
+
+static size_t refPrefix(regressData *data, size_t nJob) {
+  elem sum = 0;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = sum += data->src[i];
+
+  return nJob;
+}
+
+static size_t refPrefixDouble(regressData *data, size_t nJob) {
+  elem sum = 0;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = sum += data->src[i] * 2;
+
+  return nJob;
+}
+
+// The exclusive scans leave the first element of dest untouched
+static size_t refExclusivePrefix(regressData *data, size_t nJob) {
+  elem sum = 0;
+
+  for (size_t i = 0; i < nJob; i++) {
+    data->expected[i] = i == 0 ? 0 : sum;
+    sum += data->src[i];
+  }
+
+  return nJob;
+}
+
+static size_t refSegmentedSum(regressData *data, size_t nJob) {
+  for (size_t k = 0; k < data->nSegments; k++) {
+    size_t end = k + 1 < data->nSegments ? data->offsets[k + 1] : nJob;
+
+    data->expected[k] = 0;
+
+    for (size_t i = data->offsets[k]; i < end; i++)
+      data->expected[k] += data->src[i];
+  }
+
+  return data->nSegments;
+}
+
+static size_t refSegmentedPrefix(regressData *data, size_t nJob) {
+  elem sum = 0;
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = sum = (i == 0 || data->flags[i]) ? data->src[i] : sum + data->src[i];
+
+  return nJob;
+}
+
+static size_t refPack(regressData *data, size_t nJob) {
+  size_t kept = 0;
+
+  for (size_t i = 0; i < nJob; i++)
+    if (data->mask[i])
+      data->expected[kept++] = data->src[i];
+
+  return kept;
+}
+
+static size_t refPackOdd(regressData *data, size_t nJob) {
+  size_t kept = 0;
+
+  for (size_t i = 0; i < nJob; i++)
+    if (data->src[i] & 1)
+      data->expected[kept++] = data->src[i];
+
+  return kept;
+}
+
+static size_t refGather(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = data->src[data->filter[i]];
+
+  return nJob;
+}
+
+static size_t refGatherInc(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = data->src[data->filter[i]] + 1;
+
+  return nJob;
+}
+
+// Positions no element is sent to keep the zero dest starts with, the highest source index wins
+static size_t refScatter(regressData *data, size_t nJob) {
+  memset(data->expected, 0, nJob * sizeof(elem));
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[data->filter[i]] = data->src[i];
+
+  return nJob;
+}
+
+static size_t refPipeline(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = (data->src[i] + 1) * 2 + 1;
+
+  return nJob;
+}
+
+static size_t refPipelineBatch(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = data->src[i] + N_STAGES(batchStages);
+
+  return nJob;
+}
+
+// Sum of the window around every element, clipped at both ends
+static size_t refStencil(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++) {
+    size_t first = i > REGRESS_SHIFT ? i - REGRESS_SHIFT : 0;
+
+    data->expected[i] = 0;
+
+    for (size_t j = first; j <= i + REGRESS_SHIFT && j < nJob; j++)
+      data->expected[i] += data->src[j];
+  }
+
+  return nJob;
+}
+
+// Row by row, the top row reads the first width elements and the left column the rest
+static size_t refHyperplane(regressData *data, size_t nJob) {
+  size_t height = nJob / 2;
+  size_t width = nJob / 2 + nJob % 2;
+  elem *m = malloc(height * width * sizeof(elem));
+  const elem *s = data->src;
+
+  for (size_t v = 0; v < height; v++) {
+    for (size_t h = 0; h < width; h++) {
+      elem up = v == 0 ? s[h] : m[(v - 1) * width + h];
+      elem left = h == 0 ? s[v + width] : m[v * width + h - 1];
+
+      m[v * width + h] = up + left;
+    }
+  }
+
+  for (size_t h = 0; h < width; h++)
+    data->expected[h] = m[(height - 1) * width + h];
+
+  for (size_t v = 0; v < height; v++)
+    data->expected[v + width] = m[v * width + width - 1];
+
+  free(m);
+
+  return nJob;
+}
+
+static size_t refSort(regressData *data, size_t nJob) {
+  memcpy(data->sortKeys, data->keys, nJob * sizeof(int));
+  qsort(data->sortKeys, nJob, sizeof(int), compareKeys);
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = data->sortKeys[i];
+
+  return nJob;
+}
+
+static size_t refSortPayload(regressData *data, size_t nJob) {
+  refSort(data, nJob);
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] *= 3;
+
+  return nJob;
+}
+
+static size_t refMin(regressData *data, size_t nJob) {
+  data->expected[0] = INT64_MAX;
+
+  for (size_t i = 0; i < nJob; i++)
+    if (data->src[i] < data->expected[0])
+      data->expected[0] = data->src[i];
+
+  return 1;
+}
+
+static size_t refStencilMin(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++) {
+    size_t first = i > REGRESS_SHIFT ? i - REGRESS_SHIFT : 0;
+
+    data->expected[i] = data->src[first];
+
+    for (size_t j = first; j <= i + REGRESS_SHIFT && j < nJob; j++)
+      if (data->src[j] < data->expected[i])
+        data->expected[i] = data->src[j];
+  }
+
+  return nJob;
+}
+
+// Time steps of gridSum on a 2D grid, cells outside it are clamped or zero
+static size_t refGrid(regressData *data, const stencilGrid *grid) {
+  long width = grid->dims[0];
+  long height = grid->dims[1];
+  size_t cells = width * height;
+  elem *cur = malloc(cells * sizeof(elem));
+  elem *next = data->expected;
+
+  memcpy(cur, data->src, cells * sizeof(elem));
+
+  for (int step = 0; step < REGRESS_STEPS; step++) {
+    for (long y = 0; y < height; y++) {
+      for (long x = 0; x < width; x++) {
+        elem sum = 0;
+
+        for (long ny = y - grid->radius[1]; ny <= y + grid->radius[1]; ny++) {
+          for (long nx = x - grid->radius[0]; nx <= x + grid->radius[0]; nx++) {
+            int outside = nx < 0 || nx >= width || ny < 0 || ny >= height;
+
+            if (!outside)
+              sum += cur[ny * width + nx];
+            else if (grid->boundary == STENCIL_CLAMP)
+              sum += cur[clampIndex(ny, height) * width + clampIndex(nx, width)];
+          }
+        }
+
+        next[y * width + x] = sum;
+      }
+    }
+
+    memcpy(cur, next, cells * sizeof(elem));
+  }
+
+  free(cur);
+
+  return cells;
+}
+
+static size_t refGridStencilLine(regressData *data, size_t nJob) {
+  stencilGrid grid = lineGrid(nJob);
+
+  return refGrid(data, &grid);
+}
+
+static size_t refGridStencilPlane(regressData *data, size_t nJob) {
+  stencilGrid grid = planeGrid(nJob);
+
+  return refGrid(data, &grid);
+}
+
+// Sum of the box around every cell, clipped at the edges of the grid
+static size_t refSlidingStencil(regressData *data, size_t nJob) {
+  stencilGrid grid = slidingGrid(nJob);
+  long width = grid.dims[0];
+  long height = grid.dims[1];
+
+  for (long y = 0; y < height; y++) {
+    for (long x = 0; x < width; x++) {
+      elem sum = 0;
+
+      for (long ny = y - grid.radius[1]; ny <= y + grid.radius[1]; ny++)
+        for (long nx = x - grid.radius[0]; nx <= x + grid.radius[0]; nx++)
+          if (nx >= 0 && nx < width && ny >= 0 && ny < height)
+            sum += data->src[ny * width + nx];
+
+      data->expected[y * width + x] = sum;
+    }
+  }
+
+  return planeCells(nJob);
+}
+
+// The same cell function in row major order, writing expected instead of dest
+static size_t refWavefrontGrid(regressData *data, size_t nJob, size_t width, int deps) {
+  regressWavefront w = {data->src, data->expected, width, deps};
+  size_t height = width > 0 ? nJob / width : 0;
+
+  memset(data->expected, 0, height * width * sizeof(elem));
+
+  for (size_t row = 0; row < height; row++)
+    for (size_t col = 0; col < width; col++)
+      wavefrontCell(row, col, &w);
+
+  return height * width;
+}
+
+static size_t refWavefront(regressData *data, size_t nJob) {
+  return refWavefrontGrid(data, nJob, REGRESS_WIDTH, WAVEFRONT_UP | WAVEFRONT_LEFT | WAVEFRONT_UP_LEFT);
+}
+
+/*
+ * Wavefronts of the other dependency shapes on tall and wide grids, in small tiles,
+ * so every tile edge a shape implies is crossed by many cells
+ */
+#define DEFINE_WAVEFRONT_CASE(NAME, WIDTH, DEPS)                              \
+static double run##NAME(regressData *data, size_t nJob, patternCtx *pctx) {   \
+  return runWavefrontGrid(data, nJob, WIDTH, REGRESS_TILE, DEPS, pctx);       \
+}                                                                             \
+                                                                              \
+static size_t ref##NAME(regressData *data, size_t nJob) {                     \
+  return refWavefrontGrid(data, nJob, WIDTH, DEPS);                           \
+}
+
+DEFINE_WAVEFRONT_CASE(WavefrontUpTall, REGRESS_WIDTH, WAVEFRONT_UP)
+DEFINE_WAVEFRONT_CASE(WavefrontUpWide, nJob / REGRESS_ROWS, WAVEFRONT_UP)
+DEFINE_WAVEFRONT_CASE(WavefrontLeftTall, REGRESS_WIDTH, WAVEFRONT_LEFT)
+DEFINE_WAVEFRONT_CASE(WavefrontLeftWide, nJob / REGRESS_ROWS, WAVEFRONT_LEFT)
+DEFINE_WAVEFRONT_CASE(WavefrontUpLeftTall, REGRESS_WIDTH, WAVEFRONT_UP_LEFT)
+DEFINE_WAVEFRONT_CASE(WavefrontUpLeftWide, nJob / REGRESS_ROWS, WAVEFRONT_UP_LEFT)
+DEFINE_WAVEFRONT_CASE(WavefrontUpAndUpLeftTall, REGRESS_WIDTH, WAVEFRONT_UP | WAVEFRONT_UP_LEFT)
+DEFINE_WAVEFRONT_CASE(WavefrontUpAndUpLeftWide, nJob / REGRESS_ROWS, WAVEFRONT_UP | WAVEFRONT_UP_LEFT)
+
+static size_t refSortElems(regressData *data, size_t nJob) {
+  memcpy(data->expected, data->src, nJob * sizeof(elem));
+  qsort(data->expected, nJob, sizeof(elem), compareElems);
+
+  return nJob;
+}
+
+static size_t refSortSigned(regressData *data, size_t nJob) {
+  signedKeys(data, nJob);
+  qsort(data->sortKeys, nJob, sizeof(int), compareKeys);
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = (elem) data->sortKeys[i];
+
+  return nJob;
+}
+
+static size_t refSortUint32(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = (uint32_t) (data->src[i] * REGRESS_GOLDEN >> 32);
+
+  qsort(data->expected, nJob, sizeof(elem), compareElems);
+
+  return nJob;
+}
+
+static size_t refSortUint64(regressData *data, size_t nJob) {
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = data->src[i] * REGRESS_GOLDEN;
+
+  qsort(data->expected, nJob, sizeof(elem), compareElems);
+
+  return nJob;
+}
+
+static size_t refSortPermutation(regressData *data, size_t nJob) {
+  keyPositions(data, nJob);
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] &= UINT32_MAX;
+
+  return nJob;
+}
+
+static size_t refKeyIndexSort(regressData *data, size_t nJob) {
+  keyPositions(data, nJob);
+
+  for (size_t i = 0; i < nJob; i++)
+    data->expected[i] = data->src[data->expected[i] & UINT32_MAX];
+
+  return nJob;
+}
+
+static const regressCase cases[] = {
+    {"map", 0, 0, 2, runMap, refMapInc},
+    {"reduce", 0, 0, 1, runReduce, refSum},
+    {"mapReduce", 0, 0, 1, runMapReduce, refSumDouble},
+    {"deterministicReduce", 0, 0, 1, runDeterministicReduce, refSum},
+    {"scan", 0, 0, 2, runScan, refPrefix},
+    {"transformScan", 0, 0, 2, runTransformScan, refPrefixDouble},
+    {"exclusiveScan", 0, 0, 2, runExclusiveScan, refExclusivePrefix},
+    {"lookbackScan", 0, 0, 2, runLookbackScan, refPrefix},
+    {"exclusiveLookbackScan", 0, 0, 2, runExclusiveLookbackScan, refExclusivePrefix},
+    {"segmentedReduce", 0, 0, 1, runSegmentedReduce, refSegmentedSum},
+    {"segmentedScan", 0, 0, 2, runSegmentedScan, refSegmentedPrefix},
+    {"pack", 0, 0, 2, runPack, refPack},
+    {"packIf", 0, 0, 2, runPackIf, refPackOdd},
+    {"gather", 0, 0, 2, runGather, refGather},
+    {"scatter", 0, 0, 2, runScatter, refScatter},
+    {"priorityScatter", 0, 0, 2, runPriorityScatter, refScatter},
+    {"pipeline", 0, 0, 2, runPipeline, refPipeline},
+    {"itemBoundPipeline", 0, 0, 2, runItemBoundPipeline, refPipeline},
+    {"fusedPipeline", 0, 0, 2, runFusedPipeline, refPipeline},
+    {"serialPipeline", 0, 0, 2, runSerialPipeline, refPipeline},
+    {"farm", 0, 0, 2, runFarm, refMapInc},
+    {"stencil", 0, 0, 2, runStencil, refStencil},
+    {"parallelPrefix", 0, 0, 2, runParallelPrefix, refPrefix},
+    // nJob / 2 rows of nJob / 2 cells, so the timed runs stay at a few million cells
+    {"hyperplane", 2, 4096, 2, runHyperplane, refHyperplane},
+    {"quickSort", 1, 0, 2, runQuickSort, refSort},
+    {"quickSort2", 1, 0, 2, runQuickSort2, refSortPayload},
+    {"mapBatch", 0, 0, 2, runMapBatch, refMapInc},
+    {"gatherBatch", 0, 0, 2, runGatherBatch, refGatherInc},
+    {"itemBoundPipelineBatch", 0, 0, 2, runItemBoundPipelineBatch, refPipelineBatch},
+    {"farmBatch", 0, 0, 2, runFarmBatch, refMapInc},
+    {"streamingPipeline", 0, 0, 2, runStreamingPipeline, refPipeline},
+    {"gridStencilLine", 1, 0, 2, runGridStencilLine, refGridStencilLine},
+    {"gridStencilPlane", REGRESS_WIDTH, 0, 2, runGridStencilPlane, refGridStencilPlane},
+    {"slidingStencil", REGRESS_WIDTH, 0, 2, runSlidingStencil, refSlidingStencil},
+    {"wavefront", 0, 0, 2, runWavefront, refWavefront},
+    {"wavefrontUpTall", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontUpTall, refWavefrontUpTall},
+    {"wavefrontUpWide", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontUpWide, refWavefrontUpWide},
+    {"wavefrontLeftTall", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontLeftTall, refWavefrontLeftTall},
+    {"wavefrontLeftWide", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontLeftWide, refWavefrontLeftWide},
+    {"wavefrontUpLeftTall", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontUpLeftTall, refWavefrontUpLeftTall},
+    {"wavefrontUpLeftWide", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontUpLeftWide, refWavefrontUpLeftWide},
+    {"wavefrontUpAndUpLeftTall", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontUpAndUpLeftTall,
+     refWavefrontUpAndUpLeftTall},
+    {"wavefrontUpAndUpLeftWide", 0, REGRESS_WAVEFRONT_JOBS, 2, runWavefrontUpAndUpLeftWide,
+     refWavefrontUpAndUpLeftWide},
+    {"windowedMap", 0, 0, 2, runWindowedMap, refMapInc},
+    {"windowedReduce", 0, 0, 1, runWindowedReduce, refSum},
+    {"windowedScan", 0, 0, 2, runWindowedScan, refPrefix},
+    {"sampleSort", 0, 0, 2, runSampleSort, refSortElems},
+    {"radixSortInt", 0, 0, 2, runRadixSortInt, refSortSigned},
+    {"radixSortUint32", 0, 0, 2, runRadixSortUint32, refSortUint32},
+    {"radixSortUint64", 0, 0, 2, runRadixSortUint64, refSortUint64},
+    {"parallelSortInt", 0, 0, 2, runParallelSortInt, refSortSigned},
+    {"sortPermutation", 0, 0, 2, runSortPermutation, refSortPermutation},
+    {"keyIndexSort", 0, 0, 2, runKeyIndexSort, refKeyIndexSort},
+    {"keyIndexSortInto", 0, 0, 2, runKeyIndexSortInto, refKeyIndexSort},
+    {"mapOpInt64", 0, 0, 2, runMapOpInt64, refMapInc},
+    {"reduceOpInt64", 0, 0, 1, runReduceOpInt64, refSum},
+    {"reduceMinInt64", 0, 0, 1, runReduceMinInt64, refMin},
+    {"scanOpInt64", 0, 0, 2, runScanOpInt64, refPrefix},
+    {"exclusiveScanOpInt64", 0, 0, 2, runExclusiveScanOpInt64, refExclusivePrefix},
+    {"stencilOpInt64", 0, 0, 2, runStencilOpInt64, refStencil},
+    {"stencilMinInt64", 0, 0, 2, runStencilMinInt64, refStencilMin},
+    {"compensatedSumDouble", 0, 0, 1, runCompensatedSum, refSum},
+    {"mapOffloadInt64", 0, 0, 2, runMapOffloadInt64, refMapInc},
+    {"reduceOffloadInt64", 0, 0, 1, runReduceOffloadInt64, refSum},
+    {"scanOffloadInt64", 0, 0, 2, runScanOffloadInt64, refPrefix},
+    {"stencilOffloadInt64", 0, 0, 2, runStencilOffloadInt64, refStencil}
+};
+
+#define N_CASES (sizeof(cases) / sizeof(cases[0]))
+
+/*
+ *  INPUTS
+*/
+
+static void *regressAlloc(size_t n, size_t size) {
+  // One more element so no buffer is empty
+  void *p = malloc((n + 1) * size);
+
+  if (p == NULL) {
+    fprintf(stderr, "Could not allocate %zu elements for the regression suite\n", n);
+    exit(1);
+  }
+
+  return p;
+}
+
+static void regressAllocData(regressData *data, size_t capacity) {
+  data->src = regressAlloc(capacity, sizeof(elem));
+  data->dest = regressAlloc(capacity, sizeof(elem));
+  data->expected = regressAlloc(capacity, sizeof(elem));
+  data->filter = regressAlloc(capacity, sizeof(int));
+  data->mask = regressAlloc(capacity, sizeof(int));
+  data->flags = regressAlloc(capacity, sizeof(int));
+  data->offsets = regressAlloc(2 * capacity, sizeof(size_t));
+  data->keys = regressAlloc(capacity, sizeof(int));
+  data->sortKeys = regressAlloc(capacity, sizeof(int));
+  data->reals = regressAlloc(capacity, sizeof(double));
+}
+
+static void regressFreeData(regressData *data) {
+  free(data->src);
+  free(data->dest);
+  free(data->expected);
+  free(data->filter);
+  free(data->mask);
+  free(data->flags);
+  free(data->offsets);
+  free(data->keys);
+  free(data->sortKeys);
+  free(data->reals);
+}
+
+static void regressFill(regressData *data, size_t nJob, unsigned int *seed) {
+  data->nJob = nJob;
+  data->nSegments = 0;
+
+  for (size_t i = 0; i < nJob; i++) {
+    data->src[i] = (elem) rand_r(seed);
+    data->filter[i] = (int) ((size_t) rand_r(seed) % nJob);
+    data->mask[i] = rand_r(seed) % 2;
+    data->keys[i] = (int) ((size_t) rand_r(seed) % (nJob / 2 + 1));
+
+    // Around one head every 8 elements, and an empty segment before one head in 4
+    data->flags[i] = i == 0 || rand_r(seed) % 8 == 0;
+
+    if (data->flags[i]) {
+      if (i > 0 && rand_r(seed) % 4 == 0)
+        data->offsets[data->nSegments++] = i;
+
+      data->offsets[data->nSegments++] = i;
+    }
+  }
+}
+
+/*
+ *  SUITE
+*/
+
+// Runs a pattern and its reference on the first nJob elements, 1 when they agree
+static int regressCheck(const regressCase *c, regressData *data, size_t nJob, patternCtx *pctx, double *seconds) {
+  // Patterns that leave positions untouched find zeros there, as the references expect
+  memset(data->dest, 0, (data->nJob + 1) * sizeof(elem));
+
+  double elapsed = c->run(data, nJob, pctx);
+  size_t nExpected = c->reference(data, nJob);
+
+  if (seconds != NULL)
+    *seconds = elapsed;
+
+  return data->nOut == nExpected && memcmp(data->dest, data->expected, nExpected * sizeof(elem)) == 0;
+}
+
+static size_t regressSize(const regressCase *c, size_t nJob) {
+  return c->maxJob > 0 && nJob > c->maxJob ? c->maxJob : nJob;
+}
+
+static regressBaseline *regressLoad(const char *path, size_t *nEntries) {
+  FILE *file = fopen(path, "r");
+
+  *nEntries = 0;
+
+  if (file == NULL)
+    return NULL;
+
+  regressBaseline *entries = malloc(N_CASES * sizeof(regressBaseline));
+  char line[REGRESS_LINE];
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    regressBaseline entry;
+
+    // Blank lines and comments
+    if (line[strspn(line, " \t\r\n")] == 0 || line[strspn(line, " \t")] == '#')
+      continue;
+
+    if (sscanf(line, "%31s %zu %d %lf", entry.name, &entry.nJob, &entry.nThreads, &entry.elementsPerSecond) != 4
+        || entry.elementsPerSecond <= 0) {
+      fprintf(stderr, "%s: invalid baseline line: %s", path, line);
+      exit(1);
+    }
+
+    // Later lines of the same pattern replace the earlier one
+    size_t i = 0;
+
+    while (i < *nEntries && strcmp(entries[i].name, entry.name) != 0)
+      i++;
+
+    if (i == N_CASES)
+      continue;
+
+    entries[i] = entry;
+
+    if (i == *nEntries)
+      (*nEntries)++;
+  }
+
+  fclose(file);
+
+  return entries;
+}
+
+static void regressSave(const char *path, const regressBaseline *entries, size_t nEntries) {
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+
+  fprintf(file, "# pattern nJob nThreads elementsPerSecond\n");
+
+  for (size_t i = 0; i < nEntries; i++)
+    fprintf(file, "%s %zu %d %.0f\n", entries[i].name, entries[i].nJob, entries[i].nThreads, entries[i].elementsPerSecond);
+
+  if (fclose(file) != 0) {
+    perror(path);
+    exit(1);
+  }
+}
+
+// The baseline of the pattern when it was taken at the same size and team, NULL otherwise
+static const regressBaseline *regressFind(const regressBaseline *entries, size_t nEntries, const char *name,
+                                          size_t nJob, int nThreads) {
+  for (size_t i = 0; i < nEntries; i++)
+    if (strcmp(entries[i].name, name) == 0 && entries[i].nJob == nJob && entries[i].nThreads == nThreads)
+      return &entries[i];
+
+  return NULL;
+}
+
+int regressRun(const regressConfig *config) {
+  assert (config != NULL);
+  assert (config->nJob > 0);
+  assert (config->repetitions > 0);
+  assert (config->warmup >= 0);
+  assert (config->nThreads > 0);
+  assert (config->tolerance >= 0 && config->tolerance < 1);
+  assert (!config->record || config->baseline != NULL);
+
+  unsigned int seed = REGRESS_SEED;
+  size_t nEdges = sizeof(edgeSizes) / sizeof(edgeSizes[0]);
+  size_t sizes[sizeof(edgeSizes) / sizeof(edgeSizes[0]) + REGRESS_RANDOM_SIZES];
+  size_t nSizes = 0;
+  size_t capacity = config->nJob;
+
+  for (size_t i = 0; i < nEdges; i++)
+    sizes[nSizes++] = edgeSizes[i];
+
+  // Odd in most cases, and never larger than the timed size
+  size_t maxRandom = config->nJob < REGRESS_MAX_RANDOM ? config->nJob : REGRESS_MAX_RANDOM;
+
+  for (int i = 0; i < REGRESS_RANDOM_SIZES; i++)
+    sizes[nSizes++] = 1 + (size_t) rand_r(&seed) % maxRandom;
+
+  for (size_t i = 0; i < nSizes; i++)
+    if (sizes[i] > capacity)
+      capacity = sizes[i];
+
+  regressData data;
+  regressAllocData(&data, capacity);
+
+  /*
+   * Three teams per size: one thread runs every serial path, the dispatched team is
+   * what the timed runs get, and the forced team splits even two elements across
+   * threads in small dynamic chunks, so the parallel paths see their corner cases too.
+   * Its cache blocks and windows are tiny and its offload kernels run their target
+   * regions on the host whatever the size
+  */
+
+  int teamThreads = config->nThreads > REGRESS_TEAM ? config->nThreads : REGRESS_TEAM;
+
+  patternCtx *ctx[3] = {
+      patternCtxCreate(1, SCHEDULE_STATIC, 0),
+      patternCtxCreate(config->nThreads, SCHEDULE_STATIC, 0),
+      patternCtxCreate(teamThreads, SCHEDULE_DYNAMIC, REGRESS_CHUNK)
+  };
+  const char *ctxNames[3] = {"serial", "dispatched", "forced team"};
+
+  // 0 would pick the default threshold, one byte of work is already enough for a team
+  ctx[2]->serialBytes = 1;
+  ctx[2]->blockBytes = REGRESS_BLOCK * sizeof(elem);
+  ctx[2]->windowBytes = REGRESS_WINDOW * sizeof(elem);
+  ctx[2]->offloadDevice = omp_get_initial_device();
+  ctx[2]->offloadMinJobs = 1;
+
+  int wrong[N_CASES] = {0};
+
+  for (size_t i = 0; i < nSizes; i++) {
+    regressFill(&data, sizes[i], &seed);
+
+    for (size_t c = 0; c < N_CASES; c++) {
+      if (sizes[i] < cases[c].minJob || regressSize(&cases[c], sizes[i]) != sizes[i])
+        continue;
+
+      for (int k = 0; k < 3; k++) {
+        if (!regressCheck(&cases[c], &data, sizes[i], ctx[k], NULL)) {
+          fprintf(stderr, "%s: differs from the reference with %zu elements on the %s\n", cases[c].name, sizes[i],
+                  ctxNames[k]);
+          wrong[c] = 1;
+        }
+      }
+    }
+  }
+
+  // Timed runs, each one is checked as well
+  size_t nEntries = 0;
+  regressBaseline *baseline = config->baseline != NULL ? regressLoad(config->baseline, &nEntries) : NULL;
+  regressBaseline measured[N_CASES];
+  int record = config->record;
+  int nWrong = 0;
+  int nSlower = 0;
+
+  if (config->baseline != NULL && baseline == NULL && !record) {
+    fprintf(stderr, "%s: no baseline yet, recording this run\n", config->baseline);
+    record = 1;
+  }
+
+  regressFill(&data, config->nJob, &seed);
+
+  fprintf(config->out, "pattern,size,threads,seconds,gb_per_s,elements_per_s,baseline,status\n");
+
+  for (size_t c = 0; c < N_CASES; c++) {
+    size_t nJob = regressSize(&cases[c], config->nJob);
+    double best = 0;
+
+    for (int r = 0; r < config->warmup + config->repetitions; r++) {
+      double seconds;
+
+      if (!regressCheck(&cases[c], &data, nJob, ctx[1], &seconds) && !wrong[c]) {
+        fprintf(stderr, "%s: differs from the reference with %zu elements on the dispatched team\n", cases[c].name,
+                nJob);
+        wrong[c] = 1;
+      }
+
+      if (r == config->warmup || (r > config->warmup && seconds < best))
+        best = seconds;
+    }
+
+    // A run too short for the clock counts as one tick
+    if (best <= 0)
+      best = omp_get_wtick();
+
+    double elementsPerSecond = nJob / best;
+    double bytesPerSecond = elementsPerSecond * sizeof(elem) * cases[c].traffic;
+
+    const regressBaseline *reference = regressFind(baseline, nEntries, cases[c].name, nJob, config->nThreads);
+    const char *status = "ok";
+
+    if (wrong[c]) {
+      status = "wrong";
+      nWrong++;
+    } else if (record)
+      status = "recorded";
+    else if (reference == NULL)
+      status = "new";
+    else if (elementsPerSecond < reference->elementsPerSecond * (1 - config->tolerance)) {
+      status = "slower";
+      nSlower++;
+    }
+
+    fprintf(config->out, "%s,%zu,%d,%.9f,%.3f,%.0f,%.0f,%s\n", cases[c].name, nJob, config->nThreads, best,
+            bytesPerSecond / 1e9, elementsPerSecond, reference != NULL ? reference->elementsPerSecond : 0, status);
+
+    snprintf(measured[c].name, REGRESS_NAME, "%s", cases[c].name);
+    measured[c].nJob = nJob;
+    measured[c].nThreads = config->nThreads;
+    measured[c].elementsPerSecond = elementsPerSecond;
+  }
+
+  // A baseline of wrong results would hide the next regression
+  if (record && nWrong == 0)
+    regressSave(config->baseline, measured, N_CASES);
+
+  if (nWrong > 0 || nSlower > 0)
+    fprintf(stderr, "%d patterns differ from their reference, %d are more than %.0f%% slower than the baseline\n",
+            nWrong, nSlower, config->tolerance * 100);
+
+  for (int k = 0; k < 3; k++)
+    patternCtxDestroy(ctx[k]);
+
+  free(baseline);
+  regressFreeData(&data);
+
+  return nWrong > 0 || nSlower > 0;
+}
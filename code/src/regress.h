@@ -0,0 +1,35 @@
+#ifndef __REGRESS_H
+#define __REGRESS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Regression suite - every pattern runs on exact integer elements and is compared with
+ * a plain serial loop of what it computes. Besides the patterns of patterns.h it covers
+ * the sorts, the grid and sliding stencils, the streaming pipeline, the out-of-core
+ * patterns, the typed, offload and compensated kernels and the wavefront. The sizes
+ * are the corner cases, a few random ones and the timed size, each on a single thread,
+ * on the dispatched team and on a team forced to split even the smallest inputs. The
+ * timed runs give the throughput, which is checked against a baseline recorded on the
+ * same machine.
+ */
+
+// # elements of the timed runs when no size is given
+#define REGRESS_JOBS (1 << 20)
+
+typedef struct regressConfig {
+    size_t nJob;                // # elements of the timed runs
+    int warmup;                 // Untimed runs before the repetitions
+    int repetitions;            // Timed runs of every pattern, the fastest one counts
+    int nThreads;               // # threads of the timed runs
+    const char *baseline;       // Baseline file, NULL only checks the results
+    int record;                 // Write the throughput to the baseline instead of comparing with it
+    double tolerance;           // Fraction of the baseline throughput a pattern may lose
+    FILE *out;                  // Target stream of the results
+} regressConfig;
+
+// Writes one CSV record per pattern, 0 when every pattern matched its reference and none regressed
+int regressRun(const regressConfig *config);
+
+#endif
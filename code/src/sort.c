@@ -0,0 +1,387 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <assert.h>
+#include <omp.h>
+#include "patterns.h"
+#include "sort.h"
+
+// Below this many elements the parallel sorts fall back to the serial paths
+#define SORT_SERIAL_TRESHOLD (64 * 1024)
+
+// Bits sorted in each radix sort pass
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+// Buckets of the sample sort per thread, more buckets even out skewed keys
+#define SAMPLE_BUCKETS_PER_THREAD 4
+
+// Samples taken for each bucket splitter
+#define SAMPLE_OVERSAMPLING 32
+
+/*
+ *  UTILS
+*/
+static void workerAddSize(void *a, const void *b, const void *c) {
+  *(size_t *) a = *(const size_t *) b + *(const size_t *) c;
+}
+
+// First element of a tile when nJob elements are split evenly over nTiles
+static size_t sortTileStart(size_t nJob, int nTiles, int tile) {
+  return nJob / nTiles * tile + (nJob % nTiles) * tile / nTiles;
+}
+
+static int sortTileCount(size_t nJob, const patternCtx *pctx) {
+  return nJob < (size_t) pctx->nThreads ? (int) nJob : pctx->nThreads;
+}
+
+/*
+ * Sample sort, based on McCool book - Structured Parallel Programming - Chapter 13.
+ * A sorted sample gives the bucket splitters, the elements are moved to their bucket
+ * with per tile histograms just like the radix sort and every bucket is sorted on its own.
+*/
+static int sampleBucket(const void *element, const char *samples, size_t sizeJob, int nBuckets, sortCompare compare) {
+  // Splitter b is the last sample of bucket b, equal keys always land in the same bucket
+  int lo = 0;
+  int hi = nBuckets - 1;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+
+    if (compare(&samples[((mid + 1) * SAMPLE_OVERSAMPLING - 1) * sizeJob], element) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+void sampleSortCtx(void *arr, size_t nJob, size_t sizeJob, sortCompare compare, patternCtx *pctx) {
+  assert(arr != NULL);
+  assert(sizeJob > 0);
+  assert(compare != NULL);
+
+  if (nJob < SORT_SERIAL_TRESHOLD || pctx->nThreads == 1) {
+    qsort(arr, nJob, sizeJob, compare);
+    return;
+  }
+
+  char *a = arr;
+
+  int nTiles = sortTileCount(nJob, pctx);
+  int nBuckets = pctx->nThreads * SAMPLE_BUCKETS_PER_THREAD;
+  size_t nSamples = (size_t) nBuckets * SAMPLE_OVERSAMPLING;
+  size_t nCounts = (size_t) nBuckets * nTiles;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *samples = arenaAlloc(arena, nSamples * sizeJob);
+  char *buffer = arenaAlloc(arena, nJob * sizeJob);
+  int *bucketOf = arenaAlloc(arena, nJob * sizeof(int));
+  size_t *counts = arenaCalloc(arena, nCounts, sizeof(size_t));
+  size_t *offsets = arenaCalloc(arena, nCounts, sizeof(size_t));
+  size_t *bucketStart = arenaAlloc(arena, (nBuckets + 1) * sizeof(size_t));
+
+  // Evenly strided sample, so already sorted input still gives balanced buckets
+  for (size_t i = 0; i < nSamples; i++)
+    memcpy(&samples[i * sizeJob], &a[(i * (nJob / nSamples)) * sizeJob], sizeJob);
+
+  qsort(samples, nSamples, sizeJob, compare);
+
+  // Histogram of every tile, laid out bucket major so the scan gives the offsets
+  #pragma omp parallel for default(none) shared(a, nJob, sizeJob, compare, samples, bucketOf, counts, nTiles, nBuckets) \
+  schedule(static) num_threads(pctx->nThreads)
+  for (int tile = 0; tile < nTiles; tile++) {
+    size_t last = sortTileStart(nJob, nTiles, tile + 1);
+
+    for (size_t i = sortTileStart(nJob, nTiles, tile); i < last; i++) {
+      int bucket = sampleBucket(&a[i * sizeJob], samples, sizeJob, nBuckets, compare);
+
+      bucketOf[i] = bucket;
+      counts[bucket * nTiles + tile]++;
+    }
+  }
+
+  exclusiveScanCtx(offsets, counts, nCounts, sizeof(size_t), workerAddSize, pctx);
+
+  for (int bucket = 0; bucket < nBuckets; bucket++)
+    bucketStart[bucket] = offsets[bucket * nTiles];
+
+  bucketStart[nBuckets] = nJob;
+
+  #pragma omp parallel default(none) \
+  shared(a, nJob, sizeJob, compare, buffer, bucketOf, offsets, bucketStart, nTiles, nBuckets) \
+  num_threads(pctx->nThreads)
+  {
+    // Move every element to its bucket, tiles keep their relative order
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      size_t last = sortTileStart(nJob, nTiles, tile + 1);
+
+      for (size_t i = sortTileStart(nJob, nTiles, tile); i < last; i++)
+        memcpy(&buffer[offsets[bucketOf[i] * nTiles + tile]++ * sizeJob], &a[i * sizeJob], sizeJob);
+    }
+
+    // Buckets differ in size, hand them out one at a time
+    #pragma omp for schedule(dynamic, 1)
+    for (int bucket = 0; bucket < nBuckets; bucket++)
+      qsort(&buffer[bucketStart[bucket] * sizeJob], bucketStart[bucket + 1] - bucketStart[bucket], sizeJob, compare);
+
+    #pragma omp for schedule(static)
+    for (int tile = 0; tile < nTiles; tile++) {
+      size_t first = sortTileStart(nJob, nTiles, tile);
+      size_t last = sortTileStart(nJob, nTiles, tile + 1);
+
+      memcpy(&a[first * sizeJob], &buffer[first * sizeJob], (last - first) * sizeJob);
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void sampleSort(void *arr, size_t nJob, size_t sizeJob, sortCompare compare) {
+  sampleSortCtx(arr, nJob, sizeJob, compare, patternCtxDefault());
+}
+
+/*
+ * LSD radix sort - every pass counts the digits of each tile, scans the counts into
+ * the first position of every (digit, tile) pair and moves the keys stably.
+ * Keys are 32 or 64 bits wide, signBit is flipped so signed keys sort as unsigned ones.
+*/
+static inline size_t radixDigit(const void *keys, size_t i, int wide, uint64_t signBit, int shift) {
+  uint64_t key = wide ? ((const uint64_t *) keys)[i] : ((const uint32_t *) keys)[i];
+
+  return ((key ^ signBit) >> shift) & (RADIX_BUCKETS - 1);
+}
+
+// Passes start at firstShift, the bits below it keep the order the keys come in
+static void radixSortImpl(void *arr, size_t arrSize, int wide, uint64_t signBit, int firstShift, patternCtx *pctx) {
+  assert(arr != NULL);
+
+  if (arrSize < 2)
+    return;
+
+  size_t sizeKey = wide ? sizeof(uint64_t) : sizeof(uint32_t);
+
+  // Small arrays make every pass on the calling thread, a single tile with no team to start
+  int serial = arrSize < SORT_SERIAL_TRESHOLD || pctx->nThreads == 1;
+  int nTiles = serial ? 1 : sortTileCount(arrSize, pctx);
+  size_t nCounts = (size_t) RADIX_BUCKETS * nTiles;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  char *buffer = arenaAlloc(arena, arrSize * sizeKey);
+  size_t *counts = arenaAlloc(arena, nCounts * sizeof(size_t));
+  size_t *offsets = arenaCalloc(arena, nCounts, sizeof(size_t));
+
+  char *from = arr;
+  char *to = buffer;
+
+  for (int shift = firstShift; shift < (int) (8 * sizeKey); shift += RADIX_BITS) {
+    #pragma omp parallel for default(none) shared(from, arrSize, wide, signBit, shift, counts, nTiles) \
+    schedule(static) num_threads(pctx->nThreads) if (!serial)
+    for (int tile = 0; tile < nTiles; tile++) {
+      size_t histogram[RADIX_BUCKETS] = {0};
+      size_t last = sortTileStart(arrSize, nTiles, tile + 1);
+
+      for (size_t i = sortTileStart(arrSize, nTiles, tile); i < last; i++)
+        histogram[radixDigit(from, i, wide, signBit, shift)]++;
+
+      for (int digit = 0; digit < RADIX_BUCKETS; digit++)
+        counts[digit * nTiles + tile] = histogram[digit];
+    }
+
+    // Nothing moves if every key has the same digit
+    size_t digit = radixDigit(from, 0, wide, signBit, shift);
+    size_t sameDigit = 0;
+
+    for (int tile = 0; tile < nTiles; tile++)
+      sameDigit += counts[digit * nTiles + tile];
+
+    if (sameDigit == arrSize)
+      continue;
+
+    exclusiveScanCtx(offsets, counts, nCounts, sizeof(size_t), workerAddSize, pctx);
+
+    #pragma omp parallel for default(none) shared(from, to, arrSize, wide, signBit, shift, offsets, nTiles) \
+    schedule(static) num_threads(pctx->nThreads) if (!serial)
+    for (int tile = 0; tile < nTiles; tile++) {
+      size_t position[RADIX_BUCKETS];
+      size_t last = sortTileStart(arrSize, nTiles, tile + 1);
+
+      for (int digit = 0; digit < RADIX_BUCKETS; digit++)
+        position[digit] = offsets[digit * nTiles + tile];
+
+      for (size_t i = sortTileStart(arrSize, nTiles, tile); i < last; i++) {
+        size_t target = position[radixDigit(from, i, wide, signBit, shift)]++;
+
+        if (wide)
+          ((uint64_t *) to)[target] = ((const uint64_t *) from)[i];
+        else
+          ((uint32_t *) to)[target] = ((const uint32_t *) from)[i];
+      }
+    }
+
+    char *temp = from;
+    from = to;
+    to = temp;
+  }
+
+  // An odd number of moving passes leaves the keys in the buffer
+  if (from != arr) {
+    #pragma omp parallel for default(none) shared(arr, from, arrSize, sizeKey, nTiles) \
+    schedule(static) num_threads(pctx->nThreads) if (!serial)
+    for (int tile = 0; tile < nTiles; tile++) {
+      size_t first = sortTileStart(arrSize, nTiles, tile);
+      size_t last = sortTileStart(arrSize, nTiles, tile + 1);
+
+      memcpy((char *) arr + first * sizeKey, &from[first * sizeKey], (last - first) * sizeKey);
+    }
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void radixSortIntCtx(int *arr, size_t arrSize, patternCtx *pctx) {
+  radixSortImpl(arr, arrSize, sizeof(int) == sizeof(uint64_t), (uint64_t) 1 << (8 * sizeof(int) - 1), 0, pctx);
+}
+
+void radixSortInt(int *arr, size_t arrSize) {
+  radixSortIntCtx(arr, arrSize, patternCtxDefault());
+}
+
+void radixSortUint32Ctx(uint32_t *arr, size_t arrSize, patternCtx *pctx) {
+  radixSortImpl(arr, arrSize, 0, 0, 0, pctx);
+}
+
+void radixSortUint32(uint32_t *arr, size_t arrSize) {
+  radixSortUint32Ctx(arr, arrSize, patternCtxDefault());
+}
+
+void radixSortUint64Ctx(uint64_t *arr, size_t arrSize, patternCtx *pctx) {
+  radixSortImpl(arr, arrSize, 1, 0, 0, pctx);
+}
+
+void radixSortUint64(uint64_t *arr, size_t arrSize) {
+  radixSortUint64Ctx(arr, arrSize, patternCtxDefault());
+}
+
+void parallelSortIntCtx(int *arr, size_t arrSize, patternCtx *pctx) {
+  assert(arr != NULL);
+
+  if (arrSize == 0)
+    return;
+
+  if (arrSize < SORT_SERIAL_TRESHOLD)
+    quickSortCtx(arr, arrSize, pctx);
+  else
+    radixSortIntCtx(arr, arrSize, pctx);
+}
+
+void parallelSortInt(int *arr, size_t arrSize) {
+  parallelSortIntCtx(arr, arrSize, patternCtxDefault());
+}
+
+/*
+ * Key-index sort - the keys are packed with their position into 64 bit pairs and radix
+ * sorted, the positions of the sorted pairs are the permutation. The payload never moves
+ * while sorting, a single gather applies the permutation at the end.
+ * The pairs start in position order and every pass is stable, so only the four key
+ * bytes are sorted, the position bytes would only be shuffled and put back.
+*/
+void sortPermutationCtx(int *perm, const int *keys, size_t nJob, patternCtx *pctx) {
+  assert(perm != NULL);
+  assert(keys != NULL);
+  assert(nJob <= (size_t) INT_MAX);
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  uint64_t *pairs = arenaAlloc(arena, nJob * sizeof(uint64_t));
+
+  // Key in the high half with the sign bit flipped, position in the low half so equal keys stay in order
+  #pragma omp parallel for default(none) shared(pairs, keys, nJob) schedule(static) num_threads(pctx->nThreads)
+  for (size_t i = 0; i < nJob; i++)
+    pairs[i] = (uint64_t) ((uint32_t) keys[i] ^ 0x80000000u) << 32 | i;
+
+  radixSortImpl(pairs, nJob, 1, 0, 32, pctx);
+
+  #pragma omp parallel for default(none) shared(pairs, perm, nJob) schedule(static) num_threads(pctx->nThreads)
+  for (size_t i = 0; i < nJob; i++)
+    perm[i] = (int) (uint32_t) pairs[i];
+
+  arenaRelease(arena, mark);
+}
+
+void sortPermutation(int *perm, const int *keys, size_t nJob) {
+  sortPermutationCtx(perm, keys, nJob, patternCtxDefault());
+}
+
+// Keys are sorted in place, the objects are gathered straight into dest
+static void keyIndexSortImpl(int *keys, void *dest, const void *objects, size_t sizeJob, size_t nJob, patternCtx *pctx,
+                             patternArena *arena) {
+  int *perm = arenaAlloc(arena, nJob * sizeof(int));
+  int *sortedKeys = arenaAlloc(arena, nJob * sizeof(int));
+
+  sortPermutationCtx(perm, keys, nJob, pctx);
+
+  gatherCtx(sortedKeys, keys, nJob, sizeof(int), perm, (int) nJob, pctx);
+  gatherCtx(dest, (void *) objects, nJob, sizeJob, perm, (int) nJob, pctx);
+
+  #pragma omp parallel for default(none) shared(keys, sortedKeys, nJob) schedule(static) num_threads(pctx->nThreads)
+  for (size_t i = 0; i < nJob; i++)
+    keys[i] = sortedKeys[i];
+}
+
+void keyIndexSortIntoCtx(int *keys, void *dest, const void *objects, size_t sizeJob, size_t nJob, patternCtx *pctx) {
+  assert(keys != NULL);
+  assert(dest != NULL);
+  assert(objects != NULL);
+  assert(dest != objects);
+  assert(sizeJob > 0);
+
+  if (nJob == 0)
+    return;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  keyIndexSortImpl(keys, dest, objects, sizeJob, nJob, pctx, arena);
+
+  arenaRelease(arena, mark);
+}
+
+void keyIndexSortInto(int *keys, void *dest, const void *objects, size_t sizeJob, size_t nJob) {
+  keyIndexSortIntoCtx(keys, dest, objects, sizeJob, nJob, patternCtxDefault());
+}
+
+void keyIndexSortCtx(int *keys, void *objects, size_t sizeJob, size_t nJob, patternCtx *pctx) {
+  assert(keys != NULL);
+  assert(objects != NULL);
+  assert(sizeJob > 0);
+
+  if (nJob < 2)
+    return;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // The gather cannot work in place, the sorted copy goes back over the objects
+  char *sortedObjects = arenaAlloc(arena, nJob * sizeJob);
+
+  keyIndexSortImpl(keys, sortedObjects, objects, sizeJob, nJob, pctx, arena);
+
+  #pragma omp parallel for default(none) shared(objects, sortedObjects, sizeJob, nJob) schedule(static) \
+  num_threads(pctx->nThreads)
+  for (size_t i = 0; i < nJob; i++)
+    memcpy((char *) objects + i * sizeJob, &sortedObjects[i * sizeJob], sizeJob);
+
+  arenaRelease(arena, mark);
+}
+
+void keyIndexSort(int *keys, void *objects, size_t sizeJob, size_t nJob) {
+  keyIndexSortCtx(keys, objects, sizeJob, nJob, patternCtxDefault());
+}
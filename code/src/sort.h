@@ -0,0 +1,92 @@
+#ifndef __SORT_H
+#define __SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "context.h"
+
+/*
+ * Parallel sorts - sample sort for any key with a comparator and LSD radix sorts
+ * for integer keys. Below SORT_SERIAL_TRESHOLD elements, where splitting the work
+ * costs more than it saves, none of them starts a team: sampleSort falls back to qsort,
+ * the radix sorts make their passes on the calling thread and parallelSortInt uses quickSort.
+ */
+
+// Same contract as the qsort comparator
+typedef int (*sortCompare)(const void *a, const void *b);
+
+void sampleSort(
+    void *arr,            // Array to be sorted in place
+    size_t nJob,          // # elements in the array
+    size_t sizeJob,       // Size of each element in the array
+    sortCompare compare   // < 0, 0, > 0 if the first element goes before, with or after the second
+);
+
+void radixSortInt(
+    int *arr,             // Array to be sorted in place
+    size_t arrSize        // # elements in the array
+);
+
+void radixSortUint32(
+    uint32_t *arr,        // Array to be sorted in place
+    size_t arrSize        // # elements in the array
+);
+
+void radixSortUint64(
+    uint64_t *arr,        // Array to be sorted in place
+    size_t arrSize        // # elements in the array
+);
+
+// quickSort for small arrays, radix sort for the rest
+void parallelSortInt(
+    int *arr,             // Array to be sorted in place
+    size_t arrSize        // # elements in the array
+);
+
+// Permutation that sorts the keys, keys[perm[0]] <= keys[perm[1]] <= ... and equal keys keep their order
+void sortPermutation(
+    int *perm,            // Target permutation, nJob source positions
+    const int *keys,      // Keys to be sorted, left untouched
+    size_t nJob           // # keys
+);
+
+// Sorts the keys and reflects their positions on the objects, which are gathered into
+// a scratch copy of nJob objects and copied back, so each object is moved twice
+void keyIndexSort(
+    int *keys,            // Source int array, sorted in place
+    void *objects,        // Dependent object array
+    size_t sizeJob,       // Dependent object array object size
+    size_t nJob           // # elements in the source int array
+);
+
+// Same as keyIndexSort, but the objects are gathered straight into dest, each one is moved exactly once
+void keyIndexSortInto(
+    int *keys,            // Source int array, sorted in place
+    void *dest,           // Target object array, must not overlap the objects
+    const void *objects,  // Dependent object array, left untouched
+    size_t sizeJob,       // Dependent object array object size
+    size_t nJob           // # elements in the source int array
+);
+
+/*
+ * Context aware variants - same arguments as above, plus the context
+ * the sort takes its team and scratch from
+ */
+
+void sampleSortCtx(void *arr, size_t nJob, size_t sizeJob, sortCompare compare, patternCtx *pctx);
+
+void radixSortIntCtx(int *arr, size_t arrSize, patternCtx *pctx);
+
+void radixSortUint32Ctx(uint32_t *arr, size_t arrSize, patternCtx *pctx);
+
+void radixSortUint64Ctx(uint64_t *arr, size_t arrSize, patternCtx *pctx);
+
+void parallelSortIntCtx(int *arr, size_t arrSize, patternCtx *pctx);
+
+void sortPermutationCtx(int *perm, const int *keys, size_t nJob, patternCtx *pctx);
+
+void keyIndexSortCtx(int *keys, void *objects, size_t sizeJob, size_t nJob, patternCtx *pctx);
+
+void keyIndexSortIntoCtx(int *keys, void *dest, const void *objects, size_t sizeJob, size_t nJob, patternCtx *pctx);
+
+#endif
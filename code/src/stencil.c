@@ -0,0 +1,394 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <omp.h>
+#include "stencil.h"
+
+// Largest # time steps run on one tile load
+#define STENCIL_TIME_BLOCK 4
+
+// # adjacent lines a sliding window pass walks together
+#define STENCIL_LINE_BLOCK 64
+
+/*
+ *  UTILS
+*/
+static long clampCoord(long g, long n) {
+  return g < 0 ? 0 : g >= n ? n - 1 : g;
+}
+
+static int inDomain(const long g[3], const stencilGrid *grid) {
+  for (int d = 0; d < 3; d++)
+    if (g[d] < 0 || g[d] >= (long) grid->dims[d])
+      return 0;
+
+  return 1;
+}
+
+static size_t gridCells(const stencilGrid *grid) {
+  return grid->dims[0] * grid->dims[1] * grid->dims[2];
+}
+
+static void gridAsserts(const void *dest, const void *src, size_t sizeJob, const stencilGrid *grid) {
+  assert(dest != NULL);
+  assert(src != NULL);
+  assert(dest != src);
+  assert(sizeJob > 0);
+  assert(grid != NULL);
+
+  for (int d = 0; d < 3; d++) {
+    assert(grid->dims[d] >= 1);
+    assert(grid->radius[d] >= 0);
+  }
+
+  assert(grid->timeBlock >= 0);
+}
+
+/*
+ * Tiled stencil with temporal blocking. A tile running T steps is loaded with a halo of
+ * T * radius cells, every step computes a region one radius smaller than the previous one,
+ * so after T steps the tile itself is exact and no other tile had to be read in between.
+*/
+typedef struct gridTile {
+    long origin[3];             // First cell of the tile
+    long size[3];               // # cells of the tile
+    long halo[3];               // Halo loaded around the tile
+    long padded[3];             // Tile plus halo on both sides
+} gridTile;
+
+static size_t tileOffset(const gridTile *tile, long x, long y, long z) {
+  // Coordinates are global, the buffer starts at origin - halo
+  return ((z - tile->origin[2] + tile->halo[2]) * tile->padded[1]
+          + (y - tile->origin[1] + tile->halo[1])) * tile->padded[0]
+         + (x - tile->origin[0] + tile->halo[0]);
+}
+
+// Tile shape that keeps both buffers of a tile within the cache block of the context
+static void tileShape(long shape[3], const stencilGrid *grid, size_t sizeJob, int timeBlock, patternCtx *pctx) {
+  size_t budget = patternCtxBlockSize(pctx, sizeJob) / 2;
+
+  for (int d = 0; d < 3; d++)
+    shape[d] = grid->dims[d];
+
+  for (;;) {
+    size_t volume = 1;
+    int largest = 2;
+
+    for (int d = 0; d < 3; d++)
+      volume *= shape[d] + 2 * grid->radius[d] * timeBlock;
+
+    // Rows stay as long as possible, z then y are cut first on ties
+    for (int d = 1; d >= 0; d--)
+      if (shape[d] > shape[largest])
+        largest = d;
+
+    if (volume <= budget || shape[largest] == 1)
+      return;
+
+    shape[largest] = (shape[largest] + 1) / 2;
+  }
+}
+
+// More steps per load only pay off while the halo stays small next to the tile
+static int pickTimeBlock(const stencilGrid *grid, size_t sizeJob, int nSteps, patternCtx *pctx) {
+  if (grid->timeBlock > 0)
+    return grid->timeBlock < nSteps ? grid->timeBlock : nSteps;
+
+  int timeBlock = STENCIL_TIME_BLOCK < nSteps ? STENCIL_TIME_BLOCK : nSteps;
+
+  for (; timeBlock > 1; timeBlock--) {
+    long shape[3];
+    int fits = 1;
+
+    tileShape(shape, grid, sizeJob, timeBlock, pctx);
+
+    for (int d = 0; d < 3; d++)
+      if (shape[d] < (long) grid->dims[d] && shape[d] < 4 * grid->radius[d] * timeBlock)
+        fits = 0;
+
+    if (fits)
+      break;
+  }
+
+  return timeBlock;
+}
+
+static void tileLoad(char *buf, const char *in, const gridTile *tile, const stencilGrid *grid, size_t sizeJob) {
+  long g[3];
+
+  for (g[2] = tile->origin[2] - tile->halo[2]; g[2] < tile->origin[2] + tile->size[2] + tile->halo[2]; g[2]++) {
+    for (g[1] = tile->origin[1] - tile->halo[1]; g[1] < tile->origin[1] + tile->size[1] + tile->halo[1]; g[1]++) {
+      for (g[0] = tile->origin[0] - tile->halo[0]; g[0] < tile->origin[0] + tile->size[0] + tile->halo[0]; g[0]++) {
+        char *cell = &buf[tileOffset(tile, g[0], g[1], g[2]) * sizeJob];
+
+        if (grid->boundary == STENCIL_ZERO && !inDomain(g, grid)) {
+          memset(cell, 0, sizeJob);
+          continue;
+        }
+
+        size_t x = clampCoord(g[0], grid->dims[0]);
+        size_t y = clampCoord(g[1], grid->dims[1]);
+        size_t z = clampCoord(g[2], grid->dims[2]);
+
+        memcpy(cell, &in[((z * grid->dims[1] + y) * grid->dims[0] + x) * sizeJob], sizeJob);
+      }
+    }
+  }
+}
+
+// Runs the steps of a time block on one tile and writes the tile to out
+static void tileSteps(char *out, const char *in, const gridTile *tile, const stencilGrid *grid, size_t sizeJob,
+                      int nSteps, gridWorker worker, void *ctx, char *cur, char *next) {
+  size_t bufSize = tile->padded[0] * tile->padded[1] * tile->padded[2] * sizeJob;
+
+  tileLoad(cur, in, tile, grid, sizeJob);
+
+  // Cells outside the grid are never computed, both buffers start with their boundary value
+  memcpy(next, cur, bufSize);
+
+  stencilCell cell;
+  cell.stride[0] = sizeJob;
+  cell.stride[1] = tile->padded[0] * sizeJob;
+  cell.stride[2] = tile->padded[0] * tile->padded[1] * sizeJob;
+
+  for (int step = 1; step <= nSteps; step++) {
+    long lo[3];
+    long hi[3];
+    long g[3];
+
+    // Region still exact after this step, only its cells inside the grid are computed
+    for (int d = 0; d < 3; d++) {
+      long reach = (long) grid->radius[d] * (nSteps - step);
+
+      lo[d] = tile->origin[d] - reach;
+      hi[d] = tile->origin[d] + tile->size[d] + reach;
+    }
+
+    long clo[3];
+    long chi[3];
+
+    for (int d = 0; d < 3; d++) {
+      clo[d] = lo[d] < 0 ? 0 : lo[d];
+      chi[d] = hi[d] > (long) grid->dims[d] ? (long) grid->dims[d] : hi[d];
+    }
+
+    for (g[2] = clo[2]; g[2] < chi[2]; g[2]++) {
+      for (g[1] = clo[1]; g[1] < chi[1]; g[1]++) {
+        for (g[0] = clo[0]; g[0] < chi[0]; g[0]++) {
+          size_t offset = tileOffset(tile, g[0], g[1], g[2]) * sizeJob;
+
+          cell.center = &cur[offset];
+          worker(&next[offset], &cell, ctx);
+        }
+      }
+    }
+
+    int interior = 1;
+
+    for (int d = 0; d < 3; d++)
+      if (clo[d] != lo[d] || chi[d] != hi[d])
+        interior = 0;
+
+    // Clamped cells follow the edge of the grid they copy
+    if (grid->boundary == STENCIL_CLAMP && !interior) {
+      for (g[2] = lo[2]; g[2] < hi[2]; g[2]++) {
+        for (g[1] = lo[1]; g[1] < hi[1]; g[1]++) {
+          for (g[0] = lo[0]; g[0] < hi[0]; g[0]++) {
+            if (inDomain(g, grid))
+              continue;
+
+            long x = clampCoord(g[0], grid->dims[0]);
+            long y = clampCoord(g[1], grid->dims[1]);
+            long z = clampCoord(g[2], grid->dims[2]);
+
+            memcpy(&next[tileOffset(tile, g[0], g[1], g[2]) * sizeJob], &next[tileOffset(tile, x, y, z) * sizeJob], sizeJob);
+          }
+        }
+      }
+    }
+
+    char *temp = cur;
+    cur = next;
+    next = temp;
+  }
+
+  // Write the exact part of the tile back, one row at a time
+  for (long z = tile->origin[2]; z < tile->origin[2] + tile->size[2]; z++)
+    for (long y = tile->origin[1]; y < tile->origin[1] + tile->size[1]; y++)
+      memcpy(&out[((z * grid->dims[1] + y) * grid->dims[0] + tile->origin[0]) * sizeJob],
+             &cur[tileOffset(tile, tile->origin[0], y, z) * sizeJob], tile->size[0] * sizeJob);
+}
+
+void gridStencilCtx(void *dest, void *src, size_t sizeJob, const stencilGrid *grid, gridWorker worker, int nSteps, void *ctx, patternCtx *pctx) {
+  gridAsserts(dest, src, sizeJob, grid);
+  assert(worker != NULL);
+  assert(nSteps >= 0);
+
+  if (nSteps == 0) {
+    memcpy(dest, src, gridCells(grid) * sizeJob);
+    return;
+  }
+
+  int timeBlock = pickTimeBlock(grid, sizeJob, nSteps, pctx);
+  int nBlocks = (nSteps + timeBlock - 1) / timeBlock;
+
+  long shape[3];
+  long nTiles[3];
+
+  tileShape(shape, grid, sizeJob, timeBlock, pctx);
+
+  for (int d = 0; d < 3; d++)
+    nTiles[d] = (grid->dims[d] + shape[d] - 1) / shape[d];
+
+  long totalTiles = nTiles[0] * nTiles[1] * nTiles[2];
+  size_t bufSize = sizeJob;
+
+  for (int d = 0; d < 3; d++)
+    bufSize *= shape[d] + 2 * grid->radius[d] * timeBlock;
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // Time blocks alternate between dest and the scratch grid, the last one writes dest
+  char *scratch = nBlocks > 1 ? arenaAlloc(arena, gridCells(grid) * sizeJob) : NULL;
+
+  #pragma omp parallel default(none) \
+  shared(dest, src, sizeJob, grid, worker, nSteps, ctx, pctx, timeBlock, nBlocks, shape, nTiles, totalTiles, bufSize, scratch) \
+  num_threads(pctx->nThreads)
+  {
+    patternArena *threadArena = patternCtxThreadArena(pctx, omp_get_thread_num());
+    arenaMark threadMark = arenaGetMark(threadArena);
+
+    char *cur = arenaAlloc(threadArena, bufSize);
+    char *next = arenaAlloc(threadArena, bufSize);
+
+    for (int block = 0; block < nBlocks; block++) {
+      int steps = nSteps - block * timeBlock < timeBlock ? nSteps - block * timeBlock : timeBlock;
+      char *out = (nBlocks - 1 - block) % 2 == 0 ? dest : scratch;
+      const char *in = block == 0 ? src : ((nBlocks - block) % 2 == 0 ? dest : scratch);
+
+      // Tiles at the edges are smaller, hand them out one at a time
+      #pragma omp for schedule(dynamic, 1)
+      for (long t = 0; t < totalTiles; t++) {
+        gridTile tile;
+        long index[3] = {t % nTiles[0], t / nTiles[0] % nTiles[1], t / (nTiles[0] * nTiles[1])};
+
+        for (int d = 0; d < 3; d++) {
+          tile.origin[d] = index[d] * shape[d];
+          tile.size[d] = tile.origin[d] + shape[d] <= (long) grid->dims[d] ? shape[d] : (long) grid->dims[d] - tile.origin[d];
+          tile.halo[d] = (long) grid->radius[d] * steps;
+          tile.padded[d] = tile.size[d] + 2 * tile.halo[d];
+        }
+
+        tileSteps(out, in, &tile, grid, sizeJob, steps, worker, ctx, cur, next);
+      }
+    }
+
+    arenaRelease(threadArena, threadMark);
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void gridStencil(void *dest, void *src, size_t sizeJob, const stencilGrid *grid, gridWorker worker, int nSteps, void *ctx) {
+  gridStencilCtx(dest, src, sizeJob, grid, worker, nSteps, ctx, patternCtxDefault());
+}
+
+/*
+ * Sliding window stencil - a box is separable, so it runs as one pass per axis. Each pass
+ * walks a block of adjacent lines together, the window of every line enters one cell and
+ * drops one cell per step instead of being accumulated again.
+*/
+static void slidePass(char *out, const char *in, const stencilGrid *grid, int axis, size_t sizeJob,
+                      void (*add)(void *v1, const void *v2), void (*remove)(void *v1, const void *v2), patternCtx *pctx) {
+  // Cells below the axis are contiguous, lines of the same slab are neighbours in memory
+  size_t inner = 1;
+  size_t outer = 1;
+  long n = grid->dims[axis];
+  long radius = grid->radius[axis];
+
+  for (int d = 0; d < axis; d++)
+    inner *= grid->dims[d];
+
+  for (int d = axis + 1; d < 3; d++)
+    outer *= grid->dims[d];
+
+  size_t lineBlock = inner < STENCIL_LINE_BLOCK ? inner : STENCIL_LINE_BLOCK;
+  size_t nLineBlocks = (inner + lineBlock - 1) / lineBlock;
+
+  #pragma omp parallel default(none) \
+  shared(out, in, sizeJob, add, remove, pctx, inner, outer, n, radius, lineBlock, nLineBlocks) \
+  num_threads(pctx->nThreads)
+  {
+    patternArena *threadArena = patternCtxThreadArena(pctx, omp_get_thread_num());
+    arenaMark threadMark = arenaGetMark(threadArena);
+
+    char *acc = arenaAlloc(threadArena, lineBlock * sizeJob);
+
+    #pragma omp for schedule(static)
+    for (size_t unit = 0; unit < outer * nLineBlocks; unit++) {
+      size_t first = unit % nLineBlocks * lineBlock;
+      size_t count = first + lineBlock <= inner ? lineBlock : inner - first;
+      size_t base = unit / nLineBlocks * n * inner + first;
+
+      // Existing patterns assume a zero identity
+      memset(acc, 0, count * sizeJob);
+
+      for (long i = 0; i <= radius && i < n; i++)
+        for (size_t w = 0; w < count; w++)
+          add(&acc[w * sizeJob], &in[(base + i * inner + w) * sizeJob]);
+
+      for (long i = 0; i < n; i++) {
+        memcpy(&out[(base + i * inner) * sizeJob], acc, count * sizeJob);
+
+        if (i + radius + 1 < n)
+          for (size_t w = 0; w < count; w++)
+            add(&acc[w * sizeJob], &in[(base + (i + radius + 1) * inner + w) * sizeJob]);
+
+        if (i - radius >= 0)
+          for (size_t w = 0; w < count; w++)
+            remove(&acc[w * sizeJob], &in[(base + (i - radius) * inner + w) * sizeJob]);
+      }
+    }
+
+    arenaRelease(threadArena, threadMark);
+  }
+}
+
+void slidingStencilCtx(void *dest, void *src, size_t sizeJob, const stencilGrid *grid, void (*add)(void *v1, const void *v2), void (*remove)(void *v1, const void *v2), patternCtx *pctx) {
+  gridAsserts(dest, src, sizeJob, grid);
+  assert(add != NULL);
+  assert(remove != NULL);
+
+  int axes[3];
+  int nAxes = 0;
+
+  for (int d = 0; d < 3; d++)
+    if (grid->radius[d] > 0 && grid->dims[d] > 1)
+      axes[nAxes++] = d;
+
+  if (nAxes == 0) {
+    memcpy(dest, src, gridCells(grid) * sizeJob);
+    return;
+  }
+
+  patternArena *arena = patternCtxArena(pctx);
+  arenaMark mark = arenaGetMark(arena);
+
+  // Passes alternate between dest and the scratch grid, the last one writes dest
+  char *scratch = nAxes > 1 ? arenaAlloc(arena, gridCells(grid) * sizeJob) : NULL;
+  const char *in = src;
+
+  for (int pass = 0; pass < nAxes; pass++) {
+    char *out = (nAxes - 1 - pass) % 2 == 0 ? dest : scratch;
+
+    slidePass(out, in, grid, axes[pass], sizeJob, add, remove, pctx);
+    in = out;
+  }
+
+  arenaRelease(arena, mark);
+}
+
+void slidingStencil(void *dest, void *src, size_t sizeJob, const stencilGrid *grid, void (*add)(void *v1, const void *v2), void (*remove)(void *v1, const void *v2)) {
+  slidingStencilCtx(dest, src, sizeJob, grid, add, remove, patternCtxDefault());
+}
@@ -0,0 +1,69 @@
+#ifndef __STENCIL_H
+#define __STENCIL_H
+
+#include <stddef.h>
+#include "context.h"
+
+/*
+ * Grid stencils - 1D, 2D and 3D grids stored x fastest, then y, then z.
+ * The domain is cut in cache sized tiles that are loaded once with their halo,
+ * several time steps can run on a loaded tile before it is written back.
+ */
+
+// Value of the cells outside the grid
+typedef enum stencilBoundary {
+    STENCIL_CLAMP,              // Nearest cell of the grid
+    STENCIL_ZERO                // All bytes zero
+} stencilBoundary;
+
+typedef struct stencilGrid {
+    size_t dims[3];             // # cells along x, y and z, 1 for unused dimensions
+    int radius[3];              // Reach of the neighbourhood along x, y and z
+    stencilBoundary boundary;   // Cells read outside the grid
+    int timeBlock;              // Time steps per tile load, 0 picks it from the tile size
+} stencilGrid;
+
+// Neighbourhood of a cell, neighbours up to the radius are always readable
+typedef struct stencilCell {
+    const char *center;         // The cell itself
+    ptrdiff_t stride[3];        // Bytes between neighbours along x, y and z
+} stencilCell;
+
+// Neighbour (dx, dy, dz) of a cell
+#define STENCIL_AT(cell, dx, dy, dz) \
+    ((const void *) ((cell)->center + (dx) * (cell)->stride[0] + (dy) * (cell)->stride[1] + (dz) * (cell)->stride[2]))
+
+// [ v1 = op (neighbourhood) ]
+typedef void (*gridWorker)(void *dest, const stencilCell *cell, void *ctx);
+
+void gridStencil(
+    void *dest,                 // Target grid
+    void *src,                  // Source grid, left untouched
+    size_t sizeJob,             // Size of each cell
+    const stencilGrid *grid,    // Shape, neighbourhood and boundary
+    gridWorker worker,          // Computes one cell of the next time step
+    int nSteps,                 // # time steps
+    void *ctx                   // User data for the worker
+);
+
+// Box stencil for operators with an inverse, every window is updated from the previous one
+// Windows are clipped at the edges of the grid, as in stencil
+void slidingStencil(
+    void *dest,                 // Target grid
+    void *src,                  // Source grid, left untouched
+    size_t sizeJob,             // Size of each cell
+    const stencilGrid *grid,    // Shape and neighbourhood, the boundary is not used
+    void (*add)(void *v1, const void *v2),    // [ v1 = v1 op v2 ]
+    void (*remove)(void *v1, const void *v2)  // [ v1 = v1 inverse op v2 ]
+);
+
+/*
+ * Context aware variants - same arguments as above, plus the context
+ * the stencil takes its team, tile size and scratch from
+ */
+
+void gridStencilCtx(void *dest, void *src, size_t sizeJob, const stencilGrid *grid, gridWorker worker, int nSteps, void *ctx, patternCtx *pctx);
+
+void slidingStencilCtx(void *dest, void *src, size_t sizeJob, const stencilGrid *grid, void (*add)(void *v1, const void *v2), void (*remove)(void *v1, const void *v2), patternCtx *pctx);
+
+#endif
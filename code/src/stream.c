@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "stream.h"
+
+// Spins before a waiting thread gives up its core
+#define STREAM_SPINS 64
+
+/*
+ *  Bounded single-producer/single-consumer ring buffer
+*/
+typedef struct spscQueue {
+    char *slots;
+    size_t mask;
+    size_t sizeJob;
+    _Alignas(64) atomic_size_t head; // Next slot to be consumed
+    _Alignas(64) atomic_size_t tail; // Next slot to be produced
+} spscQueue;
+
+static void queueInit(spscQueue *q, size_t capacity, size_t sizeJob) {
+  q->slots = malloc(capacity * sizeJob);
+  q->mask = capacity - 1;
+  q->sizeJob = sizeJob;
+
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+}
+
+// Slot for the next item, NULL if the queue is full
+static char *queueReserve(spscQueue *q) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+  if (tail - atomic_load_explicit(&q->head, memory_order_acquire) > q->mask)
+    return NULL;
+
+  return &q->slots[(tail & q->mask) * q->sizeJob];
+}
+
+static void queueCommit(spscQueue *q) {
+  atomic_fetch_add_explicit(&q->tail, 1, memory_order_release);
+}
+
+// Oldest item, NULL if the queue is empty
+static char *queuePeek(spscQueue *q) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+  if (head == atomic_load_explicit(&q->tail, memory_order_acquire))
+    return NULL;
+
+  return &q->slots[(head & q->mask) * q->sizeJob];
+}
+
+static void queueConsume(spscQueue *q) {
+  atomic_fetch_add_explicit(&q->head, 1, memory_order_release);
+}
+
+static void backoff(int *spins) {
+  if (++*spins % STREAM_SPINS == 0)
+    sched_yield();
+}
+
+/*
+ *  Pipeline
+*/
+typedef struct streamStage {
+    void (*worker)(void *v1, const void *v2);
+    int nWorkers;
+} streamStage;
+
+typedef struct streamThread {
+    streamPipeline *sp;
+    int stage;
+    int worker;
+    pthread_t thread;
+} streamThread;
+
+struct streamPipeline {
+    size_t sizeJob;
+    size_t capacity;
+
+    streamStage *stages;
+    int nStages;
+
+    // queues[b] connects the producers of boundary b to its consumers, index producer * nConsumers + consumer
+    // boundary 0 is fed by the caller and the last boundary is drained by the caller
+    spscQueue **queues;
+
+    streamThread *threads;
+    int nThreads;
+
+    size_t nPushed;       // Only touched by the caller
+    size_t nPulled;       // Only touched by the caller
+    atomic_size_t nItems; // Total # items, valid once closed
+    atomic_int closed;
+};
+
+static int producersOf(const streamPipeline *sp, int boundary) {
+  return boundary == 0 ? 1 : sp->stages[boundary - 1].nWorkers;
+}
+
+static int consumersOf(const streamPipeline *sp, int boundary) {
+  return boundary == sp->nStages ? 1 : sp->stages[boundary].nWorkers;
+}
+
+// Queue item j travels through when crossing a boundary
+static spscQueue *queueOf(streamPipeline *sp, int boundary, size_t item) {
+  int nProducers = producersOf(sp, boundary);
+  int nConsumers = consumersOf(sp, boundary);
+
+  return &sp->queues[boundary][(item % nProducers) * nConsumers + item % nConsumers];
+}
+
+// True once item will never be pushed
+static int pastEnd(streamPipeline *sp, size_t item) {
+  return atomic_load_explicit(&sp->closed, memory_order_acquire)
+         && item >= atomic_load_explicit(&sp->nItems, memory_order_relaxed);
+}
+
+static void *stageWorker(void *arg) {
+  streamThread *self = arg;
+  streamPipeline *sp = self->sp;
+  int stage = self->stage;
+  void (*worker)(void *v1, const void *v2) = sp->stages[stage].worker;
+
+  // Worker w of a stage with k workers handles items w, w + k, w + 2k...
+  for (size_t item = self->worker;; item += sp->stages[stage].nWorkers) {
+    spscQueue *in = queueOf(sp, stage, item);
+    spscQueue *out = queueOf(sp, stage + 1, item);
+    char *src;
+    char *dest;
+    int spins = 0;
+
+    while ((src = queuePeek(in)) == NULL) {
+      if (pastEnd(sp, item))
+        return NULL;
+
+      backoff(&spins);
+    }
+
+    while ((dest = queueReserve(out)) == NULL)
+      backoff(&spins);
+
+    worker(dest, src);
+
+    queueCommit(out);
+    queueConsume(in);
+  }
+}
+
+streamPipeline *streamCreate(size_t sizeJob, size_t capacity) {
+  assert(sizeJob > 0);
+  assert(capacity > 0);
+
+  streamPipeline *sp = calloc(1, sizeof(streamPipeline));
+
+  sp->sizeJob = sizeJob;
+  sp->capacity = 1;
+
+  while (sp->capacity < capacity)
+    sp->capacity *= 2;
+
+  atomic_init(&sp->nItems, 0);
+  atomic_init(&sp->closed, 0);
+
+  return sp;
+}
+
+void streamAddStage(streamPipeline *sp, void (*worker)(void *v1, const void *v2), streamStageKind kind, int nWorkers) {
+  assert(sp != NULL);
+  assert(worker != NULL);
+  assert(sp->threads == NULL);
+  assert(kind == STAGE_SERIAL || nWorkers >= 1);
+
+  sp->stages = realloc(sp->stages, (sp->nStages + 1) * sizeof(streamStage));
+  sp->stages[sp->nStages].worker = worker;
+  sp->stages[sp->nStages].nWorkers = kind == STAGE_SERIAL ? 1 : nWorkers;
+  sp->nStages++;
+}
+
+void streamStart(streamPipeline *sp) {
+  assert(sp != NULL);
+  assert(sp->nStages > 0);
+  assert(sp->threads == NULL);
+
+  // Create queues for every boundary
+  sp->queues = calloc(sp->nStages + 1, sizeof(spscQueue *));
+
+  for (int b = 0; b <= sp->nStages; b++) {
+    int nQueues = producersOf(sp, b) * consumersOf(sp, b);
+
+    sp->queues[b] = aligned_alloc(_Alignof(spscQueue), nQueues * sizeof(spscQueue));
+
+    for (int q = 0; q < nQueues; q++)
+      queueInit(&sp->queues[b][q], sp->capacity, sp->sizeJob);
+  }
+
+  // Launch one thread per stage worker
+  for (int stage = 0; stage < sp->nStages; stage++)
+    sp->nThreads += sp->stages[stage].nWorkers;
+
+  sp->threads = calloc(sp->nThreads, sizeof(streamThread));
+
+  int t = 0;
+  for (int stage = 0; stage < sp->nStages; stage++) {
+    for (int w = 0; w < sp->stages[stage].nWorkers; w++, t++) {
+      sp->threads[t].sp = sp;
+      sp->threads[t].stage = stage;
+      sp->threads[t].worker = w;
+
+      pthread_create(&sp->threads[t].thread, NULL, stageWorker, &sp->threads[t]);
+    }
+  }
+}
+
+int streamTryPush(streamPipeline *sp, const void *item) {
+  assert(sp->threads != NULL);
+  assert(!atomic_load(&sp->closed));
+
+  spscQueue *q = queueOf(sp, 0, sp->nPushed);
+  char *slot = queueReserve(q);
+
+  if (slot == NULL)
+    return 0;
+
+  memcpy(slot, item, sp->sizeJob);
+  queueCommit(q);
+  sp->nPushed++;
+
+  return 1;
+}
+
+void streamPush(streamPipeline *sp, const void *item) {
+  int spins = 0;
+
+  while (!streamTryPush(sp, item))
+    backoff(&spins);
+}
+
+void streamClose(streamPipeline *sp) {
+  atomic_store_explicit(&sp->nItems, sp->nPushed, memory_order_relaxed);
+  atomic_store_explicit(&sp->closed, 1, memory_order_release);
+}
+
+int streamTryPull(streamPipeline *sp, void *item) {
+  assert(sp->threads != NULL);
+
+  spscQueue *q = queueOf(sp, sp->nStages, sp->nPulled);
+  char *slot = queuePeek(q);
+
+  if (slot == NULL)
+    return pastEnd(sp, sp->nPulled) ? -1 : 0;
+
+  memcpy(item, slot, sp->sizeJob);
+  queueConsume(q);
+  sp->nPulled++;
+
+  return 1;
+}
+
+int streamPull(streamPipeline *sp, void *item) {
+  int spins = 0;
+  int result;
+
+  while ((result = streamTryPull(sp, item)) == 0)
+    backoff(&spins);
+
+  return result > 0;
+}
+
+void streamDestroy(streamPipeline *sp) {
+  if (sp->threads != NULL && !atomic_load(&sp->closed))
+    streamClose(sp);
+
+  // Items left in the pipeline are drained so the workers can finish
+  if (sp->threads != NULL) {
+    char *item = malloc(sp->sizeJob);
+
+    while (streamPull(sp, item));
+
+    free(item);
+  }
+
+  for (int t = 0; t < sp->nThreads; t++)
+    pthread_join(sp->threads[t].thread, NULL);
+
+  if (sp->queues != NULL) {
+    for (int b = 0; b <= sp->nStages; b++) {
+      int nQueues = producersOf(sp, b) * consumersOf(sp, b);
+
+      for (int q = 0; q < nQueues; q++)
+        free(sp->queues[b][q].slots);
+
+      free(sp->queues[b]);
+    }
+  }
+
+  free(sp->queues);
+  free(sp->threads);
+  free(sp->stages);
+  free(sp);
+}
+
+void streamingPipeline(void *dest, void *src, size_t nJob, size_t sizeJob, void (*workerList[])(void *v1, const void *v2), const int *nStageWorkers, size_t nWorkers) {
+  assert(dest != NULL);
+  assert(src != NULL);
+  assert(workerList != NULL);
+  assert(nStageWorkers != NULL);
+
+  /*
+   * Array front end of the streaming pipeline, the caller alternates
+   * between feeding items and draining results
+  */
+
+  char *d = dest;
+  char *s = src;
+
+  if (nWorkers == 0)
+    return;
+
+  streamPipeline *sp = streamCreate(sizeJob, 1024);
+
+  for (size_t j = 0; j < nWorkers; j++)
+    streamAddStage(sp, workerList[j], nStageWorkers[j] > 1 ? STAGE_PARALLEL : STAGE_SERIAL, nStageWorkers[j]);
+
+  streamStart(sp);
+
+  size_t pushed = 0;
+  size_t pulled = 0;
+  int closed = 0;
+  int spins = 0;
+
+  while (pulled < nJob) {
+    int progress = 0;
+
+    while (pushed < nJob && streamTryPush(sp, &s[pushed * sizeJob])) {
+      pushed++;
+      progress = 1;
+    }
+
+    if (pushed == nJob && !closed) {
+      streamClose(sp);
+      closed = 1;
+    }
+
+    while (streamTryPull(sp, &d[pulled * sizeJob]) > 0) {
+      pulled++;
+      progress = 1;
+    }
+
+    if (!progress)
+      backoff(&spins);
+  }
+
+  streamDestroy(sp);
+}
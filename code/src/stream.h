@@ -0,0 +1,66 @@
+#ifndef __STREAM_H
+#define __STREAM_H
+
+#include <stddef.h>
+
+/*
+ * Streaming pipeline - every stage runs on its own threads, connected by bounded
+ * single-producer/single-consumer ring buffers. Items are pushed and pulled one
+ * at a time, so the input never has to be materialized as a whole.
+ *
+ * Parallel (farmed) stages deal their items round-robin to their workers and the
+ * next stage collects them in the same order, so every stage sees the items in the
+ * order they were pushed and each queue keeps a single producer and consumer.
+ */
+
+typedef enum streamStageKind {
+    STAGE_SERIAL,         // One worker, items processed in order
+    STAGE_PARALLEL        // Several workers, output order is still preserved
+} streamStageKind;
+
+typedef struct streamPipeline streamPipeline;
+
+streamPipeline *streamCreate(
+    size_t sizeJob,       // Size of each item
+    size_t capacity       // # items each queue can hold, rounded up to a power of two
+);
+
+void streamAddStage(
+    streamPipeline *sp,   // Pipeline, not started yet
+    void (*worker)(void *v1, const void *v2), // [ v1 = op (v2) ]
+    streamStageKind kind, // Serial or parallel stage
+    int nWorkers          // # workers of a parallel stage
+);
+
+// Launches the stage threads, after this no more stages can be added
+void streamStart(streamPipeline *sp);
+
+// Blocks until there is room for the item
+void streamPush(streamPipeline *sp, const void *item);
+
+// Returns 0 without blocking if there is no room for the item
+int streamTryPush(streamPipeline *sp, const void *item);
+
+// Marks the end of the input
+void streamClose(streamPipeline *sp);
+
+// Blocks until an item comes out of the pipeline, returns 0 once the closed pipeline is drained
+int streamPull(streamPipeline *sp, void *item);
+
+// Returns 1 if an item was pulled, 0 if none is ready yet and -1 once the closed pipeline is drained
+int streamTryPull(streamPipeline *sp, void *item);
+
+// Waits for the stage threads and frees the pipeline
+void streamDestroy(streamPipeline *sp);
+
+void streamingPipeline(
+    void *dest,           // Target array
+    void *src,            // Source array
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob,       // Size of each element in the source array
+    void (*workerList[])(void *v1, const void *v2), // one function for each stage of the pipeline
+    const int *nStageWorkers, // # workers of each stage, 1 for a serial stage
+    size_t nWorkers       // # stages in the pipeline
+);
+
+#endif
@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <omp.h>
+#include "tune.h"
+#include "patterns.h"
+
+// Timed runs of every candidate, the fastest one counts
+#define TUNE_REPETITIONS 5
+
+// A candidate replaces a cheaper one only when it is this much faster
+#define TUNE_MARGIN 0.05
+
+// Longest line of a tuning file
+#define TUNE_LINE 256
+
+static const char *patternNames[] = {"map", "reduce", "scan", "quickSort"};
+
+static const char *scheduleNames[] = {"static", "dynamic", "guided"};
+
+// Grains of the map schedules, from the cheapest to run to the finest
+static const patternSchedule mapSchedules[] = {SCHEDULE_STATIC, SCHEDULE_DYNAMIC, SCHEDULE_DYNAMIC, SCHEDULE_GUIDED};
+static const int mapChunks[] = {0, 16384, 1024, 0};
+
+static const size_t sortCutoffs[] = {1000, 4000, 16000, 250};
+
+// Process wide, in insertion order
+static tuneEntry *table = NULL;
+static size_t nEntries = 0;
+static size_t capacity = 0;
+
+/*
+ *  TABLE
+*/
+
+void tuneReset(void) {
+  free(table);
+
+  table = NULL;
+  nEntries = 0;
+  capacity = 0;
+}
+
+void tuneSet(const tuneEntry *entry) {
+  assert (entry != NULL);
+  assert (entry->nThreads > 0);
+  assert (entry->chunkSize >= 0);
+
+  for (size_t i = 0; i < nEntries; i++) {
+    if (table[i].pattern == entry->pattern && table[i].sizeJob == entry->sizeJob && table[i].nJob == entry->nJob) {
+      table[i] = *entry;
+      return;
+    }
+  }
+
+  if (nEntries == capacity) {
+    capacity = capacity > 0 ? capacity * 2 : 16;
+    table = realloc(table, capacity * sizeof(tuneEntry));
+  }
+
+  table[nEntries++] = *entry;
+}
+
+static int findName(const char *name, const char **names, int nNames) {
+  for (int i = 0; i < nNames; i++)
+    if (strcmp(name, names[i]) == 0)
+      return i;
+
+  return -1;
+}
+
+int tuneLoad(const char *path) {
+  FILE *file = fopen(path, "r");
+
+  if (file == NULL)
+    return -1;
+
+  tuneReset();
+
+  char line[TUNE_LINE];
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char pattern[16], schedule[16];
+    tuneEntry entry;
+
+    // Blank lines and comments
+    if (line[strspn(line, " \t\r\n")] == 0 || line[strspn(line, " \t")] == '#')
+      continue;
+
+    int nFields = sscanf(line, "%15s %zu %zu %d %15s %d %zu", pattern, &entry.sizeJob, &entry.nJob,
+                         &entry.nThreads, schedule, &entry.chunkSize, &entry.sortCutoff);
+
+    int p = findName(pattern, patternNames, sizeof(patternNames) / sizeof(patternNames[0]));
+    int s = findName(schedule, scheduleNames, sizeof(scheduleNames) / sizeof(scheduleNames[0]));
+
+    if (nFields != 7 || p < 0 || s < 0 || entry.sizeJob == 0 || entry.nThreads < 1 || entry.chunkSize < 0) {
+      fclose(file);
+      tuneReset();
+
+      errno = EINVAL;
+      return -1;
+    }
+
+    entry.pattern = (tunePattern) p;
+    entry.schedule = (patternSchedule) s;
+
+    tuneSet(&entry);
+  }
+
+  fclose(file);
+
+  return 0;
+}
+
+int tuneSave(const char *path) {
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL)
+    return -1;
+
+  fprintf(file, "# pattern sizeJob nJob nThreads schedule chunkSize sortCutoff\n");
+
+  for (size_t i = 0; i < nEntries; i++)
+    fprintf(file, "%s %zu %zu %d %s %d %zu\n", patternNames[table[i].pattern], table[i].sizeJob, table[i].nJob,
+            table[i].nThreads, scheduleNames[table[i].schedule], table[i].chunkSize, table[i].sortCutoff);
+
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+patternCtx *tuneCtx(tunePattern pattern, size_t nJob, size_t sizeJob) {
+  patternCtx *ctx = patternCtxDefault();
+  const tuneEntry *best = NULL;
+
+  /*
+   * The size class of nJob is the largest one not above it, inputs smaller than
+   * every size class take the smallest one
+  */
+
+  for (size_t i = 0; i < nEntries; i++) {
+    const tuneEntry *entry = &table[i];
+
+    if (entry->pattern != pattern || entry->sizeJob != sizeJob)
+      continue;
+
+    if (best == NULL
+        || (entry->nJob <= nJob && (best->nJob > nJob || entry->nJob > best->nJob))
+        || (entry->nJob > nJob && best->nJob > nJob && entry->nJob < best->nJob))
+      best = entry;
+  }
+
+  if (best == NULL)
+    return ctx;
+
+  // The team asked for on the command line stays the limit
+  if (best->nThreads < ctx->nThreads)
+    ctx->nThreads = best->nThreads;
+
+  ctx->schedule = best->schedule;
+  ctx->chunkSize = best->chunkSize;
+  ctx->sortCutoff = best->sortCutoff;
+
+  return ctx;
+}
+
+/*
+ *  CALIBRATION
+*/
+
+typedef struct tuneBench {
+    tunePattern pattern;
+    size_t sizeJob;
+    char *dest;
+    char *src;
+    int *keys;            // Unsorted keys of quickSort
+    void (*mapWorker)(void *v1, const void *v2);
+    void (*reduceWorker)(void *v1, const void *v2, const void *v3);
+} tuneBench;
+
+// Time of one run of the pattern, quickSort gets a fresh copy of the keys before the clock starts
+static double tuneTime(const tuneBench *bench, size_t nJob, patternCtx *ctx) {
+  if (bench->pattern == TUNE_QUICKSORT)
+    memcpy(bench->dest, bench->keys, nJob * sizeof(int));
+
+  double start = omp_get_wtime();
+
+  switch (bench->pattern) {
+    case TUNE_MAP:
+      mapCtx(bench->dest, bench->src, nJob, bench->sizeJob, bench->mapWorker, ctx);
+      break;
+    case TUNE_REDUCE:
+      reduceCtx(bench->dest, bench->src, nJob, bench->sizeJob, bench->reduceWorker, ctx);
+      break;
+    case TUNE_SCAN:
+      scanCtx(bench->dest, bench->src, nJob, bench->sizeJob, bench->reduceWorker, ctx);
+      break;
+    case TUNE_QUICKSORT:
+      quickSortCtx((int *) bench->dest, nJob, ctx);
+      break;
+  }
+
+  return omp_get_wtime() - start;
+}
+
+// Fastest of the repetitions after an untimed run that warms caches and team
+static double tuneMeasure(const tuneBench *bench, size_t nJob, patternCtx *ctx) {
+  double best = tuneTime(bench, nJob, ctx);
+
+  for (int r = 0; r < TUNE_REPETITIONS; r++) {
+    double time = tuneTime(bench, nJob, ctx);
+
+    if (time < best)
+      best = time;
+  }
+
+  return best;
+}
+
+// # candidates of a pattern for a team of at most maxThreads
+static int tuneCandidates(tunePattern pattern, int maxThreads, tuneEntry *candidates) {
+  int nCandidates = 0;
+  int nVariants = 1;
+
+  if (pattern == TUNE_MAP)
+    nVariants = sizeof(mapChunks) / sizeof(mapChunks[0]);
+  else if (pattern == TUNE_QUICKSORT)
+    nVariants = sizeof(sortCutoffs) / sizeof(sortCutoffs[0]);
+
+  // Powers of two and the whole team, from the cheapest to the largest
+  for (int nThreads = 1; ; nThreads = nThreads * 2 < maxThreads ? nThreads * 2 : maxThreads) {
+    for (int v = 0; v < nVariants; v++) {
+      tuneEntry *candidate = &candidates[nCandidates++];
+
+      candidate->pattern = pattern;
+      candidate->nThreads = nThreads;
+      candidate->schedule = pattern == TUNE_MAP ? mapSchedules[v] : SCHEDULE_STATIC;
+      candidate->chunkSize = pattern == TUNE_MAP ? mapChunks[v] : 0;
+      candidate->sortCutoff = pattern == TUNE_QUICKSORT ? sortCutoffs[v] : 0;
+    }
+
+    if (nThreads == maxThreads)
+      break;
+  }
+
+  return nCandidates;
+}
+
+static void tuneCalibrate(const tuneBench *bench, size_t maxJobs) {
+  int maxThreads = omp_get_max_threads();
+  tuneEntry candidates[64 * 4];
+
+  int nCandidates = tuneCandidates(bench->pattern, maxThreads, candidates);
+  patternCtx *ctx = patternCtxCreate(maxThreads, SCHEDULE_STATIC, 0);
+
+  for (size_t nJob = maxJobs < TUNE_MIN_JOBS ? maxJobs : TUNE_MIN_JOBS; nJob <= maxJobs; nJob *= TUNE_STEP) {
+    const tuneEntry *best = NULL;
+    double bestTime = 0;
+
+    for (int c = 0; c < nCandidates; c++) {
+      ctx->nThreads = candidates[c].nThreads;
+      ctx->schedule = candidates[c].schedule;
+      ctx->chunkSize = candidates[c].chunkSize;
+      ctx->sortCutoff = candidates[c].sortCutoff;
+
+      double time = tuneMeasure(bench, nJob, ctx);
+
+      if (best == NULL || time < bestTime * (1 - TUNE_MARGIN)) {
+        best = &candidates[c];
+        bestTime = time;
+      }
+    }
+
+    tuneEntry entry = *best;
+
+    entry.sizeJob = bench->sizeJob;
+    entry.nJob = nJob;
+
+    tuneSet(&entry);
+  }
+
+  patternCtxDestroy(ctx);
+}
+
+static void tuneBuffers(tuneBench *bench, size_t maxJobs) {
+  // Zeroed elements are valid values of every element type
+  bench->src = calloc(maxJobs, bench->sizeJob);
+  bench->dest = calloc(maxJobs, bench->sizeJob);
+  bench->keys = NULL;
+
+  if (bench->src == NULL || bench->dest == NULL) {
+    fprintf(stderr, "Could not allocate %zu elements to calibrate %s\n", maxJobs, patternNames[bench->pattern]);
+    exit(1);
+  }
+}
+
+static void tuneFree(tuneBench *bench) {
+  free(bench->src);
+  free(bench->dest);
+  free(bench->keys);
+}
+
+void tuneCalibrateMap(size_t sizeJob, size_t maxJobs, void (*worker)(void *v1, const void *v2)) {
+  assert (sizeJob > 0);
+  assert (maxJobs > 0);
+  assert (worker != NULL);
+
+  tuneBench bench = {TUNE_MAP, sizeJob, NULL, NULL, NULL, worker, NULL};
+
+  tuneBuffers(&bench, maxJobs);
+  tuneCalibrate(&bench, maxJobs);
+  tuneFree(&bench);
+}
+
+void tuneCalibrateReduce(size_t sizeJob, size_t maxJobs, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  assert (sizeJob > 0);
+  assert (maxJobs > 0);
+  assert (worker != NULL);
+
+  tuneBench bench = {TUNE_REDUCE, sizeJob, NULL, NULL, NULL, NULL, worker};
+
+  tuneBuffers(&bench, maxJobs);
+  tuneCalibrate(&bench, maxJobs);
+  tuneFree(&bench);
+}
+
+void tuneCalibrateScan(size_t sizeJob, size_t maxJobs, void (*worker)(void *v1, const void *v2, const void *v3)) {
+  assert (sizeJob > 0);
+  assert (maxJobs > 0);
+  assert (worker != NULL);
+
+  tuneBench bench = {TUNE_SCAN, sizeJob, NULL, NULL, NULL, NULL, worker};
+
+  tuneBuffers(&bench, maxJobs);
+  tuneCalibrate(&bench, maxJobs);
+  tuneFree(&bench);
+}
+
+void tuneCalibrateQuickSort(size_t maxJobs) {
+  assert (maxJobs > 0);
+
+  tuneBench bench = {TUNE_QUICKSORT, sizeof(int), NULL, NULL, NULL, NULL, NULL};
+  unsigned int seed = 1;
+
+  tuneBuffers(&bench, maxJobs);
+  bench.keys = malloc(maxJobs * sizeof(int));
+
+  // Same keys on every run, without touching the random state of the caller
+  for (size_t i = 0; i < maxJobs; i++)
+    bench.keys[i] = rand_r(&seed);
+
+  tuneCalibrate(&bench, maxJobs);
+  tuneFree(&bench);
+}
@@ -0,0 +1,85 @@
+#ifndef __TUNE_H
+#define __TUNE_H
+
+#include <stddef.h>
+#include "context.h"
+
+/*
+ * Auto-tuner - times the patterns on the current machine for every element size and a
+ * ladder of input sizes, then keeps the team, schedule and cutoffs that ran fastest.
+ * The plain patterns take their context from the tuned size class the input falls in,
+ * so small inputs run on a few threads, or serially, instead of the whole team.
+ * The table is process wide, load or calibrate it before any pattern runs.
+ */
+
+// Smallest size class the calibration times
+#define TUNE_MIN_JOBS 64
+
+// Ratio between consecutive size classes
+#define TUNE_STEP 4
+
+typedef enum tunePattern {
+    TUNE_MAP,
+    TUNE_REDUCE,
+    TUNE_SCAN,
+    TUNE_QUICKSORT
+} tunePattern;
+
+// Settings of one size class, they hold from nJob up to the next size class
+typedef struct tuneEntry {
+    tunePattern pattern;        // Pattern the settings apply to
+    size_t sizeJob;             // Size of each element
+    size_t nJob;                // Smallest # elements of the size class
+    int nThreads;               // # threads, 1 runs the pattern serially
+    patternSchedule schedule;   // Schedule of the element wise loops
+    int chunkSize;              // Grain of the schedule, 0 for the OpenMP default
+    size_t sortCutoff;          // # elements below which quickSort stops making tasks, 0 for the default
+} tuneEntry;
+
+// Forgets every size class, the patterns go back to the default context
+void tuneReset(void);
+
+// Adds a size class, replacing the one of the same pattern, element size and nJob
+void tuneSet(const tuneEntry *entry);
+
+// Replaces the table with the one of a tuning file, 0 on success and -1 on failure
+int tuneLoad(const char *path);
+
+// Writes the table to a tuning file, 0 on success and -1 on failure
+int tuneSave(const char *path);
+
+/*
+ * Calibration - every size class from TUNE_MIN_JOBS to maxJobs in steps of TUNE_STEP
+ * is timed with each candidate, a candidate with more threads or a finer grain has to
+ * be clearly faster to be kept
+ */
+void tuneCalibrateMap(
+    size_t sizeJob,       // Size of each element
+    size_t maxJobs,       // # elements of the largest size class
+    void (*worker)(void *v1, const void *v2) // [ v1 = op (v2) ]
+);
+
+void tuneCalibrateReduce(
+    size_t sizeJob,       // Size of each element
+    size_t maxJobs,       // # elements of the largest size class
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+void tuneCalibrateScan(
+    size_t sizeJob,       // Size of each element
+    size_t maxJobs,       // # elements of the largest size class
+    void (*worker)(void *v1, const void *v2, const void *v3) // [ v1 = op (v2, v3) ]
+);
+
+void tuneCalibrateQuickSort(
+    size_t maxJobs        // # elements of the largest size class
+);
+
+// Default context with the settings of the size class of nJob, unchanged when nothing was tuned
+patternCtx *tuneCtx(
+    tunePattern pattern,  // Pattern about to run
+    size_t nJob,          // # elements in the source array
+    size_t sizeJob        // Size of each element in the source array
+);
+
+#endif
@@ -0,0 +1,240 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <assert.h>
+#include <omp.h>
+#include "typed.h"
+
+// Leaf block of the compensated sums when the caller does not set one
+#define COMPENSATED_SUM_BLOCK 1024
+
+// Rounding error of t = a + b, exact in the floating point type of the operands
+#define TYPED_SUM_ERROR(a, b, t) (fabs(a) >= fabs(b) ? ((a) - (t)) + (b) : ((b) - (t)) + (a))
+
+/*
+ *  UTILS
+*/
+int typedTileCount(size_t nJob) {
+  size_t nThreads = omp_get_max_threads();
+
+  return (int) (nJob < nThreads ? nJob : nThreads);
+}
+
+size_t typedTileIndex(int tile, int leftOverTiles, size_t tileSize) {
+  return tile < leftOverTiles
+         ? tile * (tileSize + 1)
+         : leftOverTiles * (tileSize + 1) + (tile - leftOverTiles) * tileSize;
+}
+
+/*
+ * Map and stencil loops are written once for every operator,
+ * the switch on the operator happens outside the loop
+*/
+#define TYPED_MAP_LOOP(OPFN)                                                  \
+  TYPED_PRAGMA(omp parallel for simd schedule(static))                        \
+  for (size_t i = 0; i < nJob; i++)                                           \
+    dest[i] = OPFN(src[i], operand);
+
+#define TYPED_STENCIL_LOOP(T, OPFN, IDENTITY)                                 \
+  TYPED_PRAGMA(omp parallel for schedule(static))                             \
+  for (size_t i = 0; i < nJob; i++) {                                         \
+    size_t first = i < (size_t) nShift ? 0 : i - nShift;                      \
+    size_t last = i + nShift < nJob ? i + nShift : nJob - 1;                  \
+    T acc = (IDENTITY);                                                       \
+    for (size_t j = first; j <= last; j++)                                    \
+      acc = OPFN(acc, src[j]);                                                \
+    dest[i] = acc;                                                            \
+  }
+
+/*
+ * Generates the kernels and the enum based entry points for one type
+*/
+#define DEFINE_TYPED_PATTERNS(SUFFIX, T, MIN_VALUE, MAX_VALUE)                \
+DEFINE_REDUCE_KERNEL(typedReduceAdd##SUFFIX, T, TYPED_ADD, 0)                 \
+DEFINE_REDUCE_KERNEL(typedReduceMul##SUFFIX, T, TYPED_MUL, 1)                 \
+DEFINE_REDUCE_KERNEL(typedReduceMin##SUFFIX, T, TYPED_MIN, MAX_VALUE)         \
+DEFINE_REDUCE_KERNEL(typedReduceMax##SUFFIX, T, TYPED_MAX, MIN_VALUE)         \
+                                                                              \
+DEFINE_SCAN_KERNEL(typedScanAdd##SUFFIX, T, TYPED_ADD, 0)                     \
+DEFINE_SCAN_KERNEL(typedScanMul##SUFFIX, T, TYPED_MUL, 1)                     \
+DEFINE_SCAN_KERNEL(typedScanMin##SUFFIX, T, TYPED_MIN, MAX_VALUE)             \
+DEFINE_SCAN_KERNEL(typedScanMax##SUFFIX, T, TYPED_MAX, MIN_VALUE)             \
+                                                                              \
+static T identity##SUFFIX(patternOp op) {                                     \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      return 0;                                                               \
+    case OP_MUL:                                                              \
+      return 1;                                                               \
+    case OP_MIN:                                                              \
+      return MAX_VALUE;                                                       \
+    default:                                                                  \
+      return MIN_VALUE;                                                       \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+void mapOp##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, T operand) { \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+                                                                              \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      TYPED_MAP_LOOP(TYPED_ADD)                                               \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      TYPED_MAP_LOOP(TYPED_MUL)                                               \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      TYPED_MAP_LOOP(TYPED_MIN)                                               \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      TYPED_MAP_LOOP(TYPED_MAX)                                               \
+      break;                                                                  \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+void reduceOp##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op) {     \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+                                                                              \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      *dest = typedReduceAdd##SUFFIX(src, nJob);                              \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      *dest = typedReduceMul##SUFFIX(src, nJob);                              \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      *dest = typedReduceMin##SUFFIX(src, nJob);                              \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      *dest = typedReduceMax##SUFFIX(src, nJob);                              \
+      break;                                                                  \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+void scanOp##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op) {       \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+                                                                              \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      typedScanAdd##SUFFIX(dest, src, nJob);                                  \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      typedScanMul##SUFFIX(dest, src, nJob);                                  \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      typedScanMin##SUFFIX(dest, src, nJob);                                  \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      typedScanMax##SUFFIX(dest, src, nJob);                                  \
+      break;                                                                  \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+void exclusiveScanOp##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op) { \
+  if (nJob == 0)                                                              \
+    return;                                                                   \
+                                                                              \
+  dest[0] = identity##SUFFIX(op);                                             \
+  scanOp##SUFFIX(&dest[1], src, nJob - 1, op);                                \
+}                                                                             \
+                                                                              \
+void stencilOp##SUFFIX(T *dest, const T *src, size_t nJob, patternOp op, int nShift) { \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+  assert (nShift >= 0);                                                       \
+                                                                              \
+  switch (op) {                                                               \
+    case OP_ADD:                                                              \
+      TYPED_STENCIL_LOOP(T, TYPED_ADD, 0)                                     \
+      break;                                                                  \
+    case OP_MUL:                                                              \
+      TYPED_STENCIL_LOOP(T, TYPED_MUL, 1)                                     \
+      break;                                                                  \
+    case OP_MIN:                                                              \
+      TYPED_STENCIL_LOOP(T, TYPED_MIN, MAX_VALUE)                             \
+      break;                                                                  \
+    case OP_MAX:                                                              \
+      TYPED_STENCIL_LOOP(T, TYPED_MAX, MIN_VALUE)                             \
+      break;                                                                  \
+  }                                                                           \
+}
+
+DEFINE_TYPED_PATTERNS(Int, int, INT_MIN, INT_MAX)
+
+DEFINE_TYPED_PATTERNS(Float, float, -INFINITY, INFINITY)
+
+DEFINE_TYPED_PATTERNS(Double, double, -INFINITY, INFINITY)
+
+DEFINE_TYPED_PATTERNS(Int64, int64_t, INT64_MIN, INT64_MAX)
+
+/*
+ * Running sum and the rounding error lost by it, the error is only added back at the end
+*/
+#define DEFINE_COMPENSATED_SUM(SUFFIX, T)                                     \
+typedef struct compensated##SUFFIX {                                          \
+    T sum;                                                                    \
+    T error;                                                                  \
+} compensated##SUFFIX;                                                        \
+                                                                              \
+static void compensatedAdd##SUFFIX(compensated##SUFFIX *acc, T value, T error) { \
+  T t = acc->sum + value;                                                     \
+  acc->error += error + TYPED_SUM_ERROR(acc->sum, value, t);                  \
+  acc->sum = t;                                                               \
+}                                                                             \
+                                                                              \
+void compensatedSum##SUFFIX(T *dest, const T *src, size_t nJob, size_t blockSize) { \
+  assert (dest != NULL);                                                      \
+  assert (src != NULL);                                                       \
+                                                                              \
+  *dest = 0;                                                                  \
+                                                                              \
+  if (nJob == 0)                                                              \
+    return;                                                                   \
+                                                                              \
+  if (blockSize == 0)                                                         \
+    blockSize = COMPENSATED_SUM_BLOCK;                                        \
+                                                                              \
+  size_t nBlocks = (nJob + blockSize - 1) / blockSize;                        \
+  compensated##SUFFIX *partial = malloc(nBlocks * sizeof(compensated##SUFFIX)); \
+                                                                              \
+  TYPED_PRAGMA(omp parallel num_threads(typedTileCount(nBlocks)))             \
+  {                                                                           \
+    size_t nThreads = omp_get_num_threads();                                  \
+                                                                              \
+    TYPED_PRAGMA(omp for schedule(static))                                    \
+    for (size_t block = 0; block < nBlocks; block++) {                        \
+      size_t last = (block + 1) * blockSize < nJob ? (block + 1) * blockSize : nJob; \
+      compensated##SUFFIX acc = {0, 0};                                       \
+                                                                              \
+      for (size_t i = block * blockSize; i < last; i++)                       \
+        compensatedAdd##SUFFIX(&acc, src[i], 0);                              \
+                                                                              \
+      partial[block] = acc;                                                   \
+    }                                                                         \
+                                                                              \
+    for (size_t stride = 1; stride < nBlocks; stride *= 2) {                  \
+      size_t nPairs = (nBlocks + stride - 1) / (2 * stride);                  \
+                                                                              \
+      if (nPairs >= nThreads) {                                               \
+        TYPED_PRAGMA(omp for schedule(static))                                \
+        for (size_t pair = 0; pair < nPairs; pair++)                          \
+          compensatedAdd##SUFFIX(&partial[2 * pair * stride], partial[(2 * pair + 1) * stride].sum, partial[(2 * pair + 1) * stride].error); \
+      } else {                                                                \
+        TYPED_PRAGMA(omp single)                                              \
+        for (size_t pair = 0; pair < nPairs; pair++)                          \
+          compensatedAdd##SUFFIX(&partial[2 * pair * stride], partial[(2 * pair + 1) * stride].sum, partial[(2 * pair + 1) * stride].error); \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  *dest = partial[0].sum + partial[0].error;                                  \
+                                                                              \
+  free(partial);                                                              \
+}
+
+DEFINE_COMPENSATED_SUM(Float, float)
+
+DEFINE_COMPENSATED_SUM(Double, double)
@@ -0,0 +1,164 @@
+#ifndef __TYPED_H
+#define __TYPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <omp.h>
+
+/*
+ * Type-specialized fast paths for map, reduce, scan and stencil.
+ * The generic void* patterns call the worker through a pointer once per element,
+ * which the compiler can neither inline nor vectorize. These kernels take the
+ * operator at compile time (DEFINE_*_KERNEL) or as a small built-in enum, so the
+ * inner loops become plain typed loops the compiler can vectorize.
+ */
+
+// Built-in operators
+typedef enum patternOp {
+    OP_ADD,
+    OP_MIN,
+    OP_MAX,
+    OP_MUL
+} patternOp;
+
+// Built-in operators, kept as macros so every loop over them is fully inlined
+#define TYPED_ADD(a, b) ((a) + (b))
+#define TYPED_MUL(a, b) ((a) * (b))
+#define TYPED_MIN(a, b) ((b) < (a) ? (b) : (a))
+#define TYPED_MAX(a, b) ((b) > (a) ? (b) : (a))
+
+#define TYPED_STR(x) #x
+#define TYPED_PRAGMA(x) _Pragma(TYPED_STR(x))
+
+/*
+ * Kernel generators - OPFN must be an inlinable function or macro, T OPFN(T a) for map and
+ * T OPFN(T a, T b) for reduce and scan, where it also has to be associative and commutative.
+ * IDENTITY is the neutral element of OPFN.
+ */
+
+// void NAME(T *dest, const T *src, size_t nJob) - [ dest[i] = OPFN (src[i]) ]
+#define DEFINE_MAP_KERNEL(NAME, T, OPFN)                                      \
+void NAME(T *dest, const T *src, size_t nJob) {                               \
+  TYPED_PRAGMA(omp parallel for simd schedule(static))                        \
+  for (size_t i = 0; i < nJob; i++)                                           \
+    dest[i] = OPFN(src[i]);                                                   \
+}
+
+// T NAME(const T *src, size_t nJob) - [ IDENTITY op src[0] op ... op src[n - 1] ]
+#define DEFINE_REDUCE_KERNEL(NAME, T, OPFN, IDENTITY)                         \
+TYPED_PRAGMA(omp declare reduction(NAME##Red : T :                            \
+  omp_out = OPFN(omp_out, omp_in)) initializer(omp_priv = (IDENTITY)))        \
+T NAME(const T *src, size_t nJob) {                                           \
+  T acc = (IDENTITY);                                                         \
+  TYPED_PRAGMA(omp parallel for simd schedule(static) reduction(NAME##Red : acc)) \
+  for (size_t i = 0; i < nJob; i++)                                           \
+    acc = OPFN(acc, src[i]);                                                  \
+  return acc;                                                                 \
+}
+
+// void NAME(T *dest, const T *src, size_t nJob) - inclusive scan with OPFN
+// Two passes over one tile per thread: tile reduction, then tile scan seeded with the
+// reduction of the previous tiles
+#define DEFINE_SCAN_KERNEL(NAME, T, OPFN, IDENTITY)                           \
+TYPED_PRAGMA(omp declare reduction(NAME##Red : T :                            \
+  omp_out = OPFN(omp_out, omp_in)) initializer(omp_priv = (IDENTITY)))        \
+void NAME(T *dest, const T *src, size_t nJob) {                               \
+  if (nJob == 0)                                                              \
+    return;                                                                   \
+  int maxTiles = typedTileCount(nJob);                                        \
+  T carry[maxTiles];                                                          \
+  TYPED_PRAGMA(omp parallel num_threads(maxTiles))                            \
+  {                                                                           \
+    int nTiles = omp_get_num_threads();                                       \
+    int tile = omp_get_thread_num();                                          \
+    size_t tileSize = nJob / nTiles;                                          \
+    int leftOverJobs = (int) (nJob % nTiles);                                 \
+    size_t first = typedTileIndex(tile, leftOverJobs, tileSize);              \
+    size_t last = first + tileSize + (tile < leftOverJobs ? 1 : 0);           \
+    T acc = (IDENTITY);                                                       \
+    TYPED_PRAGMA(omp simd reduction(NAME##Red : acc))                         \
+    for (size_t i = first; i < last; i++)                                     \
+      acc = OPFN(acc, src[i]);                                                \
+    carry[tile] = acc;                                                        \
+    TYPED_PRAGMA(omp barrier)                                                 \
+    T prefix = (IDENTITY);                                                    \
+    for (int t = 0; t < tile; t++)                                            \
+      prefix = OPFN(prefix, carry[t]);                                        \
+    for (size_t i = first; i < last; i++)                                     \
+      dest[i] = prefix = OPFN(prefix, src[i]);                                \
+  }                                                                           \
+}
+
+// Helpers used by the generators
+int typedTileCount(size_t nJob);
+
+size_t typedTileIndex(int tile, int leftOverTiles, size_t tileSize);
+
+/*
+ * Built-in kernels, one set for each supported type
+ * Reducing zero elements returns the identity of the operator
+ */
+#define DECLARE_TYPED_PATTERNS(SUFFIX, T)                                     \
+void mapOp##SUFFIX(                                                           \
+    T *dest,              /* Target array */                                  \
+    const T *src,         /* Source array */                                  \
+    size_t nJob,          /* # elements in the source array */                \
+    patternOp op,         /* [ dest[i] = op (src[i], operand) ] */            \
+    T operand             /* Right hand side of the operator */               \
+);                                                                            \
+                                                                              \
+void reduceOp##SUFFIX(                                                        \
+    T *dest,              /* Target value */                                  \
+    const T *src,         /* Source array */                                  \
+    size_t nJob,          /* # elements in the source array */                \
+    patternOp op          /* [ dest = op (src[0], ..., src[n - 1]) ] */       \
+);                                                                            \
+                                                                              \
+void scanOp##SUFFIX(                                                          \
+    T *dest,              /* Target array */                                  \
+    const T *src,         /* Source array */                                  \
+    size_t nJob,          /* # elements in the source array */                \
+    patternOp op          /* Inclusive scan operator */                       \
+);                                                                            \
+                                                                              \
+void exclusiveScanOp##SUFFIX(                                                 \
+    T *dest,              /* Target array, dest[0] is the identity */         \
+    const T *src,         /* Source array */                                  \
+    size_t nJob,          /* # elements in the source array */                \
+    patternOp op          /* Exclusive scan operator */                       \
+);                                                                            \
+                                                                              \
+void stencilOp##SUFFIX(                                                       \
+    T *dest,              /* Target array */                                  \
+    const T *src,         /* Source array */                                  \
+    size_t nJob,          /* # elements in the source array */                \
+    patternOp op,         /* Operator applied across the window */            \
+    int nShift            /* stencil shift */                                 \
+);
+
+DECLARE_TYPED_PATTERNS(Int, int)
+
+DECLARE_TYPED_PATTERNS(Float, float)
+
+DECLARE_TYPED_PATTERNS(Double, double)
+
+DECLARE_TYPED_PATTERNS(Int64, int64_t)
+
+/*
+ * Compensated sums for the floating point types - Neumaier summation over fixed
+ * blocks combined by a pairwise tree. The blocks do not depend on the team, so the
+ * result is bitwise identical for any # threads
+ */
+#define DECLARE_COMPENSATED_SUM(SUFFIX, T)                                    \
+void compensatedSum##SUFFIX(                                                  \
+    T *dest,              /* Target value */                                  \
+    const T *src,         /* Source array */                                  \
+    size_t nJob,          /* # elements in the source array */                \
+    size_t blockSize      /* Elements of each block, 0 for the default */     \
+);
+
+DECLARE_COMPENSATED_SUM(Float, float)
+
+DECLARE_COMPENSATED_SUM(Double, double)
+
+#endif
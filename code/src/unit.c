@@ -3,7 +3,22 @@
 #include <time.h>
 #include <omp.h>
 #include "patterns.h"
+#include "typed.h"
+#include "stream.h"
+#include "sort.h"
+#include "stencil.h"
+#include "placement.h"
+#include "outofcore.h"
+#include "offload.h"
+#include "async.h"
+#include "tune.h"
+
+#ifdef PATTERNS_MPI
+#include "distributed.h"
+#endif
 #include <errno.h>
+#include <limits.h>
+#include <inttypes.h>
 
 #include "debug.h"
 #include "args.h"
@@ -13,6 +28,9 @@
 
 int WEIGHTED_MODE = 0;
 int ITERATIONS = 0;
+const char *OUTPUT_FILE = NULL;
+const char *ELEMENT_NAME = "double";
+size_t ELEMENT_WIDTH = sizeof(double);
 
 // This allows workers to simulate work
 void addWeight() {
@@ -43,69 +61,358 @@ static void workerMin(void* a, const void* b, const void* c) {
 }
 */
 
-static void workerAdd(void *a, const void *b, const void *c) {
-  // a = b + c
-  *(TYPE *) a = *(TYPE *) b + *(TYPE *) c;
+// Records wider than their value carry the rest of the source record along
+static inline void copyPayload(void *a, const void *b, size_t valueSize) {
+  if (ELEMENT_WIDTH > valueSize && a != b)
+    memcpy((char *) a + valueSize, (const char *) b + valueSize, ELEMENT_WIDTH - valueSize);
+}
+
+// Batch workers get their configuration from ctx instead of global state
+typedef struct workerCtx {
+    int weighted;
+} workerCtx;
 
-  addWeight();
+static void addBatchWeight(const workerCtx *ctx, size_t count) {
+  if (ctx->weighted)
+    for (size_t i = 0; i < count * SLEEP_WEIGHT; i++)
+      (void) i;
 }
 
 /*
-static void workerSubtract(void* a, const void* b, const void* c) {
-    // a = n - c
-    *(TYPE *)a = *(TYPE *)b - *(TYPE *)c;
+ * Workers of every element type - they work on the value at the start of each
+ * element and copy the payload of records from their first source
+ */
+// U is the type sums are done in, unsigned for the integers so the growing hyperplane wraps
+#define DEFINE_UNIT_WORKERS(SUFFIX, T, U, FORMAT)                             \
+static void set##SUFFIX(void *a, double value) {                              \
+  *(T *) a = (T) value;                                                       \
+}                                                                             \
+                                                                              \
+static void printValue##SUFFIX(const void *a) {                               \
+  printf(FORMAT, *(const T *) a);                                             \
+}                                                                             \
+                                                                              \
+static void workerAdd##SUFFIX(void *a, const void *b, const void *c) {        \
+  /* a = b + c */                                                             \
+  *(T *) a = (T) ((U) *(const T *) b + (U) *(const T *) c);                   \
+  copyPayload(a, b, sizeof(T));                                               \
+                                                                              \
+  addWeight();                                                                \
+}                                                                             \
+                                                                              \
+static void workerAddOne##SUFFIX(void *a, const void *b) {                    \
+  /* a = b + 1 */                                                             \
+  *(T *) a = *(const T *) b + 1;                                              \
+  copyPayload(a, b, sizeof(T));                                               \
+                                                                              \
+  addWeight();                                                                \
+}                                                                             \
+                                                                              \
+static void workerAccum##SUFFIX(void *a, const void *b) {                     \
+  /* a += b */                                                                \
+  *(T *) a += *(const T *) b;                                                 \
+                                                                              \
+  addWeight();                                                                \
+}                                                                             \
+                                                                              \
+static void workerSubtract##SUFFIX(void *a, const void *b) {                  \
+  /* a -= b */                                                                \
+  *(T *) a -= *(const T *) b;                                                 \
+                                                                              \
+  addWeight();                                                                \
+}                                                                             \
+                                                                              \
+static void workerMultTwo##SUFFIX(void *a, const void *b) {                   \
+  /* a = b * 2 */                                                             \
+  *(T *) a = *(const T *) b * 2;                                              \
+  copyPayload(a, b, sizeof(T));                                               \
+                                                                              \
+  addWeight();                                                                \
+}                                                                             \
+                                                                              \
+static void workerDivTwo##SUFFIX(void *a, const void *b) {                    \
+  /* a = b / 2 */                                                             \
+  *(T *) a = *(const T *) b / 2;                                              \
+  copyPayload(a, b, sizeof(T));                                               \
+                                                                              \
+  addWeight();                                                                \
+}                                                                             \
+                                                                              \
+static void workerHeat##SUFFIX(void *a, const stencilCell *cell, void *ctx) { \
+  (void) ctx;                                                                 \
+                                                                              \
+  /* a = average of the cell and its four neighbours */                       \
+  *(T *) a = (*(const T *) STENCIL_AT(cell, 0, 0, 0)                          \
+              + *(const T *) STENCIL_AT(cell, -1, 0, 0) + *(const T *) STENCIL_AT(cell, 1, 0, 0) \
+              + *(const T *) STENCIL_AT(cell, 0, -1, 0) + *(const T *) STENCIL_AT(cell, 0, 1, 0)) / 5; \
+  copyPayload(a, cell->center, sizeof(T));                                    \
+                                                                              \
+  addWeight();                                                                \
+}                                                                             \
+                                                                              \
+static int predicateAboveFour##SUFFIX(const void *a) {                        \
+  /* keep a > 4 */                                                            \
+  return *(const T *) a > 4;                                                  \
+}                                                                             \
+                                                                              \
+static int compare##SUFFIX(const void *a, const void *b) {                    \
+  T x = *(const T *) a;                                                       \
+  T y = *(const T *) b;                                                       \
+                                                                              \
+  return (x > y) - (x < y);                                                   \
+}                                                                             \
+                                                                              \
+static void batchAddOne##SUFFIX(void *a, const void *b, size_t count, size_t stride, void *ctx) { \
+  /* a[i] = b[i] + 1 */                                                       \
+  char *d = a;                                                                \
+  const char *s = b;                                                          \
+                                                                              \
+  for (size_t i = 0; i < count; i++) {                                        \
+    *(T *) &d[i * stride] = *(const T *) &s[i * stride] + 1;                  \
+    copyPayload(&d[i * stride], &s[i * stride], sizeof(T));                   \
+  }                                                                           \
+                                                                              \
+  addBatchWeight(ctx, count);                                                 \
+}                                                                             \
+                                                                              \
+static void batchMultTwo##SUFFIX(void *a, const void *b, size_t count, size_t stride, void *ctx) { \
+  /* a[i] = b[i] * 2 */                                                       \
+  char *d = a;                                                                \
+  const char *s = b;                                                          \
+                                                                              \
+  for (size_t i = 0; i < count; i++) {                                        \
+    *(T *) &d[i * stride] = *(const T *) &s[i * stride] * 2;                  \
+    copyPayload(&d[i * stride], &s[i * stride], sizeof(T));                   \
+  }                                                                           \
+                                                                              \
+  addBatchWeight(ctx, count);                                                 \
+}                                                                             \
+                                                                              \
+static void batchDivTwo##SUFFIX(void *a, const void *b, size_t count, size_t stride, void *ctx) { \
+  /* a[i] = b[i] / 2 */                                                       \
+  char *d = a;                                                                \
+  const char *s = b;                                                          \
+                                                                              \
+  for (size_t i = 0; i < count; i++) {                                        \
+    *(T *) &d[i * stride] = *(const T *) &s[i * stride] / 2;                  \
+    copyPayload(&d[i * stride], &s[i * stride], sizeof(T));                   \
+  }                                                                           \
+                                                                              \
+  addBatchWeight(ctx, count);                                                 \
+}
 
-    addWeight();
+// Typed kernels, they take plain arrays of the value so they only run without a payload
+#define DEFINE_UNIT_TYPED(SUFFIX, T)                                          \
+static inline T addOne##SUFFIX(T a) {                                         \
+  return a + 1;                                                               \
+}                                                                             \
+                                                                              \
+static DEFINE_MAP_KERNEL(mapAddOne##SUFFIX, T, addOne##SUFFIX)                \
+                                                                              \
+static void typedMap##SUFFIX(void *dest, const void *src, size_t nJob) {      \
+  mapAddOne##SUFFIX(dest, src, nJob);                                         \
+}                                                                             \
+                                                                              \
+static void typedReduce##SUFFIX(void *dest, const void *src, size_t nJob) {   \
+  reduceOp##SUFFIX(dest, src, nJob, OP_ADD);                                  \
+}                                                                             \
+                                                                              \
+static void typedScan##SUFFIX(void *dest, const void *src, size_t nJob) {     \
+  scanOp##SUFFIX(dest, src, nJob, OP_ADD);                                    \
+}                                                                             \
+                                                                              \
+static void typedStencil##SUFFIX(void *dest, const void *src, size_t nJob, int nShift) { \
+  stencilOp##SUFFIX(dest, src, nJob, OP_ADD, nShift);                         \
+}                                                                             \
+                                                                              \
+static void offloadMap##SUFFIX(void *dest, const void *src, size_t nJob) {    \
+  mapOffload##SUFFIX(dest, src, nJob, OP_ADD, 1);                             \
+}                                                                             \
+                                                                              \
+static void offloadScan##SUFFIX(void *dest, const void *src, size_t nJob) {   \
+  scanOffload##SUFFIX(dest, src, nJob, OP_ADD);                               \
+}                                                                             \
+                                                                              \
+/* Map then scan, the mapped values never leave the device */                 \
+static void offloadChain##SUFFIX(void *dest, const void *src, size_t nJob) {  \
+  offloadBuffer buffer;                                                       \
+                                                                              \
+  if (offloadAlloc(&buffer, nJob * sizeof(T), offloadTarget(patternCtxDefault())) != 0 \
+      || offloadUpload(&buffer, src, nJob * sizeof(T)) != 0) {                \
+    fprintf(stderr, "Could not copy the source to the device\n");             \
+    exit(1);                                                                  \
+  }                                                                           \
+                                                                              \
+  mapBuffer##SUFFIX(&buffer, &buffer, nJob, OP_ADD, 1);                       \
+  scanBuffer##SUFFIX(&buffer, &buffer, nJob, OP_ADD);                         \
+                                                                              \
+  if (offloadDownload(dest, &buffer, nJob * sizeof(T)) != 0) {                \
+    fprintf(stderr, "Could not copy the result from the device\n");           \
+    exit(1);                                                                  \
+  }                                                                           \
+                                                                              \
+  offloadFree(&buffer);                                                       \
 }
-*/
 
-/*
-static void workerMultiply(void* a, const void* b, const void* c) {
-    // a = b * c
-    *(TYPE *)a = *(TYPE *)b + *(TYPE *)c;
+#define DEFINE_UNIT_COMPENSATED(SUFFIX)                                       \
+static void compensated##SUFFIX(void *dest, const void *src, size_t nJob) {   \
+  compensatedSum##SUFFIX(dest, src, nJob, 0);                                 \
+}
+
+DEFINE_UNIT_WORKERS(Char, char, unsigned char, "%d")
+DEFINE_UNIT_WORKERS(Int, int, unsigned int, "%d")
+DEFINE_UNIT_WORKERS(Int64, int64_t, uint64_t, "%" PRId64)
+DEFINE_UNIT_WORKERS(Float, float, float, "%.1f")
+DEFINE_UNIT_WORKERS(Double, double, double, "%.1lf")
+
+DEFINE_UNIT_TYPED(Int, int)
+DEFINE_UNIT_TYPED(Int64, int64_t)
+DEFINE_UNIT_TYPED(Float, float)
+DEFINE_UNIT_TYPED(Double, double)
+
+DEFINE_UNIT_COMPENSATED(Float)
+DEFINE_UNIT_COMPENSATED(Double)
+
+// Workers and kernels of one element type, kernels are NULL where the type has none
+typedef struct unitElement {
+    const char *name;
+    size_t size;                    // Size of the value at the start of every element
+    double range;                   // Random values are drawn from [0, range)
+    void (*set)(void *a, double value);
+    void (*print)(const void *a);
+    void (*add)(void *a, const void *b, const void *c);
+    void (*addOne)(void *a, const void *b);
+    void (*accum)(void *a, const void *b);
+    void (*subtract)(void *a, const void *b);
+    void (*multTwo)(void *a, const void *b);
+    void (*divTwo)(void *a, const void *b);
+    gridWorker heat;
+    int (*aboveFour)(const void *a);
+    sortCompare compare;
+    batchWorker batchAddOne;
+    batchWorker batchMultTwo;
+    batchWorker batchDivTwo;
+    void (*typedMap)(void *dest, const void *src, size_t nJob);
+    void (*typedReduce)(void *dest, const void *src, size_t nJob);
+    void (*typedScan)(void *dest, const void *src, size_t nJob);
+    void (*typedStencil)(void *dest, const void *src, size_t nJob, int nShift);
+    void (*offloadMap)(void *dest, const void *src, size_t nJob);
+    void (*offloadScan)(void *dest, const void *src, size_t nJob);
+    void (*offloadChain)(void *dest, const void *src, size_t nJob);
+    void (*compensatedSum)(void *dest, const void *src, size_t nJob);
+} unitElement;
+
+#define UNIT_WORKERS(SUFFIX)                                                  \
+    set##SUFFIX, printValue##SUFFIX, workerAdd##SUFFIX, workerAddOne##SUFFIX, \
+    workerAccum##SUFFIX, workerSubtract##SUFFIX, workerMultTwo##SUFFIX,       \
+    workerDivTwo##SUFFIX, workerHeat##SUFFIX, predicateAboveFour##SUFFIX,     \
+    compare##SUFFIX, batchAddOne##SUFFIX, batchMultTwo##SUFFIX, batchDivTwo##SUFFIX
+
+#define UNIT_TYPED(SUFFIX)                                                    \
+    typedMap##SUFFIX, typedReduce##SUFFIX, typedScan##SUFFIX, typedStencil##SUFFIX, \
+    offloadMap##SUFFIX, offloadScan##SUFFIX, offloadChain##SUFFIX
+
+static const unitElement elements[] = {
+    {"char", sizeof(char), CHAR_MAX, UNIT_WORKERS(Char), NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+    {"int", sizeof(int), 10, UNIT_WORKERS(Int), UNIT_TYPED(Int), NULL},
+    {"int64", sizeof(int64_t), 10, UNIT_WORKERS(Int64), UNIT_TYPED(Int64), NULL},
+    {"float", sizeof(float), 10, UNIT_WORKERS(Float), UNIT_TYPED(Float), compensatedFloat},
+    {"double", sizeof(double), 10, UNIT_WORKERS(Double), UNIT_TYPED(Double), compensatedDouble}
+};
+
+static const unitElement *ELEMENT = &elements[4];
 
-        addWeight();
+static const unitElement *findElement(const char *name) {
+  for (size_t i = 0; i < sizeof(elements) / sizeof(elements[0]); i++)
+    if (strcmp(elements[i].name, name) == 0)
+      return &elements[i];
+
+  return NULL;
 }
-*/
 
-static void workerAddOne(void *a, const void *b) {
-  // a = b + 1
-  *(TYPE *) a = *(TYPE *) b + 1;
+size_t unitElementSize(const char *name) {
+  const unitElement *element = findElement(name);
 
-  addWeight();
+  return element != NULL ? element->size : 0;
 }
 
-static void workerAccum(void *a, const void *b) {
-  // a += b
-  *(TYPE *) a += *(TYPE *) b;
+int unitSetElement(const char *name, size_t width) {
+  const unitElement *element = findElement(name);
+
+  if (element == NULL)
+    return -1;
+
+  if (width == 0)
+    width = element->size;
+
+  // Every value has to stay aligned in an array of records
+  if (width < element->size || width % element->size != 0)
+    return -1;
+
+  ELEMENT = element;
+  ELEMENT_NAME = element->name;
+  ELEMENT_WIDTH = width;
 
-  addWeight();
+  return 0;
 }
 
-static void workerMultTwo(void *a, const void *b) {
-  // a = b * 2
-  *(TYPE *) a = *(TYPE *) b * 2;
+void unitRandomElement(void *a) {
+  memset(a, 0, ELEMENT_WIDTH);
+  ELEMENT->set(a, (int) (drand48() * ELEMENT->range));
+}
 
-  addWeight();
+void unitPrintElement(const void *a) {
+  ELEMENT->print(a);
 }
 
-static void workerDivTwo(void *a, const void *b) {
-  // a = b / 2
-  *(TYPE *) a = *(TYPE *) b / 2;
+// Same workers as the tests, so the tuned settings match the cost of their elements
+void unitCalibrate(size_t maxJobs) {
+  tuneCalibrateMap(ELEMENT_WIDTH, maxJobs, ELEMENT->addOne);
+  tuneCalibrateReduce(ELEMENT_WIDTH, maxJobs, ELEMENT->add);
+  tuneCalibrateScan(ELEMENT_WIDTH, maxJobs, ELEMENT->add);
+  tuneCalibrateQuickSort(maxJobs);
+}
 
-  addWeight();
+// Typed kernels only exist for some types and never for records
+static void requireKernel(int available, const char *test) {
+  if (!available || ELEMENT_WIDTH != ELEMENT->size) {
+    fprintf(stderr, "%s: no typed kernel for %s elements of %zu bytes\n", test, ELEMENT->name, ELEMENT_WIDTH);
+    exit(1);
+  }
 }
 
 //=======================================================
 // Unit testing funtions
 //=======================================================
 
+// Destination of the out-of-core tests, the output file when one was given
+static char *openOutput(mappedFile *file, size_t n, size_t size) {
+  file->data = NULL;
+
+  if (OUTPUT_FILE == NULL)
+    return placementAlloc(n, size, patternCtxDefault());
+
+  if (mappedCreate(file, OUTPUT_FILE, n * size) != 0) {
+    perror(OUTPUT_FILE);
+    exit(1);
+  }
+
+  return file->data;
+}
+
+static void closeOutput(mappedFile *file, char *dest) {
+  if (file->data != NULL)
+    mappedClose(file);
+  else
+    free(dest);
+}
+
 double testMap(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
-  map(dest, src, n, size, workerAddOne);
+  map(dest, src, n, size, ELEMENT->addOne);
 
   printTYPE(dest, n, __func__);
 
@@ -115,11 +422,59 @@ double testMap(void *src, size_t n, size_t size) {
 }
 
 double testReduce(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(size);
+  char *dest = malloc(size);
+
+  double time = omp_get_wtime();
+
+  reduce(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, 1, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testDeterministicReduce(void *src, size_t n, size_t size) {
+  char *dest = malloc(size);
+
+  double time = omp_get_wtime();
+
+  deterministicReduce(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, 1, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testMapReduce(void *src, size_t n, size_t size) {
+  char *dest = malloc(size);
+
+  double time = omp_get_wtime();
+
+  mapReduce(dest, src, n, size, ELEMENT->multTwo, ELEMENT->add);
+
+  printTYPE(dest, 1, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+// Unfused baseline of testMapReduce
+double testMapThenReduce(void *src, size_t n, size_t size) {
+  char *dest = malloc(size);
 
   double time = omp_get_wtime();
 
-  reduce(dest, src, n, size, workerAdd);
+  char *mapped = malloc(n * size);
+
+  map(mapped, src, n, size, ELEMENT->multTwo);
+  reduce(dest, mapped, n, size, ELEMENT->add);
+
+  free(mapped);
 
   printTYPE(dest, 1, __func__);
 
@@ -129,11 +484,45 @@ double testReduce(void *src, size_t n, size_t size) {
 }
 
 double testInclusiveScan(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  scan(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testTransformScan(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  transformScan(dest, src, n, size, ELEMENT->multTwo, ELEMENT->add);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+// Unfused baseline of testTransformScan
+double testMapThenScan(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
-  scan(dest, src, n, size, workerAdd);
+  char *mapped = malloc(n * size);
+
+  map(mapped, src, n, size, ELEMENT->multTwo);
+  scan(dest, mapped, n, size, ELEMENT->add);
+
+  free(mapped);
 
   printTYPE(dest, n, __func__);
 
@@ -143,15 +532,135 @@ double testInclusiveScan(void *src, size_t n, size_t size) {
 }
 
 double testExclusiveScan(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  exclusiveScan(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testLookbackScan(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  lookbackScan(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testExclusiveLookbackScan(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  exclusiveLookbackScan(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testWindowedMap(void *src, size_t n, size_t size) {
+  mappedFile output;
+  char *dest = openOutput(&output, n, size);
+
+  double time = omp_get_wtime();
+
+  windowedMap(dest, src, n, size, ELEMENT->addOne);
+
+  printTYPE(dest, n, __func__);
+
+  closeOutput(&output, dest);
+
+  return time;
+}
+
+double testWindowedReduce(void *src, size_t n, size_t size) {
+  mappedFile output;
+  char *dest = openOutput(&output, 1, size);
+
+  double time = omp_get_wtime();
+
+  windowedReduce(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, 1, __func__);
+
+  closeOutput(&output, dest);
+
+  return time;
+}
+
+double testWindowedScan(void *src, size_t n, size_t size) {
+  mappedFile output;
+  char *dest = openOutput(&output, n, size);
+
+  double time = omp_get_wtime();
+
+  windowedScan(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, n, __func__);
+
+  closeOutput(&output, dest);
+
+  return time;
+}
+
+double testSegmentedReduce(void *src, size_t n, size_t size) {
+  size_t *offsets = malloc(n * sizeof(size_t));
+  size_t nSegments = 0;
+
+  // Mix of short and very long segments
+  for (size_t start = 0; start < n; nSegments++) {
+    offsets[nSegments] = start;
+    start += 1 + rand() % (rand() % 2 ? n / 8 + 1 : 8);
+  }
+
+  char *dest = malloc(nSegments * size);
+
+  double time = omp_get_wtime();
+
+  segmentedReduce(dest, src, n, size, offsets, nSegments, ELEMENT->add);
+
+  printTYPE(dest, nSegments, __func__);
+
+  free(dest);
+  free(offsets);
+
+  return time;
+}
+
+double testSegmentedScan(void *src, size_t n, size_t size) {
+  int *flags = calloc(n, sizeof(int));
+
+  // Mix of short and very long segments
+  for (size_t start = 0; start < n; start += 1 + rand() % (rand() % 2 ? n / 8 + 1 : 8))
+    flags[start] = 1;
+
+  printInt(flags, n, "flags");
+
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
-  exclusiveScan(dest, src, n, size, workerAdd);
+  segmentedScan(dest, src, n, size, flags, ELEMENT->add);
 
   printTYPE(dest, n, __func__);
 
   free(dest);
+  free(flags);
 
   return time;
 }
@@ -165,7 +674,7 @@ double testPack(void *src, size_t n, size_t size) {
     count += i % 2;
   }
 
-  TYPE *dest = calloc(count, size);
+  char *dest = calloc(count, size);
 
   double time = omp_get_wtime();
 
@@ -181,11 +690,25 @@ double testPack(void *src, size_t n, size_t size) {
   return time;
 }
 
+double testPackIf(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  int newN = packIf(dest, src, n, size, ELEMENT->aboveFour);
+
+  printTYPE(dest, newN, __func__);
+
+  free(dest);
+
+  return time;
+}
+
 double testGather(void *src, size_t n, size_t size) {
   int nFilter = ITERATIONS / 2;
   int *filter = calloc(nFilter, sizeof(int));
 
-  TYPE *dest = malloc(nFilter * size);
+  char *dest = malloc(nFilter * size);
 
   for (long i = 0; i < nFilter; i++)
     filter[i] = rand() % n;
@@ -204,10 +727,37 @@ double testGather(void *src, size_t n, size_t size) {
   return time;
 }
 
+double testBucketedGather(void *src, size_t n, size_t size) {
+  int nFilter = ITERATIONS / 2;
+  int *filter = calloc(nFilter, sizeof(int));
+
+  char *dest = malloc(nFilter * size);
+
+  for (long i = 0; i < nFilter; i++)
+    filter[i] = rand() % n;
+
+  printInt(filter, nFilter, "filter");
+
+  patternCtx *ctx = patternCtxCreate(0, SCHEDULE_STATIC, 0);
+  ctx->gather = GATHER_BUCKETED;
+
+  double time = omp_get_wtime();
+
+  gatherCtx(dest, src, n, size, filter, nFilter, ctx);
+
+  printTYPE(dest, nFilter, __func__);
+
+  patternCtxDestroy(ctx);
+  free(dest);
+  free(filter);
+
+  return time;
+}
+
 double testScatter(void *src, size_t n, size_t size) {
   int nDest = 10;
 
-  TYPE *dest = malloc(nDest * size);
+  char *dest = malloc(nDest * size);
 
   memset(dest, 0, nDest * size);
 
@@ -233,7 +783,7 @@ double testScatter(void *src, size_t n, size_t size) {
 double testPriorityScatter(void *src, size_t n, size_t size) {
   int nDest = 6;
 
-  TYPE *dest = malloc(nDest * size);
+  char *dest = malloc(nDest * size);
 
   memset(dest, 0, nDest * size);
 
@@ -258,14 +808,14 @@ double testPriorityScatter(void *src, size_t n, size_t size) {
 
 double testMapPipeline(void *src, size_t n, size_t size) {
   void (*pipelineFunction[])(void *, const void *) = {
-      workerMultTwo,
-      workerAddOne,
-      workerDivTwo
+      ELEMENT->multTwo,
+      ELEMENT->addOne,
+      ELEMENT->divTwo
   };
 
   int nPipelineFunction = sizeof(pipelineFunction) / sizeof(pipelineFunction[0]);
 
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
@@ -280,14 +830,14 @@ double testMapPipeline(void *src, size_t n, size_t size) {
 
 double testItemBoundPipeline(void *src, size_t n, size_t size) {
   void (*pipelineFunction[])(void *, const void *) = {
-      workerMultTwo,
-      workerAddOne,
-      workerDivTwo
+      ELEMENT->multTwo,
+      ELEMENT->addOne,
+      ELEMENT->divTwo
   };
 
   int nPipelineFunction = sizeof(pipelineFunction) / sizeof(pipelineFunction[0]);
 
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
@@ -300,15 +850,62 @@ double testItemBoundPipeline(void *src, size_t n, size_t size) {
   return time;
 }
 
+double testFusedPipeline(void *src, size_t n, size_t size) {
+  void (*pipelineFunction[])(void *, const void *) = {
+      ELEMENT->multTwo,
+      ELEMENT->addOne,
+      ELEMENT->divTwo
+  };
+
+  int nPipelineFunction = sizeof(pipelineFunction) / sizeof(pipelineFunction[0]);
+
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  fusedPipeline(dest, src, n, size, pipelineFunction, nPipelineFunction);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testStreamPipeline(void *src, size_t n, size_t size) {
+  void (*pipelineFunction[])(void *, const void *) = {
+      ELEMENT->multTwo,
+      ELEMENT->addOne,
+      ELEMENT->divTwo
+  };
+
+  // Middle stage is farmed, the outer ones stay serial
+  int nStageWorkers[] = {1, omp_get_max_threads(), 1};
+
+  int nPipelineFunction = sizeof(pipelineFunction) / sizeof(pipelineFunction[0]);
+
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  streamingPipeline(dest, src, n, size, pipelineFunction, nStageWorkers, nPipelineFunction);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
 double testSerialPipeline(void *src, size_t n, size_t size) {
   size_t nWorkers = 128;
 
   void (**pipelineFunction)(void *, const void *) = calloc(nWorkers, sizeof(pipelineFunction[0]));
 
   for (size_t i = 0; i < nWorkers; i++)
-    pipelineFunction[i] = workerAddOne;
+    pipelineFunction[i] = ELEMENT->addOne;
 
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
@@ -322,11 +919,11 @@ double testSerialPipeline(void *src, size_t n, size_t size) {
 }
 
 double testFarm(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
-  farm(dest, src, n, size, workerAddOne, 3);
+  farm(dest, src, n, size, ELEMENT->addOne, omp_get_max_threads());
 
   printTYPE(dest, n, __func__);
 
@@ -336,7 +933,7 @@ double testFarm(void *src, size_t n, size_t size) {
 }
 
 double testStencil(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(n * size);
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   // Need static value for accurate tests, although random is fun
   // srand(time(0));
@@ -346,7 +943,7 @@ double testStencil(void *src, size_t n, size_t size) {
 
   double time = omp_get_wtime();
 
-  stencil(dest, src, n, size, workerAccum, 5);
+  stencil(dest, src, n, size, ELEMENT->accum, 5);
 
   printTYPE(dest, n, __func__);
 
@@ -355,26 +952,33 @@ double testStencil(void *src, size_t n, size_t size) {
   return time;
 }
 
-double testParallelPrefix(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(n * size);
+double testGridStencil(void *src, size_t n, size_t size) {
+  // Square-ish 2D grid over the first nx * ny elements
+  size_t nx = n < 64 ? n : 64;
+  stencilGrid grid = {{nx, n / nx, 1}, {1, 1, 0}, STENCIL_CLAMP, 0};
+
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
-  parallelPrefix(dest, src, n, size, workerAdd);
+  gridStencil(dest, src, size, &grid, ELEMENT->heat, 8, NULL);
 
-  printTYPE(dest, n, __func__);
+  printTYPE(dest, nx * (n / nx), __func__);
 
   free(dest);
 
   return time;
 }
 
-double testHyperplane(void *src, size_t n, size_t size) {
-  TYPE *dest = malloc(n * size);
+double testSlidingStencil(void *src, size_t n, size_t size) {
+  // Same window as testStencil
+  stencilGrid grid = {{n, 1, 1}, {5, 0, 0}, STENCIL_CLAMP, 0};
+
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
-  hyperplane(dest, src, n, size, workerAdd);
+  slidingStencil(dest, src, size, &grid, ELEMENT->accum, ELEMENT->subtract);
 
   printTYPE(dest, n, __func__);
 
@@ -383,33 +987,102 @@ double testHyperplane(void *src, size_t n, size_t size) {
   return time;
 }
 
-double testQuickSort(void *src, size_t n, size_t size) {
-  // Ignore input array and size to make use of existing signature
-  (void) src;
-  (void) size;
-
-  // Generate random numbers for ordering and fill array
-  int *randArr = calloc(n, sizeof(int));
-
-  for (size_t i = 0; i < n; i++)
-    randArr[i] = rand() % n;
-
-  printInt(randArr, n, __func__);
+double testParallelPrefix(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
 
   double time = omp_get_wtime();
 
-  quickSort(randArr, n);
+  parallelPrefix(dest, src, n, size, ELEMENT->add);
 
-  printInt(randArr, n, __func__);
+  printTYPE(dest, n, __func__);
 
-  free(randArr);
+  free(dest);
 
   return time;
 }
 
-double testQuickSort2(void *src, size_t n, size_t size) {
-  // Ignore input array and size to make use of existing signature
-  (void) src;
+double testHyperplane(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  hyperplane(dest, src, n, size, ELEMENT->add);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+// Edit distance between the two halves of the source
+typedef struct editCtx {
+    const char *a;
+    const char *b;
+    int *table;
+    size_t side;
+} editCtx;
+
+static void editCell(size_t row, size_t col, void *arg) {
+  editCtx *ctx = arg;
+  size_t side = ctx->side;
+
+  // Distances to the empty prefix are the prefix lengths
+  int up = row == 0 ? (int) col + 1 : ctx->table[(row - 1) * side + col];
+  int left = col == 0 ? (int) row + 1 : ctx->table[row * side + col - 1];
+  int diag = row == 0 ? (int) col : col == 0 ? (int) row : ctx->table[(row - 1) * side + col - 1];
+
+  int best = (up < left ? up : left) + 1;
+  int replace = diag + (ELEMENT->compare(&ctx->a[row * ELEMENT_WIDTH], &ctx->b[col * ELEMENT_WIDTH]) != 0);
+
+  ctx->table[row * side + col] = replace < best ? replace : best;
+}
+
+double testWavefront(void *src, size_t n, size_t size) {
+  // Keep the table small enough for the larger inputs
+  size_t side = n / 2 < 2048 ? n / 2 : 2048;
+
+  int *table = malloc(side * side * sizeof(int));
+  editCtx ctx = {src, (char *) src + side * size, table, side};
+
+  double time = omp_get_wtime();
+
+  wavefront(side, side, 0, WAVEFRONT_UP | WAVEFRONT_LEFT | WAVEFRONT_UP_LEFT, editCell, &ctx);
+
+  printInt(&table[(side - 1) * side], side, __func__);
+
+  free(table);
+
+  return time;
+}
+
+double testQuickSort(void *src, size_t n, size_t size) {
+  // Ignore input array and size to make use of existing signature
+  (void) src;
+  (void) size;
+
+  // Generate random numbers for ordering and fill array
+  int *randArr = calloc(n, sizeof(int));
+
+  for (size_t i = 0; i < n; i++)
+    randArr[i] = rand() % n;
+
+  printInt(randArr, n, __func__);
+
+  double time = omp_get_wtime();
+
+  quickSort(randArr, n);
+
+  printInt(randArr, n, __func__);
+
+  free(randArr);
+
+  return time;
+}
+
+double testQuickSort2(void *src, size_t n, size_t size) {
+  // Ignore input array and size to make use of existing signature
+  (void) src;
   (void) size;
 
   // Generate random numbers for ordering and fill array
@@ -433,6 +1106,366 @@ double testQuickSort2(void *src, size_t n, size_t size) {
   return time;
 }
 
+double testSampleSort(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  memcpy(dest, src, n * size);
+
+  double time = omp_get_wtime();
+
+  sampleSort(dest, n, size, ELEMENT->compare);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testRadixSort(void *src, size_t n, size_t size) {
+  // Ignore input array and size to make use of existing signature
+  (void) src;
+  (void) size;
+
+  // Generate random numbers for ordering and fill array
+  int *randArr = calloc(n, sizeof(int));
+
+  for (size_t i = 0; i < n; i++)
+    randArr[i] = rand() % n;
+
+  printInt(randArr, n, __func__);
+
+  double time = omp_get_wtime();
+
+  parallelSortInt(randArr, n);
+
+  printInt(randArr, n, __func__);
+
+  free(randArr);
+
+  return time;
+}
+
+double testKeyIndexSort(void *src, size_t n, size_t size) {
+  // Generate random numbers for ordering and fill array
+  int *randArr = calloc(n, sizeof(int));
+
+  for (size_t i = 0; i < n; i++)
+    randArr[i] = rand() % n;
+
+  printInt(randArr, n, __func__);
+
+  double time = omp_get_wtime();
+
+  keyIndexSort(randArr, src, size, n);
+
+  printTYPE(src, n, __func__);
+
+  printInt(randArr, n, __func__);
+
+  free(randArr);
+
+  return time;
+}
+
+double testTypedMap(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  requireKernel(ELEMENT->typedMap != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->typedMap(dest, src, n);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testTypedReduce(void *src, size_t n, size_t size) {
+  char *dest = malloc(size);
+
+  requireKernel(ELEMENT->typedReduce != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->typedReduce(dest, src, n);
+
+  printTYPE(dest, 1, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testTypedScan(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  requireKernel(ELEMENT->typedScan != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->typedScan(dest, src, n);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testTypedStencil(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  requireKernel(ELEMENT->typedStencil != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->typedStencil(dest, src, n, 5);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testCompensatedSum(void *src, size_t n, size_t size) {
+  char *dest = malloc(size);
+
+  requireKernel(ELEMENT->compensatedSum != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->compensatedSum(dest, src, n);
+
+  printTYPE(dest, 1, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testBatchMap(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+  workerCtx ctx = {WEIGHTED_MODE};
+
+  double time = omp_get_wtime();
+
+  mapBatch(dest, src, n, size, ELEMENT->batchAddOne, &ctx);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testBatchGather(void *src, size_t n, size_t size) {
+  int nFilter = ITERATIONS / 2;
+  int *filter = calloc(nFilter, sizeof(int));
+  workerCtx ctx = {WEIGHTED_MODE};
+
+  char *dest = malloc(nFilter * size);
+
+  for (long i = 0; i < nFilter; i++)
+    filter[i] = rand() % n;
+
+  printInt(filter, nFilter, "filter");
+
+  double time = omp_get_wtime();
+
+  gatherBatch(dest, src, n, size, filter, nFilter, ELEMENT->batchAddOne, &ctx);
+
+  printTYPE(dest, nFilter, __func__);
+
+  free(dest);
+  free(filter);
+
+  return time;
+}
+
+double testBatchItemBoundPipeline(void *src, size_t n, size_t size) {
+  batchWorker pipelineFunction[] = {
+      ELEMENT->batchMultTwo,
+      ELEMENT->batchAddOne,
+      ELEMENT->batchDivTwo
+  };
+
+  int nPipelineFunction = sizeof(pipelineFunction) / sizeof(pipelineFunction[0]);
+  workerCtx ctx = {WEIGHTED_MODE};
+
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  itemBoundPipelineBatch(dest, src, n, size, pipelineFunction, nPipelineFunction, &ctx);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testBatchFarm(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+  workerCtx ctx = {WEIGHTED_MODE};
+
+  double time = omp_get_wtime();
+
+  farmBatch(dest, src, n, size, ELEMENT->batchAddOne, omp_get_max_threads(), &ctx);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testOffloadMap(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  requireKernel(ELEMENT->offloadMap != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->offloadMap(dest, src, n);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testOffloadScan(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  requireKernel(ELEMENT->offloadScan != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->offloadScan(dest, src, n);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testOffloadChain(void *src, size_t n, size_t size) {
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  requireKernel(ELEMENT->offloadChain != NULL, __func__);
+
+  double time = omp_get_wtime();
+
+  ELEMENT->offloadChain(dest, src, n);
+
+  printTYPE(dest, n, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+// A gather and a reduce on different buffers overlap, the scan waits for the map it reads
+double testAsyncPatterns(void *src, size_t n, size_t size) {
+  int nFilter = ITERATIONS / 2;
+  int *filter = calloc(nFilter, sizeof(int));
+
+  char *gathered = malloc(nFilter * size);
+  char *reduced = malloc(size);
+  char *mapped = placementAlloc(n, size, patternCtxDefault());
+  char *dest = placementAlloc(n, size, patternCtxDefault());
+
+  for (long i = 0; i < nFilter; i++)
+    filter[i] = rand() % n;
+
+  asyncQueue *q = asyncCreate(0, 0);
+
+  double time = omp_get_wtime();
+
+  asyncHandle *gatherDone = gatherAsync(q, gathered, src, n, size, filter, nFilter);
+  asyncHandle *reduceDone = reduceAsync(q, reduced, src, n, size, ELEMENT->add);
+  asyncHandle *mapDone = mapAsync(q, mapped, src, n, size, ELEMENT->addOne);
+  asyncHandle *scanDone = scanAsync(q, dest, mapped, n, size, ELEMENT->add);
+
+  asyncWait(gatherDone);
+  asyncWait(reduceDone);
+  asyncWait(mapDone);
+  asyncWait(scanDone);
+
+  printTYPE(gathered, nFilter, __func__);
+  printTYPE(reduced, 1, __func__);
+  printTYPE(dest, n, __func__);
+
+  asyncDestroy(q);
+
+  free(gathered);
+  free(reduced);
+  free(mapped);
+  free(dest);
+  free(filter);
+
+  return time;
+}
+
+#ifdef PATTERNS_MPI
+double testDistributedReduce(void *src, size_t n, size_t size) {
+  size_t first;
+  size_t nBlock = distributedBlock(n, MPI_COMM_WORLD, &first);
+  char *dest = malloc(size);
+
+  double time = omp_get_wtime();
+
+  distributedReduce(dest, (char *) src + first * size, nBlock, size, ELEMENT->add);
+
+  printTYPE(dest, 1, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testDistributedScan(void *src, size_t n, size_t size) {
+  size_t first;
+  size_t nBlock = distributedBlock(n, MPI_COMM_WORLD, &first);
+  char *dest = placementAlloc(nBlock, size, patternCtxDefault());
+
+  double time = omp_get_wtime();
+
+  distributedScan(dest, (char *) src + first * size, nBlock, size, ELEMENT->add);
+
+  printTYPE(dest, nBlock, __func__);
+
+  free(dest);
+
+  return time;
+}
+
+double testDistributedSort(void *src, size_t n, size_t size) {
+  size_t first;
+  size_t nBlock = distributedBlock(n, MPI_COMM_WORLD, &first);
+  char *dest = placementAlloc(nBlock, size, patternCtxDefault());
+
+  memcpy(dest, (char *) src + first * size, nBlock * size);
+
+  double time = omp_get_wtime();
+
+  distributedSort(dest, nBlock, size, ELEMENT->compare);
+
+  printTYPE(dest, nBlock, __func__);
+
+  free(dest);
+
+  return time;
+}
+#endif
 
 //=======================================================
 // List of unit test functions
@@ -457,7 +1490,47 @@ TESTFUNCTION testFunction[] = {
     testParallelPrefix,
     testHyperplane,
     testQuickSort,
-    testQuickSort2
+    testQuickSort2,
+    testTypedMap,
+    testTypedReduce,
+    testTypedScan,
+    testTypedStencil,
+    testBatchMap,
+    testBatchGather,
+    testBatchItemBoundPipeline,
+    testBatchFarm,
+    testLookbackScan,
+    testExclusiveLookbackScan,
+    testFusedPipeline,
+    testStreamPipeline,
+    testSampleSort,
+    testRadixSort,
+    testKeyIndexSort,
+    testGridStencil,
+    testSlidingStencil,
+    testWavefront,
+    testPackIf,
+    testSegmentedReduce,
+    testSegmentedScan,
+    testDeterministicReduce,
+    testCompensatedSum,
+    testMapReduce,
+    testMapThenReduce,
+    testTransformScan,
+    testMapThenScan,
+    testWindowedMap,
+    testWindowedReduce,
+    testWindowedScan,
+    testBucketedGather,
+    testOffloadMap,
+    testOffloadScan,
+    testOffloadChain,
+    testAsyncPatterns,
+#ifdef PATTERNS_MPI
+    testDistributedReduce,
+    testDistributedScan,
+    testDistributedSort
+#endif
 };
 
 char *testNames[] = {
@@ -477,7 +1550,47 @@ char *testNames[] = {
     "test: Parallel Prefix",
     "test: Hyperplane",
     "test: Int Quick Sort",
-    "test: Int Double Quick Sort"
+    "test: Int Double Quick Sort",
+    "test: Typed Map",
+    "test: Typed Reduce",
+    "test: Typed Inclusive Scan",
+    "test: Typed Stencil",
+    "test: Batch Map",
+    "test: Batch Gather",
+    "test: Batch Item-Bound Pipeline",
+    "test: Batch Farm",
+    "test: Look-back Scan",
+    "test: Exclusive Look-back Scan",
+    "test: Fused Pipeline",
+    "test: Stream Pipeline",
+    "test: Sample Sort",
+    "test: Int Radix Sort",
+    "test: Key-Index Sort",
+    "test: Grid Stencil",
+    "test: Sliding Stencil",
+    "test: Wavefront Edit Distance",
+    "test: Pack If",
+    "test: Segmented Reduce",
+    "test: Segmented Scan",
+    "test: Deterministic Reduce",
+    "test: Compensated Sum",
+    "test: Map Reduce",
+    "test: Map then Reduce",
+    "test: Transform Scan",
+    "test: Map then Scan",
+    "test: Windowed Map",
+    "test: Windowed Reduce",
+    "test: Windowed Scan",
+    "test: Bucketed Gather",
+    "test: Offload Map",
+    "test: Offload Scan",
+    "test: Offload Buffer Chain",
+    "test: Async Patterns",
+#ifdef PATTERNS_MPI
+    "test: Distributed Reduce",
+    "test: Distributed Scan",
+    "test: Distributed Sort"
+#endif
 };
 
 int nTestFunction = sizeof(testFunction) / sizeof(testFunction[0]);
@@ -1,8 +1,28 @@
 #ifndef __UNIT_H
 #define __UNIT_H
 
+#include <stddef.h>
+
 extern int WEIGHTED_MODE;
 extern int ITERATIONS;
+extern const char *OUTPUT_FILE;
+extern const char *ELEMENT_NAME;  // Type of the values the tests run on
+extern size_t ELEMENT_WIDTH;      // Bytes of every element, the value followed by an opaque payload
+
+// Size of the values of an element type, 0 if there is no such type
+size_t unitElementSize(const char *name);
+
+// Picks the element the tests run on, width 0 for plain values. -1 if the type is unknown
+// or the width is not a multiple of the value size
+int unitSetElement(const char *name, size_t width);
+
+// Random value with a zero payload
+void unitRandomElement(void *a);
+
+void unitPrintElement(const void *a);
+
+// Tunes the patterns for the current element, size classes up to maxJobs elements
+void unitCalibrate(size_t maxJobs);
 
 typedef double (*TESTFUNCTION)(void *, size_t, size_t);
 
@@ -1,4 +1,5 @@
 #!/usr/bin/env python3.7
+import csv
 import os
 import sys
 
@@ -29,6 +30,26 @@ def create_graph(image_dir):
             temp.append(float(input_file.readline()))
         results.append(temp)
 
+    plot_graph(test_name, iterations, threads, results, image_dir)
+
+
+def create_csv_graphs(records, image_dir):
+    # Group the benchmark records by test, then by size and thread count
+    tests = {}
+    for record in records:
+        tests.setdefault(record["test"], []).append(record)
+
+    for test_name, test_records in tests.items():
+        iterations = sorted({int(record["size"]) for record in test_records})
+        threads = sorted({int(record["threads"]) for record in test_records})
+        medians = {(int(record["size"]), int(record["threads"])): float(record["median"]) for record in test_records}
+
+        results = [[medians[(it, th)] for th in threads] for it in iterations]
+
+        plot_graph(test_name, iterations, threads, results, image_dir)
+
+
+def plot_graph(test_name, iterations, threads, results, image_dir):
     # Data for plotting
     fig = pyplot.figure()
     ax = fig.add_subplot(111)
@@ -82,10 +103,13 @@ except OSError as err:
     sys.exit(-1)
 
 # Create Graphs -------------------------------------------------------------------------
-testCount = int(input_file.readline())
+if file_location.endswith(".csv"):
+    create_csv_graphs(csv.DictReader(input_file), image_directory)
+else:
+    testCount = int(input_file.readline())
 
-for i in range(0, testCount):
-    create_graph(image_directory)
+    for i in range(0, testCount):
+        create_graph(image_directory)
 
 input_file.close()
 
@@ -1,14 +1,14 @@
 #!/usr/bin/env python3.7
 import os
 import sys
+import csv
 import time
 import datetime
-import numpy
 
 now = datetime.datetime.now()
 
 # Constants
-NUM_ALGORITHMS = 17
+NUM_ALGORITHMS = 52
 ITERATIONS_HEAVY = [10000, 50000, 100000, 500000, 1000000]
 ITERATIONS_MED = [500, 1000, 5000, 10000, 50000]
 ITERATIONS_LIGHT = [50, 100, 500, 1000, 5000]
@@ -33,6 +33,11 @@ WEIGHTED = [
 
 THREADS = [1, 2, 4, 8, 16, 32, 64, 128]
 REPETITIONS = 5
+WARMUP = 1
+
+# Element the patterns run on, WIDTH 0 keeps plain values
+ELEMENT = "double"
+WIDTH = 0
 
 FILE_NAME = f"paralell_tests {now.day}-{now.month}-{now.year} {now.hour}:{now.minute}:{now.second}.txt"
 
@@ -43,9 +48,6 @@ def file_write(file_buffer, value):
 
 
 def run_test(alg_id):
-    test_name = ""
-    results = []
-
     file_buffer = []
 
     # Set default iterations
@@ -71,42 +73,33 @@ def run_test(alg_id):
 
     test_start_time = time.time()
 
-    for i in range(0, len(iterations)):
-        it_results = []
-        for t in range(0, len(THREADS)):
-            thread_results = []
-            for r in range(0, REPETITIONS):
-                # Run and extract result from program
-                command = f"{program} -i {iterations[i]} -k {alg_id} -t {THREADS[t]}"
+    # One process sweeps every size and thread count, the program does the warm-up and repetitions
+    command = f"{program} -B -k {alg_id} -r {REPETITIONS} -u {WARMUP}" \
+              f" -s {','.join(map(str, iterations))} -T {','.join(map(str, THREADS))} -e {ELEMENT}"
 
-                if WEIGHTED.count(alg_id) != 0:
-                    command += " -w"
+    if WIDTH != 0:
+        command += f" -z {WIDTH}"
 
-                stream = os.popen(command)
-                output = stream.read().split("Done!\n\n")
+    if WEIGHTED.count(alg_id) != 0:
+        command += " -w"
 
-                # Extract time from program output
-                running_time = output[1].split(":\t")[1].split(" micro")[0]
-                thread_results.append(int(running_time))
+    stream = os.popen(command)
+    records = list(csv.DictReader(stream))
 
-                # Extract test name from program output and write to file
-                if test_name == "":
-                    test_name = output[1].split(":\t")[0][6:]
-                    if WEIGHTED.count(alg_id) != 0:
-                        test_name += " (Weighted)"
+    # Keep every statistic next to the summary read by the grapher
+    csv_buffer.extend(records)
 
-                    file_write(file_buffer, test_name)
+    test_name = records[0]["test"]
+    if WEIGHTED.count(alg_id) != 0:
+        test_name += " (Weighted)"
 
-            # Calculate mean of repetitions and write to file
-            file_write(file_buffer, numpy.mean(thread_results))
+    file_write(file_buffer, test_name)
 
-            # Print progress
-            curr_test = i * (len(THREADS)) + t + 1
+    # Records come size by size, thread count by thread count
+    for record in records:
+        file_write(file_buffer, float(record["median"]))
 
-            print(f"Finished test {curr_test}/{total_tests} of algorithm {alg_id}/{NUM_ALGORITHMS} - {test_name}.")
-
-        # Append mean time to execute for each thread count
-        results.append(it_results)
+    print(f"Finished {total_tests} tests of algorithm {alg_id}/{NUM_ALGORITHMS} - {test_name}.")
 
     # Write results to file
     output_file.writelines(file_buffer)
@@ -152,6 +145,7 @@ except OSError as err:
 
 # Start tests -------------------------------------------------------------------------
 start_time = time.time()
+csv_buffer = []
 
 # Run all algorithms or single
 if algorithm_id == 0:
@@ -166,5 +160,12 @@ else:
 
 output_file.close()
 
+# Every statistic of every run, the grapher also reads this file
+with open(f"{file_dir}/{FILE_NAME[:-4]}.csv", 'w', newline='') as csv_file:
+    writer = csv.DictWriter(csv_file, fieldnames=["test", "size", "threads", "repetitions",
+                                                  "min", "median", "p95", "mean", "stddev"])
+    writer.writeheader()
+    writer.writerows(csv_buffer)
+
 totalTime = round(time.time() - start_time)
 print(f"Tests completed successfully in {totalTime} seconds.")